@@ -0,0 +1,400 @@
+/**************************************************************
+ *  Project     : EasyDriveway
+ *  File        : EspNowConfig.h
+ *  Purpose     : Compile-time sizing and task settings for the ESP-NOW stack.
+ *  Author      : Tshibangu Samuel
+ *  Role        : Freelance Embedded Systems Engineer
+ *  Expertise   : Secure IoT Systems, Embedded C++, RTOS, Control Logic
+ *  Contact     : tshibsamuel47@gmail.com
+ *  Portfolio   : https://www.freelancer.com/u/tshibsamuel477
+ *  Phone       : +216 54 429 793
+ *  Created     : 2025-10-16
+ *  Version     : 1.0.0
+ **************************************************************/
+#ifndef ESPNOW_CONFIG_H
+#define ESPNOW_CONFIG_H
+
+/**
+ * @name Service Task
+ * @brief Core, priority and stack of the task that drains RX and dispatches
+ *        requests to the role adapter (never the Wi-Fi task).
+ * @details Defaults applied only if not already defined.
+ * @{ */
+#ifndef ESPNOW_SVC_TASK_CORE
+#define ESPNOW_SVC_TASK_CORE       1
+#endif
+#ifndef ESPNOW_SVC_TASK_PRIORITY
+#define ESPNOW_SVC_TASK_PRIORITY   4
+#endif
+#ifndef ESPNOW_SVC_TASK_STACK
+#define ESPNOW_SVC_TASK_STACK      6144
+#endif
+/** @} */
+
+/**
+ * @name RX Ring
+ * @brief Frames copied by the receive callback, drained in batches.
+ * @details Depth must be a power of two.
+ * @{ */
+#ifndef ESPNOW_RX_RING_DEPTH
+#define ESPNOW_RX_RING_DEPTH       32
+#endif
+#ifndef ESPNOW_RX_BATCH
+#define ESPNOW_RX_BATCH            8
+#endif
+/** @} */
+
+/**
+ * @name Receive Admission
+ * @brief Per-sender token buckets ahead of peer learning and dispatch (Admission.h).
+ * @details Rates are frames per second (0 = unlimited). Pinned peers get the
+ *          PEER bucket; any other sender a STRANGER bucket of its own, which
+ *          puts it in quarantine when overrun, plus the SHARED one all such
+ *          senders draw from. PAIR_EXCHANGE also spends the node-wide PAIR
+ *          bucket. ESPNOW_ADMIT_SLOTS must be a power of two.
+ * @{ */
+#ifndef ESPNOW_ADMIT_PEER_RATE
+#define ESPNOW_ADMIT_PEER_RATE     1000    // above what full-size frames reach on air
+#endif
+#ifndef ESPNOW_ADMIT_PEER_BURST
+#define ESPNOW_ADMIT_PEER_BURST    200     // firmware windows arrive back to back
+#endif
+#ifndef ESPNOW_ADMIT_STRANGER_RATE
+#define ESPNOW_ADMIT_STRANGER_RATE 20      // e.g. a lane sensor driving this relay
+#endif
+#ifndef ESPNOW_ADMIT_STRANGER_BURST
+#define ESPNOW_ADMIT_STRANGER_BURST 40
+#endif
+#ifndef ESPNOW_ADMIT_SHARED_RATE
+#define ESPNOW_ADMIT_SHARED_RATE   100
+#endif
+#ifndef ESPNOW_ADMIT_SHARED_BURST
+#define ESPNOW_ADMIT_SHARED_BURST  100
+#endif
+#ifndef ESPNOW_ADMIT_PAIR_RATE
+#define ESPNOW_ADMIT_PAIR_RATE     2       // PAIR_EXCHANGE, any sender
+#endif
+#ifndef ESPNOW_ADMIT_PAIR_BURST
+#define ESPNOW_ADMIT_PAIR_BURST    8
+#endif
+#ifndef ESPNOW_ADMIT_QUARANTINE_MS
+#define ESPNOW_ADMIT_QUARANTINE_MS 10000
+#endif
+#ifndef ESPNOW_ADMIT_SLOTS
+#define ESPNOW_ADMIT_SLOTS         64      // unpinned senders tracked
+#endif
+#ifndef ESPNOW_ADMIT_PROBE
+#define ESPNOW_ADMIT_PROBE         4
+#endif
+/** @} */
+
+/**
+ * @name TX Scheduler
+ * @brief Frame pool shared by all priority lanes and in-flight limits.
+ * @details The driver only reports one completion per esp_now_send(); frames
+ *          above the per-peer budget wait in their lane instead of failing.
+ * @{ */
+#ifndef ESPNOW_TX_POOL
+#define ESPNOW_TX_POOL             16
+#endif
+#ifndef ESPNOW_TX_MAX_INFLIGHT
+#define ESPNOW_TX_MAX_INFLIGHT     6
+#endif
+#ifndef ESPNOW_TX_INFLIGHT_PER_PEER
+#define ESPNOW_TX_INFLIGHT_PER_PEER 2
+#endif
+#ifndef ESPNOW_TX_DONE_TIMEOUT_MS
+#define ESPNOW_TX_DONE_TIMEOUT_MS  200     // assume lost completion after this
+#endif
+#ifndef ESPNOW_TX_DONE_RING_DEPTH
+#define ESPNOW_TX_DONE_RING_DEPTH  16
+#endif
+/** @} */
+
+/**
+ * @name Request Client
+ * @brief Pending-request table and retry policy for EspNowCore::request().
+ * @details Per-opcode timeouts override ESPNOW_REQ_TIMEOUT_MS (see reqTimeoutMs()).
+ *          Backoff for attempt n is BACKOFF_MS << n plus 0..JITTER_MS.
+ * @{ */
+#ifndef ESPNOW_REQ_PENDING_MAX
+#define ESPNOW_REQ_PENDING_MAX     16
+#endif
+#ifndef ESPNOW_REQ_TIMEOUT_MS
+#define ESPNOW_REQ_TIMEOUT_MS      60
+#endif
+#ifndef ESPNOW_REQ_RETRIES
+#define ESPNOW_REQ_RETRIES         3
+#endif
+#ifndef ESPNOW_REQ_BACKOFF_MS
+#define ESPNOW_REQ_BACKOFF_MS      20
+#endif
+#ifndef ESPNOW_REQ_JITTER_MS
+#define ESPNOW_REQ_JITTER_MS       15
+#endif
+/** @} */
+
+/**
+ * @name Peer Table
+ * @brief Capacity, placement and staleness of the MAC-indexed peer table.
+ * @details Storage is allocated on first use so PSRAM is up by then; falls back
+ *          to internal RAM. Only auto-learned (unpinned) peers are evicted.
+ *          PAIR_EXCHANGE adds a peer pending until a frame to it is ACKed; at
+ *          most ESPNOW_PAIR_PENDING_MAX wait at once, the oldest making room.
+ *          Unpinned peers silent for ESPNOW_PEER_STALE_MS are dropped.
+ * @{ */
+#ifndef ESPNOW_PEER_CAPACITY
+#define ESPNOW_PEER_CAPACITY       96
+#endif
+#ifndef ESPNOW_PEERS_IN_PSRAM
+  #if defined(BOARD_HAS_PSRAM)
+  #define ESPNOW_PEERS_IN_PSRAM    1
+  #else
+  #define ESPNOW_PEERS_IN_PSRAM    0
+  #endif
+#endif
+#ifndef ESPNOW_PAIR_PENDING_MAX
+#define ESPNOW_PAIR_PENDING_MAX    4
+#endif
+#ifndef ESPNOW_PEER_STALE_MS
+#define ESPNOW_PEER_STALE_MS       600000UL   // 10 min without a frame
+#endif
+#ifndef ESPNOW_PEER_SWEEP_MS
+#define ESPNOW_PEER_SWEEP_MS       30000UL    // how often service() drops stale peers
+#endif
+/** @} */
+
+/**
+ * @name Segmented Transfers
+ * @brief Multi-frame messages (large responses, topology/config pushes, logs).
+ * @details Window is in fragments and must be <= 32 (SACK bitmap width).
+ * @{ */
+#ifndef ESPNOW_SEG_MAX_BYTES
+#define ESPNOW_SEG_MAX_BYTES       4096
+#endif
+#ifndef ESPNOW_SEG_TX_SESSIONS
+#define ESPNOW_SEG_TX_SESSIONS     2
+#endif
+#ifndef ESPNOW_SEG_RX_SESSIONS
+#define ESPNOW_SEG_RX_SESSIONS     2
+#endif
+#ifndef ESPNOW_SEG_WINDOW
+#define ESPNOW_SEG_WINDOW          8
+#endif
+#ifndef ESPNOW_SEG_RTO_MS
+#define ESPNOW_SEG_RTO_MS          80
+#endif
+#ifndef ESPNOW_SEG_MAX_TRIES
+#define ESPNOW_SEG_MAX_TRIES       5
+#endif
+#ifndef ESPNOW_SEG_RX_IDLE_MS
+#define ESPNOW_SEG_RX_IDLE_MS      1000
+#endif
+#ifndef ESPNOW_SEG_TX_RESERVE
+#define ESPNOW_SEG_TX_RESERVE      4       // pool frames left for regular traffic
+#endif
+/** @} */
+
+/**
+ * @name Group Actuation
+ * @brief ACK tallies for SET_GROUP broadcasts sent with EspNowCore::groupSet().
+ * @{ */
+#ifndef ESPNOW_GROUP_TALLY_MAX
+#define ESPNOW_GROUP_TALLY_MAX     4
+#endif
+#ifndef ESPNOW_GROUP_ACK_MS
+#define ESPNOW_GROUP_ACK_MS        150     // collect member answers this long
+#endif
+/** @} */
+
+/**
+ * @name Role Dispatch
+ * @brief Opcodes one role adapter may register (common ones included).
+ * @{ */
+#ifndef ESPNOW_ROLE_OPS_MAX
+#define ESPNOW_ROLE_OPS_MAX        32
+#endif
+/** @} */
+
+/**
+ * @name Emulators
+ * @brief Virtual instances one SEMU/REMU adapter can serve (at most 16).
+ * @details The live count is the topology emuCount, capped by these.
+ * @{ */
+#ifndef ESPNOW_SEMU_VIRT_MAX
+#define ESPNOW_SEMU_VIRT_MAX       8     // TF-Luna pairs
+#endif
+#ifndef ESPNOW_REMU_VIRT_MAX
+#define ESPNOW_REMU_VIRT_MAX       8
+#endif
+#ifndef ESPNOW_REMU_CH_PER_VIRT
+#define ESPNOW_REMU_CH_PER_VIRT    2     // default slice of the physical channels
+#endif
+/** @} */
+
+/**
+ * @name Sensor Streaming
+ * @brief SENS_SUBSCRIBE / SENS_REPORT push mode (SensReport.h) and the
+ *        local SENS->REL lane rules (SensLane.h).
+ * @details The cadence floor matches the default TF-Luna rate (100 FPS).
+ * @{ */
+#ifndef ESPNOW_SENS_SUBS_MAX
+#define ESPNOW_SENS_SUBS_MAX       2
+#endif
+#ifndef ESPNOW_SENS_MIN_PERIOD_MS
+#define ESPNOW_SENS_MIN_PERIOD_MS  10
+#endif
+#ifndef ESPNOW_SENS_SUB_LEASE_MS
+#define ESPNOW_SENS_SUB_LEASE_MS   60000
+#endif
+#ifndef ESPNOW_SENS_RULE_ACTS_MAX
+#define ESPNOW_SENS_RULE_ACTS_MAX  32    // relay refs across all lanes (SensLane.h), <= 32
+#endif
+// Relay wave defaults when a lane leaves them at 0 (Config_SEMU.h VLEAD_CT/VLEAD_MS/VON_MS).
+#ifndef ESPNOW_WAVE_LEAD_CT
+#define ESPNOW_WAVE_LEAD_CT        3
+#endif
+#ifndef ESPNOW_WAVE_STEP_MS
+#define ESPNOW_WAVE_STEP_MS        250
+#endif
+#ifndef ESPNOW_WAVE_ON_MS
+#define ESPNOW_WAVE_ON_MS          600
+#endif
+/** @} */
+
+/**
+ * @name Topology
+ * @brief Capacity of TopologyFixed (heap-free topology decode).
+ * @details Bigger TLVs still decode into the vector-based Topology.
+ * @{ */
+#ifndef ESPNOW_TOPO_MAX_NEIGHBORS
+#define ESPNOW_TOPO_MAX_NEIGHBORS  64
+#endif
+#ifndef ESPNOW_TOPO_MAX_PARAMS
+#define ESPNOW_TOPO_MAX_PARAMS     256
+#endif
+#ifndef ESPNOW_TOPO_MAX_GROUPS
+#define ESPNOW_TOPO_MAX_GROUPS     16
+#endif
+/** @} */
+
+/**
+ * @name Duplicate Suppression
+ * @brief Per-peer 64-entry sequence window; answers kept to replay on duplicates.
+ * @details Unicast requests are sequenced; responses, broadcasts and fragments
+ *          are not. A frame more than 64 behind the window resyncs it (sender reboot).
+ * @{ */
+#ifndef ESPNOW_DUP_RESP_CACHE
+#define ESPNOW_DUP_RESP_CACHE      4
+#endif
+/** @} */
+
+/**
+ * @name Link Quality
+ * @brief RSSI source on cores older than IDF 5 (no esp_now_recv_info_t).
+ * @details With 1, a promiscuous management-frame callback records the RSSI of
+ *          each ESP-NOW action frame just before the receive callback runs.
+ *          That callback then sees every management frame on the channel
+ *          (beacons, probes, other networks' traffic) in the Wi-Fi task, so
+ *          it is off by default; RSSI reads 0 (unknown) on those cores.
+ * @{ */
+#ifndef ESPNOW_RSSI_PROMISC
+#define ESPNOW_RSSI_PROMISC        0
+#endif
+/** @} */
+
+/**
+ * @name Time Sync
+ * @brief TIME_SYNC exchanges the ICM runs against its peers (TimeSync.h).
+ * @details Peers are probed every ESPNOW_TSYNC_FAST_MS until they report a lock,
+ *          then every ESPNOW_TSYNC_PERIOD_MS. Round trips longer than twice the
+ *          recent minimum plus the slack are treated as queued and skipped.
+ * @{ */
+#ifndef ESPNOW_TSYNC_PERIOD_MS
+#define ESPNOW_TSYNC_PERIOD_MS     10000
+#endif
+#ifndef ESPNOW_TSYNC_FAST_MS
+#define ESPNOW_TSYNC_FAST_MS       1000
+#endif
+#ifndef ESPNOW_TSYNC_SLOTS
+#define ESPNOW_TSYNC_SLOTS         ESPNOW_PEER_CAPACITY   // peers the ICM tracks; allocated on first probe
+#endif
+#ifndef ESPNOW_TSYNC_STALE_MS
+#define ESPNOW_TSYNC_STALE_MS      (3 * ESPNOW_TSYNC_PERIOD_MS)   // unprobed this long, a slot may be reused
+#endif
+#ifndef ESPNOW_TSYNC_WINDOW
+#define ESPNOW_TSYNC_WINDOW        8       // round trips in the delay filter
+#endif
+#ifndef ESPNOW_TSYNC_SLACK_US
+#define ESPNOW_TSYNC_SLACK_US      1000
+#endif
+#ifndef ESPNOW_TSYNC_STEP_US
+#define ESPNOW_TSYNC_STEP_US       5000    // larger errors step the clock instead of slewing
+#endif
+#ifndef ESPNOW_TSYNC_SKEW_SPAN_MS
+#define ESPNOW_TSYNC_SKEW_SPAN_MS  60000   // shortest baseline for a skew estimate
+#endif
+/** @} */
+
+/**
+ * @name Scheduled Actuation
+ * @brief SET_RELAY_AT queue on relay nodes (RelayAt.h, adapters/RelaySchedule.h).
+ * @details A write that arrives up to ESPNOW_RELAY_AT_GRACE_MS after its instant
+ *          is applied at once; later ones, and ones beyond the horizon, are refused.
+ * @{ */
+#ifndef ESPNOW_RELAY_AT_MAX
+#define ESPNOW_RELAY_AT_MAX        16      // queued writes per node
+#endif
+#ifndef ESPNOW_RELAY_AT_GRACE_MS
+#define ESPNOW_RELAY_AT_GRACE_MS   20
+#endif
+#ifndef ESPNOW_RELAY_AT_HORIZON_MS
+#define ESPNOW_RELAY_AT_HORIZON_MS 60000
+#endif
+/** @} */
+
+/**
+ * @name Firmware Update
+ * @brief Windowed image transfer to the inactive OTA slot (Ota.h, OtaRx.h, adapters/OtaTx.h).
+ * @details Nodes buffer ESPNOW_OTA_WINDOW chunks; the ICM polls FW_STATUS once a
+ *          window is out and resends only the holes.
+ * @{ */
+#ifndef ESPNOW_OTA_CHUNK
+#define ESPNOW_OTA_CHUNK           224     // image bytes per FW_CHUNK, <= FW_CHUNK_MAX
+#endif
+#ifndef ESPNOW_OTA_WINDOW
+#define ESPNOW_OTA_WINDOW          16      // chunks in flight per target, 2..32
+#endif
+#ifndef ESPNOW_OTA_TARGETS
+#define ESPNOW_OTA_TARGETS         48      // nodes per session on the ICM
+#endif
+#ifndef ESPNOW_OTA_MAX_MISSES
+#define ESPNOW_OTA_MAX_MISSES      5       // status polls lost in a row before a target is dropped
+#endif
+#ifndef ESPNOW_OTA_COMMIT_TIMEOUT_MS
+#define ESPNOW_OTA_COMMIT_TIMEOUT_MS 5000  // esp_ota_end() validates the whole image
+#endif
+#ifndef ESPNOW_OTA_REBOOT_MS
+#define ESPNOW_OTA_REBOOT_MS       500     // after the commit answer, so it gets out
+#endif
+/** @} */
+
+/**
+ * @name Dispatch Profiling
+ * @brief Per-opcode cost of the receive path (onRecv -> handler -> response commit).
+ * @details Off by default. With 1, global operator new is replaced to count the
+ *          service task's allocations and the stack below onRecv() is painted
+ *          before each frame, so timings include neither.
+ * @{ */
+#ifndef ESPNOW_PROFILE
+#define ESPNOW_PROFILE             0
+#endif
+#ifndef ESPNOW_PROFILE_OPS
+#define ESPNOW_PROFILE_OPS         24      // distinct opcode/direction keys tracked
+#endif
+#ifndef ESPNOW_PROFILE_INJECT_DEPTH
+#define ESPNOW_PROFILE_INJECT_DEPTH 8      // inject() queue, power of two
+#endif
+/** @} */
+
+#endif // ESPNOW_CONFIG_H
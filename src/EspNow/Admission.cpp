@@ -0,0 +1,106 @@
+#include "Admission.h"
+#include "Opcodes.h"
+#include <cstring>
+
+namespace espnow {
+
+static_assert((ESPNOW_ADMIT_SLOTS & (ESPNOW_ADMIT_SLOTS - 1)) == 0, "ESPNOW_ADMIT_SLOTS must be a power of two");
+static_assert(ESPNOW_ADMIT_PROBE >= 1 && ESPNOW_ADMIT_PROBE <= ESPNOW_ADMIT_SLOTS, "ESPNOW_ADMIT_PROBE out of range");
+
+bool TokenBucket::take(uint32_t nowMs, uint16_t ratePerSec, uint16_t burst){
+  if(!ratePerSec) return true;                 // unlimited
+  uint32_t cap = uint32_t(burst) * 1000u;
+  if(milli == UINT32_MAX) milli = cap;
+  else{
+    uint64_t m = milli + uint64_t(nowMs - lastMs) * ratePerSec;
+    milli = m > cap ? cap : uint32_t(m);
+  }
+  lastMs = nowMs;
+  if(milli < 1000u) return false;
+  milli -= 1000u;
+  return true;
+}
+
+// FNV-1a over the tail first, as Peers does.
+static size_t slotHash(const uint8_t mac[6]){
+  uint32_t h = 2166136261u;
+  for(int i = 5; i >= 0; --i){ h ^= mac[i]; h *= 16777619u; }
+  return h & (ESPNOW_ADMIT_SLOTS - 1);
+}
+
+static inline bool quarantineActive(uint32_t untilMs, uint32_t nowMs){
+  return untilMs && (int32_t)(nowMs - untilMs) < 0;
+}
+
+Admission::Slot* Admission::find(const uint8_t mac[6]){
+  size_t h = slotHash(mac);
+  for(size_t k = 0; k < ESPNOW_ADMIT_PROBE; ++k){
+    Slot& s = slots_[(h + k) & (ESPNOW_ADMIT_SLOTS - 1)];
+    if(s.used && std::memcmp(s.mac, mac, 6) == 0) return &s;
+  }
+  return nullptr;
+}
+
+// A free slot in the probe window, else the one idle longest; quarantined
+// senders go last so a MAC storm can't flush them out cheaply.
+Admission::Slot* Admission::claim(const uint8_t mac[6], uint32_t nowMs){
+  size_t h = slotHash(mac);
+  Slot* victim = nullptr;
+  for(size_t k = 0; k < ESPNOW_ADMIT_PROBE; ++k){
+    Slot& s = slots_[(h + k) & (ESPNOW_ADMIT_SLOTS - 1)];
+    if(!s.used){ victim = &s; break; }
+    if(!victim) { victim = &s; continue; }
+    bool sq = quarantineActive(s.untilMs, nowMs), vq = quarantineActive(victim->untilMs, nowMs);
+    if(sq != vq){ if(vq) victim = &s; continue; }
+    if(nowMs - s.b.lastMs > nowMs - victim->b.lastMs) victim = &s;
+  }
+  if(victim->used) st_.evictions++;
+  std::memcpy(victim->mac, mac, 6);
+  victim->used = true; victim->untilMs = 0; victim->b = TokenBucket{};
+  return victim;
+}
+
+bool Admission::admit(const uint8_t mac[6], uint8_t type, TokenBucket* pinned, uint32_t nowMs){
+  bool ok = true;
+  portENTER_CRITICAL(&mux_);
+  if(pinned){
+    if(!pinned->take(nowMs, ESPNOW_ADMIT_PEER_RATE, ESPNOW_ADMIT_PEER_BURST)){ st_.peerShed++; ok = false; }
+  }else{
+    Slot* s = find(mac);
+    if(!s) s = claim(mac, nowMs);
+    if(quarantineActive(s->untilMs, nowMs)){ st_.quarantineDrops++; ok = false; }
+    else if(!s->b.take(nowMs, ESPNOW_ADMIT_STRANGER_RATE, ESPNOW_ADMIT_STRANGER_BURST)){
+      s->untilMs = (nowMs + ESPNOW_ADMIT_QUARANTINE_MS) | 1u;
+      st_.quarantined++; st_.strangerShed++; ok = false;
+    }
+    else if(!shared_.take(nowMs, ESPNOW_ADMIT_SHARED_RATE, ESPNOW_ADMIT_SHARED_BURST)){ st_.strangerShed++; ok = false; }
+  }
+  if(ok && type == PAIR_EXCHANGE && !pair_.take(nowMs, ESPNOW_ADMIT_PAIR_RATE, ESPNOW_ADMIT_PAIR_BURST)){ st_.pairShed++; ok = false; }
+  portEXIT_CRITICAL(&mux_);
+  return ok;
+}
+
+bool Admission::quarantined(const uint8_t mac[6], uint32_t nowMs){
+  bool q = false;
+  portENTER_CRITICAL(&mux_);
+  Slot* s = find(mac);
+  if(s && quarantineActive(s->untilMs, nowMs)){ st_.quarantineDrops++; q = true; }
+  portEXIT_CRITICAL(&mux_);
+  return q;
+}
+
+void Admission::forgive(const uint8_t mac[6]){
+  portENTER_CRITICAL(&mux_);
+  Slot* s = find(mac);
+  if(s) s->used = false;
+  portEXIT_CRITICAL(&mux_);
+}
+
+Admission::Stats Admission::stats() const {
+  portENTER_CRITICAL(&mux_);
+  Stats s = st_;
+  portEXIT_CRITICAL(&mux_);
+  return s;
+}
+
+} // namespace espnow
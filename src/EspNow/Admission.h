@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include "../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Token bucket in milli-tokens; refilled from the elapsed time on each take().
+struct TokenBucket {
+  uint32_t milli{UINT32_MAX};   // UINT32_MAX = untouched, starts full
+  uint32_t lastMs{0};
+  bool take(uint32_t nowMs, uint16_t ratePerSec, uint16_t burst);
+};
+
+// Receive admission, checked before a frame costs anything (peer learning,
+// seq window, dispatch). Pinned peers spend their own bucket (Peer::admit).
+// Every other sender gets a small bucket of its own plus the one all strangers
+// share; overrunning its own puts it in quarantine, and radioRx() then drops
+// its frames before they reach the RX ring. PAIR_EXCHANGE re-registers the
+// driver peer, so it also spends a node-wide pairing bucket whoever sends it.
+// All lookups are hashed, O(1).
+class Admission {
+public:
+  struct Stats {
+    uint32_t peerShed;        // pinned peers over ESPNOW_ADMIT_PEER_RATE
+    uint32_t strangerShed;    // other senders over their own or the shared rate
+    uint32_t pairShed;        // PAIR_EXCHANGE over ESPNOW_ADMIT_PAIR_RATE
+    uint32_t quarantined;     // senders put in quarantine
+    uint32_t quarantineDrops; // frames from quarantined senders
+    uint32_t evictions;       // stranger slots reused while still tracked
+  };
+
+  // Service task. pinned = the sender's Peer::admit when it is pinned, else nullptr.
+  bool admit(const uint8_t mac[6], uint8_t type, TokenBucket* pinned, uint32_t nowMs);
+  // Any task (radioRx). Counts the drop when true.
+  bool quarantined(const uint8_t mac[6], uint32_t nowMs);
+  // The sender was paired: lift its quarantine.
+  void forgive(const uint8_t mac[6]);
+  Stats stats() const;
+
+private:
+  struct Slot {
+    uint8_t     mac[6];
+    bool        used;
+    uint32_t    untilMs;      // quarantine end, 0 = none
+    TokenBucket b;
+  };
+  Slot* find(const uint8_t mac[6]);
+  Slot* claim(const uint8_t mac[6], uint32_t nowMs);
+
+  Slot        slots_[ESPNOW_ADMIT_SLOTS]{};
+  TokenBucket shared_;
+  TokenBucket pair_;
+  Stats       st_{};
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+} // namespace espnow
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "Opcodes.h"
+
+namespace espnow {
+
+// BUNDLE wire format: several requests in one frame, one reply frame back.
+//   request : n, then n x { type, len, body[len] }
+//   response: n, then n x { type, status, len, body[len] }   (same order)
+// Sub-handlers see an ordinary request (same flags/corr as the bundle).
+enum : uint8_t {
+  BUNDLE_OK       = 0,
+  BUNDLE_REJECTED = 1,   // handler returned false
+  BUNDLE_NO_ROOM  = 2,   // answer did not fit in what was left of the reply frame
+  BUNDLE_BAD      = 3,   // truncated item, or opcode not allowed in a bundle (bundleAllows)
+};
+
+// Opcodes a bundle may carry: reads and plain writes that need nothing but the
+// item itself. Everything else travels in its own frame: transport (BUNDLE,
+// SEG_ACK), firmware, TIME_SYNC (t2/t3 belong to its frame), restarts, peer
+// management, topology pushes and pushed reports.
+static inline bool bundleAllows(uint8_t type){
+  switch(type){
+    case GET_TEMP: case GET_TIME: case GET_FAN_MODE: case GET_LOGS: case GET_FAULTS:
+    case GET_TOPOLOGY: case GET_LINKSTATS:
+    case BUZZ_PING: case LED_PING: case SET_FAN_MODE: case SILENCE_OUTPUTS: case SET_TIME:
+    case GET_RELAY_STATES: case SET_RELAY: case SET_GROUP: case SET_RELAY_AT:
+    case GET_TFLUNA_RAW: case GET_ENV: case GET_LUX: case SET_THRESHOLDS: case GET_PRESENCE:
+    case SENS_SUBSCRIBE:
+    case GET_VI: case GET_POWER_SOURCE: case SET_POWER_GROUPS:
+    case PUSH_CONFIG:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Builds a bundle request in caller memory.
+struct BundleWriter {
+  uint8_t* buf;
+  uint16_t cap;
+  uint16_t len;
+
+  BundleWriter(uint8_t* b, uint16_t c) : buf(b), cap(c), len(c ? 1 : 0) { if(c) buf[0] = 0; }
+  bool add(uint8_t type, const void* body=nullptr, uint8_t blen=0){
+    if(!cap || buf[0] == 0xFF || len + 2u + blen > cap) return false;
+    buf[len++] = type; buf[len++] = blen;
+    if(blen){ std::memcpy(buf + len, body, blen); len += blen; }
+    buf[0]++;
+    return true;
+  }
+};
+
+struct BundleItem {
+  uint8_t        type;
+  uint8_t        status;
+  uint8_t        len;
+  const uint8_t* body;
+};
+
+// Walks a bundle response; stops at the first truncated item.
+struct BundleReader {
+  const uint8_t* p;
+  uint16_t       left;
+  uint8_t        remaining;
+
+  BundleReader(const uint8_t* b, uint16_t n) : p(b), left(n), remaining(0) {
+    if(n){ remaining = b[0]; p++; left--; }
+  }
+  bool next(BundleItem& it){
+    if(!remaining || left < 3 || left < 3u + p[2]) return false;
+    it.type = p[0]; it.status = p[1]; it.len = p[2]; it.body = p + 3;
+    p += 3u + it.len; left -= (uint16_t)(3u + it.len); remaining--;
+    return true;
+  }
+};
+
+} // namespace espnow
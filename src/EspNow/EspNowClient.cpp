@@ -0,0 +1,256 @@
+#include "EspNowCore.h"
+#include "Opcodes.h"
+
+#include <cstring>
+#include <climits>
+
+#include <Arduino.h>
+#include <esp_system.h>
+
+namespace espnow {
+
+enum : uint8_t { PS_FREE=0, PS_CLAIMED=1, PS_WAIT=2, PS_SENT=3, PS_CANCEL=4 };
+
+uint16_t EspNowCore::reqTimeoutMs(uint8_t type) const {
+  if(reqTimeout_[type]) return reqTimeout_[type];
+  switch(type){
+    case GET_LOGS:       return ESPNOW_REQ_TIMEOUT_MS * 4;   // SD read on the far side
+    case FW_BEGIN:       return ESPNOW_REQ_TIMEOUT_MS * 4;   // partition erase
+    case FW_COMMIT:      return ESPNOW_OTA_COMMIT_TIMEOUT_MS;
+    case BUNDLE:
+    case GET_TOPOLOGY:
+    case PUSH_TOPOLOGY:
+    case PUSH_TOPO_DELTA:
+    case PUSH_CONFIG:    return ESPNOW_REQ_TIMEOUT_MS * 2;   // TLV encode/decode + NVS, several handlers
+    default:             return ESPNOW_REQ_TIMEOUT_MS;
+  }
+}
+
+// Skip 0 (untracked) and ids still pending or tallied after wrap-around.
+uint16_t EspNowCore::allocCorrLocked(){
+  uint16_t corr = 0;
+  for(bool clash = true; clash; ){
+    corr = nextCorr_++;
+    if(!nextCorr_) nextCorr_ = 1;
+    clash = (corr == 0);
+    for(auto& e : pending_) if(e.state != PS_FREE && e.corr == corr) clash = true;
+    for(auto& t : tally_) if(t.corr == corr) clash = true;
+  }
+  return corr;
+}
+
+uint16_t EspNowCore::request(const uint8_t mac[6], uint8_t type, const void* payload, uint16_t len,
+                             ReqDone cb, void* ctx, uint8_t retries){
+  if(!started_ || !mac || len > sizeof(Pending::payload) || (len && !payload)) return 0;
+  if(mac[0] & 0x01) return 0;     // broadcast/multicast would complete on the first of many answers
+
+  Pending* p = nullptr;
+  uint16_t corr = 0;
+  portENTER_CRITICAL(&reqMux_);
+  for(auto& e : pending_) if(e.state == PS_FREE){ p = &e; break; }
+  if(p){
+    corr = allocCorrLocked();
+    p->state = PS_CLAIMED;
+    p->corr  = corr;
+  }
+  portEXIT_CRITICAL(&reqMux_);
+  if(!p) return 0;
+
+  std::memcpy(p->mac, mac, 6);
+  p->type = type; p->len = len; p->attempts = 0; p->retries = retries;
+  p->cb = cb; p->ctx = ctx; p->sentMs = 0; p->seq = 0; p->dueMs = millis();
+  if(len) std::memcpy(p->payload, payload, len);
+
+  portENTER_CRITICAL(&reqMux_);
+  p->state = PS_WAIT;
+  portEXIT_CRITICAL(&reqMux_);
+  wake(NOTIFY_REQ);
+  return corr;
+}
+
+uint16_t EspNowCore::request(const uint8_t mac[6], uint8_t type, const void* payload, uint16_t len,
+                             ReqFuture& fut, uint8_t retries){
+  fut.done = false; fut.len = 0; fut.rttMs = 0; fut.status = REQ_CANCELLED;
+  fut.core = this; fut.corr = 0;
+  fut.corr = request(mac, type, payload, len, &ReqFuture::complete, &fut, retries);
+  return fut.corr;
+}
+
+bool ReqFuture::wait(uint32_t timeoutMs){
+  if(!corr) return done;
+  waiter = xTaskGetCurrentTaskHandle();
+  TickType_t start = xTaskGetTickCount(), span = pdMS_TO_TICKS(timeoutMs);
+  while(!done){
+    TickType_t used = xTaskGetTickCount() - start;
+    if(used >= span || ulTaskNotifyTake(pdTRUE, span - used) == 0) break;
+  }
+  if(!done){
+    // Still pending with ctx == this. Cancel it and wait for the completion
+    // (REQ_CANCELLED, or an answer that raced the cancel) before returning.
+    core->cancelRequest(corr);
+#ifndef ESPNOW_HOST_SIM
+    while(!done) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESPNOW_REQ_BACKOFF_MS));
+#endif
+  }
+  waiter = nullptr;
+  return done && status != REQ_CANCELLED;
+}
+
+bool EspNowCore::cancelRequest(uint16_t corr){
+  bool hit = false;
+  portENTER_CRITICAL(&reqMux_);
+  for(auto& e : pending_){
+    if(e.corr != corr || (e.state != PS_WAIT && e.state != PS_SENT)) continue;
+    e.state = PS_CANCEL; hit = true; break;
+  }
+  portEXIT_CRITICAL(&reqMux_);
+  if(hit) wake(NOTIFY_REQ);
+  return hit;
+}
+
+size_t EspNowCore::pendingRequests() const {
+  size_t n = 0;
+  portENTER_CRITICAL(&reqMux_);
+  for(auto& e : pending_) if(e.state != PS_FREE) n++;
+  portEXIT_CRITICAL(&reqMux_);
+  return n;
+}
+
+EspNowCore::Pending* EspNowCore::findPending(const uint8_t mac[6], uint16_t corr){
+  for(auto& e : pending_){
+    if(e.corr != corr || (e.state != PS_WAIT && e.state != PS_SENT)) continue;
+    if(std::memcmp(e.mac, mac, 6) == 0) return &e;
+  }
+  return nullptr;
+}
+
+void EspNowCore::retryOrFail(Pending& p, ReqStatus why, uint32_t nowMs){
+  if(p.attempts > p.retries){ finishPending(p, why, nullptr, 0, nowMs); return; }
+  uint8_t shift = p.attempts > 4 ? 4 : (uint8_t)(p.attempts - 1);
+  uint32_t backoff = ((uint32_t)ESPNOW_REQ_BACKOFF_MS << shift) + (esp_random() % (ESPNOW_REQ_JITTER_MS + 1));
+  portENTER_CRITICAL(&reqMux_);
+  if(p.state == PS_SENT || p.state == PS_WAIT){ p.state = PS_WAIT; p.dueMs = nowMs + backoff; }
+  portEXIT_CRITICAL(&reqMux_);
+}
+
+void EspNowCore::finishPending(Pending& p, ReqStatus st, const uint8_t* payload, uint16_t len, uint32_t nowMs){
+  ReqResult r{};
+  r.status   = st;
+  r.type     = p.type;
+  r.corr     = p.corr;
+  r.attempts = p.attempts;
+  r.rttMs    = (st == REQ_OK || st == REQ_REMOTE_ERR || st == REQ_DUPLICATE) ? (nowMs - p.sentMs) : 0;
+  r.payload  = payload;
+  r.len      = len;
+  uint8_t mac[6]; std::memcpy(mac, p.mac, 6);
+  ReqDone cb = p.cb; void* ctx = p.ctx;
+  if(r.rttMs) peers_.noteRtt(mac, r.rttMs);
+  portENTER_CRITICAL(&reqMux_);
+  p.state = PS_FREE;
+  portEXIT_CRITICAL(&reqMux_);
+  if(cb) cb(mac, r, ctx);
+}
+
+// Send status drives retries: a NACK means the peer never got it, so don't wait for the deadline.
+void EspNowCore::onRequestTxDone(const uint8_t mac[6], uint16_t corr, bool acked){
+  if(acked) return;
+  Pending* p = findPending(mac, corr);
+  if(p && p->state == PS_SENT) retryOrFail(*p, REQ_SEND_FAIL, millis());
+}
+
+bool EspNowCore::groupSet(uint8_t group, uint32_t chMask, uint32_t onMask,
+                          GroupDone cb, void* ctx, uint8_t expected){
+  if(!started_) return false;
+  SetGroupPayload p{ group, chMask, onMask };
+  if(!cb) return broadcast(SET_GROUP, &p, sizeof(p), 0);
+
+  Tally* t = nullptr;
+  portENTER_CRITICAL(&reqMux_);
+  for(auto& e : tally_) if(!e.corr){ t = &e; break; }
+  if(t){
+    t->corr = allocCorrLocked();
+    t->group = group; t->expected = expected; t->acks = 0; t->nacks = 0;
+    t->dueMs = millis() + ESPNOW_GROUP_ACK_MS; t->cb = cb; t->ctx = ctx;
+  }
+  portEXIT_CRITICAL(&reqMux_);
+  if(!t) return false;
+  if(broadcast(SET_GROUP, &p, sizeof(p), t->corr)){ wake(NOTIFY_REQ); return true; }
+  portENTER_CRITICAL(&reqMux_);
+  t->corr = 0;
+  portEXIT_CRITICAL(&reqMux_);
+  return false;
+}
+
+void EspNowCore::finishTally(size_t i, bool complete){
+  Tally t = tally_[i];
+  portENTER_CRITICAL(&reqMux_);
+  tally_[i].corr = 0;
+  portEXIT_CRITICAL(&reqMux_);
+  GroupResult r{ t.group, t.corr, t.expected, t.acks, t.nacks, complete };
+  if(t.cb) t.cb(r, t.ctx);
+}
+
+bool EspNowCore::onResponse(const uint8_t mac[6], const EspNowMsg& in){
+  if(!in.corr) return false;
+  if(in.type == SET_GROUP){
+    for(size_t i = 0; i < ESPNOW_GROUP_TALLY_MAX; ++i){
+      Tally& t = tally_[i];
+      if(t.corr != in.corr) continue;
+      if(in.flags & FLAG_ERR) t.nacks++; else t.acks++;
+      if(t.expected && (uint16_t)(t.acks + t.nacks) >= t.expected) finishTally(i, true);
+      return true;
+    }
+    return false;
+  }
+  Pending* p = findPending(mac, in.corr);
+  if(!p || p->type != in.type) return false;
+  ReqStatus st = (in.flags & FLAG_ERR) ? REQ_REMOTE_ERR : (in.flags & FLAG_DUP) ? REQ_DUPLICATE : REQ_OK;
+  finishPending(*p, st, in.payload, in.payload_len, millis());
+  return true;
+}
+
+void EspNowCore::extendPending(const uint8_t mac[6], uint16_t corr, uint32_t nowMs){
+  Pending* p = findPending(mac, corr);
+  if(!p) return;
+  uint32_t due = nowMs + reqTimeoutMs(p->type);
+  portENTER_CRITICAL(&reqMux_);
+  if(p->state == PS_SENT && (int32_t)(due - p->dueMs) > 0) p->dueMs = due;
+  portEXIT_CRITICAL(&reqMux_);
+}
+
+uint32_t EspNowCore::serviceRequests(uint32_t nowMs){
+  uint32_t next = UINT32_MAX;
+  for(auto& p : pending_){
+    uint8_t st = p.state;
+    if(st == PS_CANCEL){ finishPending(p, REQ_CANCELLED, nullptr, 0, nowMs); continue; }
+    if(st != PS_WAIT && st != PS_SENT) continue;
+    int32_t left = (int32_t)(p.dueMs - nowMs);
+    if(left > 0){ if((uint32_t)left < next) next = (uint32_t)left; continue; }
+
+    if(st == PS_SENT){                       // response deadline passed
+      retryOrFail(p, REQ_TIMEOUT, nowMs);
+      if(p.state == PS_WAIT){ uint32_t d = p.dueMs - nowMs; if(d < next) next = d; }
+      continue;
+    }
+    if(!p.seq) p.seq = peers_.nextTxSeq(p.mac);
+    if(!sendFrame(p.mac, p.type, 0x00, p.corr, p.payload, p.len, txPrioFor(p.type, 0x00), p.seq)){
+      p.dueMs = nowMs + ESPNOW_REQ_BACKOFF_MS;   // TX pool full: try again shortly, not an attempt
+      if(ESPNOW_REQ_BACKOFF_MS < next) next = ESPNOW_REQ_BACKOFF_MS;
+      continue;
+    }
+    uint16_t to = reqTimeoutMs(p.type);
+    portENTER_CRITICAL(&reqMux_);
+    if(p.state == PS_WAIT){ p.attempts++; p.sentMs = nowMs; p.dueMs = nowMs + to; p.state = PS_SENT; }
+    portEXIT_CRITICAL(&reqMux_);
+    if(to < next) next = to;
+  }
+  for(size_t i = 0; i < ESPNOW_GROUP_TALLY_MAX; ++i){
+    if(!tally_[i].corr || !tally_[i].cb) continue;
+    int32_t left = (int32_t)(tally_[i].dueMs - nowMs);
+    if(left <= 0){ finishTally(i, !tally_[i].expected); continue; }
+    if((uint32_t)left < next) next = (uint32_t)left;
+  }
+  return next;
+}
+
+} // namespace espnow
@@ -5,31 +5,69 @@
 #include "Frame.h"
 #include "TopologyTlv.h"
 #include "RoleFactory.h"
+#include "Bundle.h"
+#include "LinkStats.h"
+#include "EspNowRadio.h"
 
+#include <cstddef>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include <Arduino.h>
-#include <WiFi.h>
-#include <esp_now.h>
 #include <esp_system.h>
-#include <esp_wifi.h>
+#include <esp_timer.h>
 
 namespace espnow {
 
 static EspNowCore* g_core = nullptr;
 
+
 EspNowCore* EspNowCore::instance(){ return g_core; }
 
+void EspNowCore::setInstance(EspNowCore* c){ g_core = c; }
+
 bool EspNowCore::begin(){
   g_core = this;
-  WiFi.mode(WIFI_STA);
-  if(esp_now_init() != ESP_OK){ return false; }
-  esp_now_register_send_cb(&EspNowCore::onSendStatic);
-  esp_now_register_recv_cb(&EspNowCore::onRecvStatic);
+#ifndef ESPNOW_HOST_SIM
+  if(!radio_) radio_ = defaultRadio();
+#endif
+  if(!radio_ || !radio_->begin(this)) return false;
+  rebuildTopologyBlob();
+#ifndef ESPNOW_HOST_SIM
+  if(!svcTask_){
+    if(xTaskCreatePinnedToCore(&EspNowCore::svcTaskStatic, "EspNowSvc", ESPNOW_SVC_TASK_STACK, this,
+                               ESPNOW_SVC_TASK_PRIORITY, &svcTask_, ESPNOW_SVC_TASK_CORE) != pdPASS){
+      svcTask_ = nullptr; return false;
+    }
+  }
+#endif
+  if(!boot_) boot_ = uint16_t(esp_random() % 0xFFFF + 1);
+  started_ = true;
   return true;
 }
 
+void EspNowCore::wake(uint32_t bits){
+  if(svcTask_) xTaskNotify(svcTask_, bits, eSetBits);
+  else wakeBits_ |= bits;
+}
+
+EspNowCore::RxStats EspNowCore::rxStats() const {
+  RxStats s{};
+  s.received   = rxReceived_;
+  s.dispatched = rxDispatched_;
+  s.dropsFull  = rxDropsFull_;
+  s.dropsLen   = rxDropsLen_;
+  s.respDrops  = respDrops_;
+  s.seqDups    = seqDups_;
+  s.dupReruns  = dupReruns_;
+  s.seqResyncs = seqResyncs_;
+  s.depth      = (uint16_t)rx_.depth();
+  s.highWater  = (uint16_t)rx_.highWater();
+  s.capacity   = (uint16_t)rx_.capacity();
+  return s;
+}
+
 void EspNowCore::setServices(const ServiceRefs* s){
   services_ = s;
   if(role_) role_->mount(s);
@@ -41,81 +79,601 @@ void EspNowCore::setRoleAdapter(IRoleAdapter* r){
 }
 
 bool EspNowCore::addPeer(const uint8_t mac[6], bool encrypt, const uint8_t* lmk){
-  esp_now_peer_info_t p{};
-  std::memcpy(p.peer_addr, mac, 6);
-  p.channel = 0;
-  p.ifidx = WIFI_IF_STA;
-  p.encrypt = encrypt;
-  if(encrypt && lmk) std::memcpy(p.lmk, lmk, 16);
-  esp_now_del_peer(mac);
-  if(esp_now_add_peer(&p) == ESP_OK){ peers_.add(mac, 0); return true; }
+  if(!radio_) return false;
+  radio_->delPeer(mac);
+  if(radio_->addPeer(mac, encrypt, lmk)){
+    peers_.pin(mac, 0); peers_.resetSeq(mac); admit_.forgive(mac);   // (re)pairing starts a new window
+    forgetResponses(mac);
+    return true;
+  }
   return false;
 }
 
+bool EspNowCore::pairPeer(const uint8_t mac[6]){
+  if(!radio_) return false;
+  const Peer* p = peers_.find(mac);
+  if(p && (p->flags & PEER_PINNED)) return addPeer(mac);
+  uint8_t old[6];
+  while(peers_.pendingCount() >= ESPNOW_PAIR_PENDING_MAX && peers_.evictOldestPending(old)) radio_->delPeer(old);
+  radio_->delPeer(mac);
+  if(!radio_->addPeer(mac, false, nullptr)) return false;
+  if(!peers_.addPending(mac)){ radio_->delPeer(mac); return false; }
+  peers_.resetSeq(mac);
+  forgetResponses(mac);
+  return true;
+}
+
+// Rides on whatever wakes the service task: a stale slot only matters once
+// a new peer needs it, and that arrives as a frame.
+void EspNowCore::servicePeers(uint32_t nowMs){
+  if((uint32_t)(nowMs - peerSweepMs_) < ESPNOW_PEER_SWEEP_MS) return;
+  peerSweepMs_ = nowMs;
+  uint8_t mac[6];
+  while(peers_.evictStale(nowMs, mac)){
+    if(radio_) radio_->delPeer(mac);
+    forgetResponses(mac);
+  }
+}
+
 bool EspNowCore::removePeer(const uint8_t mac[6]){
   peers_.remove(mac);
-  return esp_now_del_peer(mac) == ESP_OK;
+  return radio_ && radio_->delPeer(mac);
+}
+
+bool EspNowCore::beginFrame(const uint8_t mac[6], uint8_t type, uint8_t flags, uint16_t corr, TxView& v){
+  v = TxView{ nullptr, nullptr, 0 };
+  if(!started_ || !mac) return false;
+  TxFrame* f = tx_.alloc();
+  if(!f) return false;
+  std::memcpy(f->mac, mac, 6);
+  EspNowHeader* h = reinterpret_cast<EspNowHeader*>(f->buf);
+  h->type = type; h->flags = flags; h->corr = corr; h->seq = 0; h->boot = boot_;
+  v.frame = f;
+  v.body  = f->buf + sizeof(EspNowHeader);
+  v.cap   = (uint16_t)(ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader));
+  return true;
+}
+
+// Queues the frame; the service task hands it to the driver when its lane and peer allow.
+bool EspNowCore::commitFrame(TxView& v, uint16_t bodyLen, TxPrio prio){
+  if(!v.frame) return false;
+  if(bodyLen > v.cap){ abortFrame(v); return false; }
+  v.frame->len = (uint16_t)(sizeof(EspNowHeader) + bodyLen);
+  tx_.enqueue(v.frame, prio);
+  v = TxView{ nullptr, nullptr, 0 };
+  wake(NOTIFY_TX);
+  return true;
 }
 
-bool EspNowCore::sendFrame(const uint8_t* mac, uint8_t type, uint8_t flags, uint16_t corr, const void* payload, uint16_t len){
-  uint8_t buf[250];
-  if(len + sizeof(EspNowHeader) > sizeof(buf)) return false;
-  EspNowHeader* h = reinterpret_cast<EspNowHeader*>(buf);
-  h->type = type; h->flags = flags; h->corr = corr;
-  if(payload && len) std::memcpy(buf + sizeof(EspNowHeader), payload, len);
-  return esp_now_send(mac, buf, sizeof(EspNowHeader) + len) == ESP_OK;
+void EspNowCore::abortFrame(TxView& v){
+  if(v.frame) tx_.release(v.frame);
+  v = TxView{ nullptr, nullptr, 0 };
+}
+
+bool EspNowCore::sendFrame(const uint8_t* mac, uint8_t type, uint8_t flags, uint16_t corr, const void* payload, uint16_t len, TxPrio prio, uint16_t seq){
+  if(len + sizeof(EspNowHeader) > ESP_NOW_MAX_DATA_LEN) return false;
+  TxView v;
+  if(!beginFrame(mac, type, flags, corr, v)) return false;
+  reinterpret_cast<EspNowHeader*>(v.frame->buf)->seq = seq;
+  if(payload && len) std::memcpy(v.body, payload, len);
+  return commitFrame(v, len, prio);
 }
 
 bool EspNowCore::unicast(const uint8_t mac[6], uint8_t type, const void* payload, uint16_t len, uint16_t corr){
-  return sendFrame(mac, type, 0x00, corr, payload, len);
+  if(len + sizeof(EspNowHeader) > ESP_NOW_MAX_DATA_LEN) return sendLarge(mac, type, 0x00, corr, payload, len);
+  return sendFrame(mac, type, 0x00, corr, payload, len, txPrioFor(type, 0x00));
 }
 
 bool EspNowCore::broadcast(uint8_t type, const void* payload, uint16_t len, uint16_t corr){
   static const uint8_t bc[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
-  return sendFrame(bc, type, 0x00, corr, payload, len);
+  return sendFrame(bc, type, 0x00, corr, payload, len, txPrioFor(type, 0x00));
+}
+
+// Runs in the Wi-Fi task: record the status, matching happens in the service task.
+// The driver completes sends in order, so the n-th completion is for the n-th
+// accepted send; the ordinal counts even when the ring is full.
+void EspNowCore::radioTxDone(const uint8_t* mac, bool acked){
+  if(!mac) return;
+  uint32_t ord = txDoneOrd_++;
+  TxDoneSlot* s = txDone_.acquire();
+  if(s){
+    std::memcpy(s->mac, mac, 6);
+    s->acked = acked;
+    s->ord = ord;
+    txDone_.publish();
+  } // else: the in-flight frame ages out through TxScheduler::expired()
+  wake(NOTIFY_TX);
+}
+
+void EspNowCore::drainTxDone(){
+  while(TxDoneSlot* s = txDone_.front()){
+    TxFrame* f = tx_.complete(s->mac, s->ord);
+    bool acked = s->acked;
+    txDone_.pop();
+    if(f) onTxDone(f, acked);
+  }
+  uint32_t now = millis();
+  while(TxFrame* f = tx_.expired(now)) onTxDone(f, false);
+}
+
+void EspNowCore::pumpTx(){
+  while(TxFrame* f = tx_.next(millis())){
+    // Unicast requests are sequenced here (service task owns the peer table);
+    // request retries arrive with their first seq already set.
+    EspNowHeader* h = reinterpret_cast<EspNowHeader*>(f->buf);
+    if(!h->seq && !(f->mac[0] & 0x01) && !isResponse(h->flags) && !(h->flags & FLAG_SEG) && h->type != SEG_ACK)
+      h->seq = peers_.nextTxSeq(f->mac);
+    f->tag = txSendOrd_;        // set first: the completion may beat send()'s return
+    RadioErr e = radio_->send(f->mac, f->buf, f->len);
+    if(e == RADIO_OK){ txSendOrd_++; continue; }
+    if(e == RADIO_BUSY){ tx_.requeueFront(f); break; }   // driver queue full; retry on next completion
+    onTxDone(f, false);
+  }
+}
+
+void EspNowCore::onTxDone(TxFrame* f, bool acked){
+  const EspNowHeader* h = reinterpret_cast<const EspNowHeader*>(f->buf);
+  peers_.noteTx(f->mac, acked);
+  if(!isResponse(h->flags) && !(h->flags & FLAG_SEG) && h->corr) onRequestTxDone(f->mac, h->corr, acked);
+  if(txTap_) txTap_(f->mac, h->type, h->corr, acked);
+  tx_.finish(f, acked);
+}
+
+// Runs in the Wi-Fi task: copy into the ring and wake the service task, nothing else.
+void EspNowCore::radioRx(const uint8_t* mac, const uint8_t* data, int len, int32_t rssi){
+  if(!mac || !data) return;
+  if(len < (int)sizeof(EspNowHeader) || len > ESP_NOW_MAX_DATA_LEN){ rxDropsLen_++; return; }
+  if(admit_.quarantined(mac, millis())) return;     // a storm doesn't get to fill the ring
+  RxSlot* s = rx_.acquire();
+  if(!s){ rxDropsFull_++; return; }
+  std::memcpy(s->mac, mac, 6);
+  s->rssi = rssi;
+  s->rxUs = esp_timer_get_time();
+  s->len  = (uint16_t)len;
+  std::memcpy(s->data, data, len);
+  rx_.publish();
+  rxReceived_++;
+  wake(NOTIFY_RX);
 }
 
-void EspNowCore::onSendStatic(const uint8_t* mac_addr, esp_now_send_status_t status){
-  (void)mac_addr; (void)status;
+#if ESPNOW_PROFILE
+// Own ring, so the radio callback stays the only producer on rx_.
+bool EspNowCore::inject(const uint8_t mac[6], const uint8_t* frame, uint16_t len){
+  if(!mac || !frame || len < sizeof(EspNowHeader) || len > ESP_NOW_MAX_DATA_LEN) return false;
+  RxSlot* s = inj_.acquire();
+  if(!s) return false;
+  std::memcpy(s->mac, mac, 6);
+  s->rssi = 0;
+  s->rxUs = esp_timer_get_time();
+  s->len  = len;
+  std::memcpy(s->data, frame, len);
+  reinterpret_cast<EspNowHeader*>(s->data)->seq = 0;
+  inj_.publish();
+  wake(NOTIFY_RX);
+  return true;
 }
+#endif
 
-void EspNowCore::onRecvStatic(const uint8_t* mac, const uint8_t* data, int len){
-  int32_t rssi = 0;
-  if(g_core) g_core->onRecv(mac, data, len, rssi);
+#ifndef ESPNOW_HOST_SIM
+void EspNowCore::svcTaskStatic(void* arg){ static_cast<EspNowCore*>(arg)->svcLoop(); }
+
+void EspNowCore::svcLoop(){
+  for(;;){
+    uint32_t bits = 0;
+    uint32_t waitMs = service();
+    TickType_t wait = (waitMs == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(waitMs ? waitMs : 1);
+    xTaskNotifyWait(0, 0xFFFFFFFFu, &bits, wait);
+  }
+}
+#endif
+
+uint32_t EspNowCore::service(){
+  wakeBits_ = 0;
+  drainTxDone();
+  pumpTx();
+  // Drain in batches; yield between batches so equal-priority tasks still run.
+  while(rxBacklog()){
+    drainRx(ESPNOW_RX_BATCH);
+    drainTxDone();
+    pumpTx();
+    if(rxBacklog()) taskYIELD();
+  }
+  // Sleep until the next request deadline/backoff, or while TX is busy so lost
+  // completions age out and refused frames retry.
+  uint32_t now = millis();
+  uint32_t waitMs = serviceRequests(now);
+  uint32_t segMs  = serviceSeg(now);
+  if(segMs < waitMs) waitMs = segMs;
+  servicePeers(now);
+  uint32_t roleMs = role_ ? role_->tick(now) : UINT32_MAX;
+  if(roleMs < waitMs) waitMs = roleMs;
+  pumpTx();
+  if(ota_.rebootDue(now)) esp_restart();
+  uint32_t otaMs = ota_.rebootWaitMs(now);
+  if(otaMs < waitMs) waitMs = otaMs;
+  if((tx_.hasInFlight() || tx_.hasQueued()) && waitMs > ESPNOW_TX_DONE_TIMEOUT_MS) waitMs = ESPNOW_TX_DONE_TIMEOUT_MS;
+  return waitMs;
+}
+
+void EspNowCore::drainRx(size_t maxBatch){
+  for(size_t n = 0; n < maxBatch; ++n){
+    RxSlot* s = rx_.front();
+#if ESPNOW_PROFILE
+    if(!s && (s = inj_.front()) != nullptr){     // injected frames: not in RX stats
+      curRxUs_ = s->rxUs;
+      onRecv(s->mac, s->data, s->len, s->rssi);
+      inj_.pop();
+      continue;
+    }
+#endif
+    if(!s) break;
+    curRxUs_ = s->rxUs;
+    onRecv(s->mac, s->data, s->len, s->rssi);
+    rx_.pop();
+    rxDispatched_++;
+  }
 }
 
 void EspNowCore::onRecv(const uint8_t* mac, const uint8_t* data, int len, int32_t rssi){
   if(len < (int)sizeof(EspNowHeader)) return;
   const EspNowHeader* h = reinterpret_cast<const EspNowHeader*>(data);
-  EspNowMsg in{ h->type, h->flags, h->corr, data + sizeof(EspNowHeader), (uint16_t)(len - (int)sizeof(EspNowHeader)) };
-  peers_.updateSeen(mac, rssi, (uint32_t)millis());
+  EspNowMsg in{ h->type, h->flags, h->corr, data + sizeof(EspNowHeader), (uint16_t)(len - (int)sizeof(EspNowHeader)), h->seq, h->boot };
+#if ESPNOW_PROFILE
+  DispatchProfiler::Scope prof(prof_, profileKey(in.type, isResponse(in.flags)));
+#endif
+  uint32_t nowMs = millis();
+  Peer* sender = peers_.find(mac);
+  if(!admit_.admit(mac, in.type, (sender && (sender->flags & PEER_PINNED)) ? &sender->admit : nullptr, nowMs)) return;
+  peers_.updateSeen(mac, rssi, nowMs);
 
+  if(in.seq && !isResponse(in.flags)){
+    Peer* p = peers_.find(mac);
+    SeqVerdict sv = p ? peers_.checkSeq(*p, in.seq, in.boot) : SEQ_NEW;
+    if(sv == SEQ_RESYNC){ seqResyncs_++; forgetResponses(mac); }
+    if(sv == SEQ_DUP){ seqDups_++; answerDuplicate(mac, in); return; }
+  }
+
+  if(in.type == SEG_ACK && !(in.flags & FLAG_SEG)){ onSegAck(mac, in); return; }
+  if(in.flags & FLAG_SEG){ onSegData(mac, in); return; }   // dispatched once reassembled
+  dispatch(mac, in);
+}
+
+void EspNowCore::dispatch(const uint8_t* mac, const EspNowMsg& in){
   if(tap_) tap_(mac, in);
-  if(!role_) return;
-
-  uint8_t outBuf[256] = {0};
-  EspNowResp out{ outBuf, 0 };
-  if((in.flags & 0x01)==0){
-    bool ok = role_->handleRequest(in, out);
-    if(ok && out.out_len){
-      sendFrame(mac, in.type, (uint8_t)(in.flags|0x01), in.corr, out.out, out.out_len);
+  if(isResponse(in.flags)){ onResponse(mac, in); return; }
+  // Group frames are broadcast: non-members stay silent, even when an ACK is asked for.
+  if(in.type == SET_GROUP && (in.payload_len < 1 || !inGroup(in.payload[0]))) return;
+
+  // The adapter writes straight into the TX frame. If the pool is exhausted the
+  // request still runs (against scratch) but its answer is dropped.
+  uint8_t rf = asResponse(in.flags);
+  TxView v;
+  bool framed = beginFrame(mac, in.type, rf, in.corr, v);
+  EspNowResp out{ framed ? v.body : respScratch_, 0, framed ? v.cap : (uint16_t)sizeof(respScratch_) };
+  bool ok;
+  if(in.type == BUNDLE){
+    curMac_ = mac;                    // requesterMac() only; no large replies from a bundle
+    ok = handleBundle(in, out);
+    curMac_ = nullptr;
+  }else{
+    curMac_ = mac; curReq_ = &in; curLarge_ = nullptr; curLargeSent_ = false;
+    ok = handleLocal(in, out);
+    if(endLargeReply()){ abortFrame(v); return; }   // answered through a segmented transfer
+  }
+  // corr != 0 marks a tracked request: always answer so the caller's pending entry completes.
+  bool answer = ok ? (out.out_len || in.corr) : (in.corr != 0);
+  if(!answer){ abortFrame(v); return; }
+  if(!framed){ respDrops_++; return; }
+  if(!ok){
+    reinterpret_cast<EspNowHeader*>(v.frame->buf)->flags = (uint8_t)(rf | FLAG_ERR);
+    out.out_len = 0;
+  }
+  if(in.seq && in.corr) rememberResponse(mac, in, v.frame->buf, (uint16_t)(sizeof(EspNowHeader) + out.out_len));
+  if(!commitFrame(v, out.out_len, txPrioFor(in.type, rf))) respDrops_++;
+}
+
+void EspNowCore::rememberResponse(const uint8_t* mac, const EspNowMsg& in, const uint8_t* frame, uint16_t len){
+  DupResp& d = dupCache_[dupNext_++ % ESPNOW_DUP_RESP_CACHE];
+  std::memcpy(d.mac, mac, 6);
+  d.seq = in.seq;
+  d.boot = in.boot;
+  d.len = len;
+  std::memcpy(d.frame, frame, len);
+}
+
+// Answers cached for a sender's previous boot or pairing must never be replayed.
+void EspNowCore::forgetResponses(const uint8_t* mac){
+  for(auto& d : dupCache_) if(d.seq && std::memcmp(d.mac, mac, 6) == 0) d.seq = 0;
+}
+
+// A retried request whose first copy already ran: replay its answer if we still
+// have it. Otherwise a pure read runs again; anything else is answered with
+// FLAG_DUP and never runs twice.
+void EspNowCore::answerDuplicate(const uint8_t* mac, const EspNowMsg& in){
+  if(!in.corr) return;
+  for(auto& d : dupCache_){
+    const EspNowHeader* h = reinterpret_cast<const EspNowHeader*>(d.frame);
+    if(d.seq != in.seq || d.boot != in.boot || h->corr != in.corr || h->type != in.type || std::memcmp(d.mac, mac, 6) != 0) continue;
+    sendFrame(mac, h->type, h->flags, h->corr, d.frame + sizeof(EspNowHeader),
+              (uint16_t)(d.len - sizeof(EspNowHeader)), txPrioFor(h->type, h->flags));
+    return;
+  }
+  if(isPureRead(in.type)){ dupReruns_++; dispatch(mac, in); return; }
+  uint8_t rf = (uint8_t)(asResponse(in.flags) | FLAG_DUP);
+  sendFrame(mac, in.type, rf, in.corr, nullptr, 0, txPrioFor(in.type, rf));
+}
+
+bool EspNowCore::handleLocal(const EspNowMsg& in, EspNowResp& out){
+  switch(in.type){
+    case GET_LINKSTATS:   return handleLinkStats(in, out);
+    case PUSH_TOPO_DELTA: return handleTopoDelta(in, out);
+    case TIME_SYNC:       return handleTimeSync(in, out);
+    case FW_BEGIN:        return fromPinned() && ota_.onBegin(in, out);
+    case FW_CHUNK:        return fromPinned() && ota_.onChunk(in);
+    case FW_STATUS:       return fromPinned() && ota_.onStatus(in, out);
+    case FW_COMMIT:       return fromPinned() && ota_.onCommit(in, out, millis());
+    default:              return role_ && role_->handleRequest(in, out);
+  }
+}
+
+// Firmware only from peers registered through addPeer()/pairing (the ICM),
+// never from a sender that was merely heard.
+bool EspNowCore::fromPinned() const {
+  const Peer* p = curMac_ ? peers_.find(curMac_) : nullptr;
+  return p && (p->flags & PEER_PINNED);
+}
+
+// t3 is stamped here rather than at commit; the answer goes out on this pass.
+bool EspNowCore::handleTimeSync(const EspNowMsg& in, EspNowResp& out){
+  TimeSyncResp a;
+  if(out.out_cap < sizeof(a) || !tsync_.onProbe(in.payload, in.payload_len, curRxUs_, esp_timer_get_time(), a)) return false;
+  std::memcpy(out.out, &a, sizeof(a));
+  out.out_len = sizeof(a);
+  return true;
+}
+
+int64_t EspNowCore::networkTimeUs() const { return tsync_.toNetwork(esp_timer_get_time()); }
+
+bool EspNowCore::syncTime(const uint8_t mac[6]){
+  if(!mac) return false;
+  uint32_t nowMs = millis();
+  TimeSync::Slot* s = tsync_.slot(mac, nowMs);
+  if(!s) return false;
+  TimeSyncReq rq;
+  tsync_.makeProbe(*s, esp_timer_get_time(), nowMs, rq);
+  // No retries: a resent probe would carry a stale t1.
+  return request(mac, TIME_SYNC, &rq, sizeof(rq), &EspNowCore::timeSyncDone, this, 0) != 0;
+}
+
+void EspNowCore::timeSyncDone(const uint8_t mac[6], const ReqResult& r, void* ctx){
+  if(r.status != REQ_OK || r.len < sizeof(TimeSyncResp)) return;
+  auto* self = static_cast<EspNowCore*>(ctx);
+  TimeSyncResp a; std::memcpy(&a, r.payload, sizeof(a));
+  self->tsync_.onAnswer(mac, a, self->curRxUs_);
+}
+
+// One probe per pass so answers do not queue behind each other.
+uint32_t EspNowCore::serviceTimeSync(uint32_t nowMs){
+  uint32_t wait = UINT32_MAX;
+  bool sent = false;
+  for(const Peer* p = peers_.begin(); p && p != peers_.end(); ++p){
+    if(p->mac[0] & 0x01) continue;              // broadcast / multicast
+    if(!(p->flags & PEER_PINNED)) continue;     // auto-learned senders aren't ours to sync
+    const TimeSync::Slot* s = tsync_.find(p->mac);
+    if(!s && !tsync_.slot(p->mac, nowMs)) continue;   // table full: not due until one frees
+    uint32_t period = (s && s->synced) ? ESPNOW_TSYNC_PERIOD_MS : ESPNOW_TSYNC_FAST_MS;
+    uint32_t age = s ? nowMs - s->lastMs : period;
+    if(age >= period){
+      if(sent){ wait = 0; continue; }
+      syncTime(p->mac); sent = true; age = 0;
+    }
+    if(period - age < wait) wait = period - age;
+  }
+  return wait;
+}
+
+bool EspNowCore::handleLinkStats(const EspNowMsg& in, EspNowResp& out){
+  LinkStatsReq rq{ 0, 0 };
+  if(in.payload_len >= sizeof(rq)) std::memcpy(&rq, in.payload, sizeof(rq));
+  if(out.out_cap < sizeof(LinkStatsHdr)) return false;
+  size_t total = peers_.count();
+  size_t fit = (out.out_cap - sizeof(LinkStatsHdr)) / sizeof(LinkStat);
+  if(rq.max && rq.max < fit) fit = rq.max;
+  uint32_t now = millis();
+  LinkStatsHdr hdr{ (uint8_t)(total > 0xFF ? 0xFF : total), rq.start, 0 };
+  uint8_t* w = out.out + sizeof(hdr);
+  for(size_t i = rq.start; i < total && hdr.n < fit; ++i){
+    const Peer* p = peers_.at(i);
+    LinkStat ls{};
+    std::memcpy(ls.mac, p->mac, 6);
+    ls.rssi    = (p->rssi == INT32_MIN) ? 0 : (int8_t)p->rssi;
+    ls.rssiAvg = (p->flags & PEER_RSSI) ? (int8_t)(p->rssiAvgQ4 / 16) : 0;
+    ls.lossPermille = (uint16_t)(p->lossQ4 / 16);
+    ls.rttMs   = p->rttMs;
+    uint32_t age = (now - p->lastSeenMs) / 1000;
+    ls.ageS    = (uint16_t)(age > 0xFFFF ? 0xFFFF : age);
+    std::memcpy(w, &ls, sizeof(ls)); w += sizeof(ls);
+    hdr.n++;
+  }
+  std::memcpy(out.out, &hdr, sizeof(hdr));
+  out.out_len = (uint16_t)(sizeof(hdr) + hdr.n * sizeof(LinkStat));
+  return true;
+}
+
+// Runs each item through the adapter and packs the answers into `out` in order.
+// Handlers get a full-size scratch (they assume a whole frame), then the answer
+// is copied in if it still fits. No large replies from inside a bundle.
+bool EspNowCore::handleBundle(const EspNowMsg& in, EspNowResp& out){
+  if(!in.payload_len || out.out_cap < 1) return false;
+  const uint8_t* p = in.payload + 1;
+  uint16_t left = (uint16_t)(in.payload_len - 1);
+  uint8_t  n = in.payload[0];
+  uint8_t  sub[ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader)];
+  out.out[0] = 0; out.out_len = 1;
+  for(uint8_t i = 0; i < n && out.room() >= 3; ++i){
+    uint8_t* item = out.out + out.out_len;
+    if(left < 2 || left < 2u + p[1]){
+      item[0] = left ? p[0] : 0; item[1] = BUNDLE_BAD; item[2] = 0;
+      out.out_len += 3; out.out[0]++;
+      break;
     }
+    EspNowMsg req{ p[0], (uint8_t)(in.flags & ~FLAG_SEG), in.corr, p + 2, p[1], 0, 0 };
+    p += 2u + p[1]; left -= (uint16_t)(2u + req.payload_len);
+
+    EspNowResp r{ sub, 0, (uint16_t)sizeof(sub) };
+    uint8_t st = BUNDLE_OK;
+    if(!bundleAllows(req.type)) st = BUNDLE_BAD;
+    else if(req.type == SET_GROUP && (req.payload_len < 1 || !inGroup(req.payload[0]))) st = BUNDLE_REJECTED;
+    else if(!handleLocal(req, r)) st = BUNDLE_REJECTED;
+    else if(r.out_len > 0xFF || r.out_len + 3u > out.room()) st = BUNDLE_NO_ROOM;
+    uint8_t len = (st == BUNDLE_OK) ? (uint8_t)r.out_len : 0;
+    item[0] = req.type; item[1] = st; item[2] = len;
+    if(len) std::memcpy(item + 3, sub, len);
+    out.out_len = (uint16_t)(out.out_len + 3u + len);
+    out.out[0]++;
   }
+  return true;
 }
 
 bool EspNowCore::pushTopology(const uint8_t mac[6], const void* tlv, uint16_t len){
-  return sendFrame(mac, PUSH_TOPOLOGY, 0x00, 0, tlv, len);
+  if(len + sizeof(EspNowHeader) > ESP_NOW_MAX_DATA_LEN) return sendLarge(mac, PUSH_TOPOLOGY, 0x00, 0, tlv, len);
+  return sendFrame(mac, PUSH_TOPOLOGY, 0x00, 0, tlv, len, TX_TELEMETRY);
 }
 
-void EspNowCore::setLocalTopology(const Topology& t){ topo_ = t; espnow::setLocalTopology(t); }
+void EspNowCore::refreshGroups(){
+  for(auto& w : groupBits_) w = 0;
+  for(uint8_t g : topo_.groups) groupBits_[g >> 5] |= 1u << (g & 31);
+}
+
+void EspNowCore::setLocalTopology(const Topology& t){ topo_ = t; espnow::setLocalTopology(t); refreshGroups(); rebuildTopologyBlob(); }
 const Topology& EspNowCore::getLocalTopology() const { return topo_; }
-bool EspNowCore::exportLocalTopology(std::vector<uint8_t>& tlvOut) const { return espnow::exportLocalTopology(tlvOut); }
-bool EspNowCore::importLocalTopology(const uint8_t* tlv, uint16_t len){ bool ok = espnow::importLocalTopology(tlv,len); if(ok) topo_ = espnow::getLocalTopology(); return ok; }
+bool EspNowCore::importLocalTopology(const uint8_t* tlv, uint16_t len){
+  bool ok = espnow::importLocalTopology(tlv,len);
+  if(ok){ topo_ = espnow::getLocalTopology(); refreshGroups(); rebuildTopologyBlob(); }
+  return ok;
+}
+
+// topo_ is authoritative (several cores share one process in the host simulation).
+bool EspNowCore::exportLocalTopology(std::vector<uint8_t>& tlvOut) const {
+  portENTER_CRITICAL(&topoMux_);
+  bool cached = !topoBlob_.empty();
+  if(cached) tlvOut.assign(topoBlob_.begin(), topoBlob_.end());   // capacity kept by the caller
+  portEXIT_CRITICAL(&topoMux_);
+  return cached || topoEncode(topo_, tlvOut);
+}
+
+TopoStamp EspNowCore::topologyStamp() const {
+  portENTER_CRITICAL(&topoMux_);
+  TopoStamp s = topoStamp_;
+  portEXIT_CRITICAL(&topoMux_);
+  return s;
+}
+
+// Encode outside the lock, swap in under it. The version moves only when the
+// content does, so re-pushing the same topology keeps the ICM's copy current.
+// The two buffers trade places, so a steady lane re-encodes without allocating.
+void EspNowCore::rebuildTopologyBlob(){
+  std::vector<uint8_t>& blob = topoSpare_;
+  topoEncode(topo_, blob);
+  uint32_t h = topoHash(blob.data(), blob.size());
+  portENTER_CRITICAL(&topoMux_);
+  bool same = topoStamp_.version && topoStamp_.hash == h;
+  TopoStamp s{ topoStamp_.version + 1, h };
+  portEXIT_CRITICAL(&topoMux_);
+  if(same) return;
+  topoAppendStamp(blob, s);
+  portENTER_CRITICAL(&topoMux_);
+  topoBlob_.swap(blob);
+  topoStamp_ = s;
+  portEXIT_CRITICAL(&topoMux_);
+}
+
+// Applied to a copy and swapped in only when the base matched and, if the ICM
+// sent one, the result hashes as expected.
+TopoDeltaStatus EspNowCore::importTopologyDelta(const uint8_t* delta, uint16_t len){
+  topoNext_ = topo_;
+  uint32_t want = 0;
+  TopoDeltaStatus st = topoApplyDelta(topoNext_, topologyStamp(), delta, len, want);
+  if(st != TOPO_DELTA_OK) return st;
+  if(want){
+    topoEncode(topoNext_, topoSpare_);
+    if(topoHash(topoSpare_.data(), topoSpare_.size()) != want) return TOPO_DELTA_RESYNC;
+  }
+  std::swap(topo_, topoNext_);
+  espnow::setLocalTopology(topo_);
+  refreshGroups();
+  rebuildTopologyBlob();
+  return TOPO_DELTA_OK;
+}
+
+bool EspNowCore::handleTopoDelta(const EspNowMsg& in, EspNowResp& out){
+  if(out.out_cap < sizeof(TopoDeltaResp)) return false;
+  TopoDeltaResp r{};
+  r.status = importTopologyDelta(in.payload, in.payload_len);
+  TopoStamp s = topologyStamp();
+  r.version = s.version; r.hash = s.hash;
+  std::memcpy(out.out, &r, sizeof(r));
+  out.out_len = sizeof(r);
+  return true;
+}
+
+bool EspNowCore::pushTopologyDelta(const uint8_t mac[6], const void* delta, uint16_t len, ReqDone cb, void* ctx){
+  return request(mac, PUSH_TOPO_DELTA, delta, len, cb, ctx) != 0;
+}
+
+bool EspNowCore::replyTopology(const EspNowMsg& in, EspNowResp& out){
+  static constexpr uint16_t STAMP_BYTES = 10;
+  TopoQuery q{ 0, 0, TOPO_TLV_V1 };
+  bool query = in.payload_len >= offsetof(TopoQuery, tlv);
+  if(in.payload_len) std::memcpy(&q, in.payload, in.payload_len < sizeof(q) ? in.payload_len : sizeof(q));
+  // A segmented buffer can't be claimed under the spinlock: size it first.
+  portENTER_CRITICAL(&topoMux_);
+  bool current = query && topoStamp_.version && q.version == topoStamp_.version && q.hash == topoStamp_.hash;
+  size_t need = current ? STAMP_BYTES : topoBlob_.size();
+  portEXIT_CRITICAL(&topoMux_);
+  bool v2 = !current && q.tlv >= TOPO_TLV_V2;
+  if(v2) need = topoEncodedSize(topo_, TOPO_TLV_V2) + STAMP_BYTES;
+  uint8_t* big = nullptr;
+  uint16_t bigCap = 0;
+  if(need > out.out_cap && !(big = largeReplyBuffer(bigCap))) return false;
+  if(v2) return big ? replyTopologyV2(big, bigCap, true, out) : replyTopologyV2(out.out, out.out_cap, false, out);
+
+  portENTER_CRITICAL(&topoMux_);
+  current = query && topoStamp_.version && q.version == topoStamp_.version && q.hash == topoStamp_.hash;
+  size_t n = topoBlob_.size();
+  const uint8_t* src = topoBlob_.data();
+  if(current){ src += n - STAMP_BYTES; n = STAMP_BYTES; }
+  uint8_t* dst = n < STAMP_BYTES ? nullptr : n <= out.out_cap ? out.out : n <= bigCap ? big : nullptr;
+  if(dst) std::memcpy(dst, src, n);
+  portEXIT_CRITICAL(&topoMux_);
+  if(!dst) return false;
+  if(dst == big) return commitLargeReply((uint16_t)n);
+  out.out_len = (uint16_t)n;
+  return true;
+}
+
+// Encoded on demand (the cache holds V1). The stamp record reads the same in
+// both framings, so it is copied from the cached blob's tail.
+bool EspNowCore::replyTopologyV2(uint8_t* dst, uint16_t cap, bool large, EspNowResp& out){
+  static constexpr uint16_t STAMP_BYTES = 10;
+  if(cap < STAMP_BYTES) return false;
+  size_t n = topoEncode(topo_, dst, cap - STAMP_BYTES, TOPO_TLV_V2);
+  if(!n) return false;
+  portENTER_CRITICAL(&topoMux_);
+  bool stamped = topoBlob_.size() >= STAMP_BYTES;
+  if(stamped) std::memcpy(dst + n, topoBlob_.data() + topoBlob_.size() - STAMP_BYTES, STAMP_BYTES);
+  portEXIT_CRITICAL(&topoMux_);
+  if(stamped) n += STAMP_BYTES;
+  if(large) return commitLargeReply((uint16_t)n);
+  out.out_len = (uint16_t)n;
+  return true;
+}
 
 bool EspNowCore::refreshDeviceInfoFromNvs(){
   std::memset(&dev_, 0, sizeof(dev_));
   dev_.role = getLocalRoleCode();
-  uint8_t mac6[6]; esp_read_mac(mac6, ESP_MAC_WIFI_STA);
+  uint8_t mac6[6];
+  if(radio_) radio_->localMac(mac6); else esp_read_mac(mac6, ESP_MAC_WIFI_STA);
   snprintf(dev_.deviceId, sizeof(dev_.deviceId), "%02X%02X%02X%02X%02X%02X",
            mac6[0], mac6[1], mac6[2], mac6[3], mac6[4], mac6[5]);
   return true;
@@ -3,10 +3,23 @@
 #include <vector>
 
 #include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "../Config/EspNowConfig.h"
 #include "Frame.h"
 #include "Peers.h"
 #include "TopologyTlv.h"
 #include "DeviceInfo.h"
+#include "SpscRing.h"
+#include "TxScheduler.h"
+#include "Request.h"
+#include "Segment.h"
+#include "Group.h"
+#include "IRadio.h"
+#include "Profile.h"
+#include "TimeSync.h"
+#include "OtaRx.h"
+#include "Admission.h"
 
 namespace espnow {
 
@@ -15,15 +28,88 @@ struct ServiceRefs;
 
 class EspNowCore {
 public:
+  ~EspNowCore();   // frees transfer buffers; the firmware core is never destroyed
+
+  // Firmware: begin() brings up the ESP-NOW driver unless setRadio() came first,
+  // and starts the service task. ESPNOW_HOST_SIM: no task; call service().
+  void setRadio(IRadio* r){ radio_ = r; }
   bool begin();
 
+  // One pass of the service task: completions, TX pump, RX drain, timers.
+  // Returns ms until the next timer (UINT32_MAX = none).
+  uint32_t service();
+  bool     wakePending() const { return wakeBits_ != 0 || rxBacklog() != 0; }
+  // Any task (e.g. an esp_timer callback): run service(), and so the role's
+  // tick(), as soon as possible. Work that touches role state belongs there.
+  void     notifyRole(){ wake(NOTIFY_ROLE); }
+
+  // Radio -> core (Wi-Fi task on the device). Copy-and-notify only.
+  void radioRx(const uint8_t* mac, const uint8_t* data, int len, int32_t rssi);
+  void radioTxDone(const uint8_t* mac, bool acked);
+
   void setServices(const ServiceRefs* s);
   void setRoleAdapter(IRoleAdapter* r);
 
   bool unicast(const uint8_t mac[6], uint8_t type, const void* payload, uint16_t len, uint16_t corr=0);
   bool broadcast(uint8_t type, const void* payload, uint16_t len, uint16_t corr=0);
 
+  // Zero-copy TX: write the body in place after the header, then commit (or abort).
+  struct TxView {
+    TxFrame* frame;
+    uint8_t* body;
+    uint16_t cap;
+  };
+  bool beginFrame(const uint8_t mac[6], uint8_t type, uint8_t flags, uint16_t corr, TxView& v);
+  bool commitFrame(TxView& v, uint16_t bodyLen, TxPrio prio);
+  void abortFrame(TxView& v);
+
+  // Segmented transfer (EspNowSeg.cpp): windowed, selectively ACKed, unicast only,
+  // up to ESPNOW_SEG_MAX_BYTES. unicast()/pushTopology() switch to it on their own.
+  bool sendLarge(const uint8_t mac[6], uint8_t type, uint8_t flags, uint16_t corr, const void* data, uint16_t len);
+
+  // Only from IRoleAdapter::handleRequest(): answer the current request with a
+  // segmented response instead of `out`. Either replyLarge(), or fill
+  // largeReplyBuffer() and commitLargeReply(); the core then sends nothing else.
+  uint8_t* largeReplyBuffer(uint16_t& cap);
+  bool     commitLargeReply(uint16_t len);
+  bool     replyLarge(const void* data, uint16_t len);
+
+  // Only from IRoleAdapter::handleRequest(): who sent the request (else nullptr).
+  const uint8_t* requesterMac() const { return curMac_; }
+  // Only from a handler or a ReqDone callback: esp_timer time at which the
+  // current frame reached radioRx().
+  int64_t        rxTimeUs() const { return curRxUs_; }
+
+  // Network clock: the ICM's esp_timer in microseconds, tracked through
+  // TIME_SYNC (TimeSync.h). The ICM, and a node not synced yet, read their own.
+  int64_t networkTimeUs() const;
+  bool    timeSynced() const { return tsync_.synced(); }
+  const TimeSync& timeSync() const { return tsync_; }
+  // ICM side: one exchange with mac, or the next peer whose period elapsed
+  // (returns ms until another is due, UINT32_MAX with no peers).
+  bool     syncTime(const uint8_t mac[6]);
+  uint32_t serviceTimeSync(uint32_t nowMs);
+
+  // Firmware update, node side (OtaRx.h); FW_* requests are handled here for
+  // every role and a committed image restarts the node from service().
+  const OtaRx& otaRx() const { return ota_; }
+
+  struct SegStats {
+    uint32_t txDone;      // transfers fully acknowledged
+    uint32_t txFail;      // gave up after ESPNOW_SEG_MAX_TRIES or rejected
+    uint32_t txBusy;      // no free TX session / buffer
+    uint32_t retrans;     // fragments sent again
+    uint32_t rxDone;      // messages reassembled and dispatched
+    uint32_t rxReject;    // no free RX session / buffer, or malformed
+    uint32_t rxDup;       // fragments already held
+    uint32_t rxTimeout;   // sessions dropped after ESPNOW_SEG_RX_IDLE_MS
+  };
+  SegStats segStats() const { return segSt_; }
+
   bool addPeer(const uint8_t mac[6], bool encrypt=false, const uint8_t* lmk=nullptr);
+  // PAIR_EXCHANGE: like addPeer(), but pending (unpinned) until a frame to mac
+  // is ACKed, so a storm of made-up MACs can't fill the table.
+  bool pairPeer(const uint8_t mac[6]);
   bool removePeer(const uint8_t mac[6]);
   const Peers& peers() const { return peers_; }
 
@@ -33,27 +119,296 @@ public:
   bool exportLocalTopology(std::vector<uint8_t>& tlvOut) const;
   bool importLocalTopology(const uint8_t* tlv, uint16_t len);
 
+  // The encoded topology is cached with its stamp and rebuilt only when it
+  // changes. replyTopology() is the GET_TOPOLOGY handler for role adapters: the
+  // cached blob, or just the stamp when the request's TopoQuery matches it.
+  TopoStamp topologyStamp() const;
+  bool      replyTopology(const EspNowMsg& in, EspNowResp& out);
+
+  // Topology deltas. The node side runs in the core for every role (answered
+  // with TopoDeltaResp); a RESYNC status means the ICM must push the full TLV.
+  // pushTopologyDelta() sends one built by topoDiff(); it must fit one frame.
+  TopoDeltaStatus importTopologyDelta(const uint8_t* delta, uint16_t len);
+  bool pushTopologyDelta(const uint8_t mac[6], const void* delta, uint16_t len, ReqDone cb, void* ctx=nullptr);
+
   const DeviceInfo& getLocalDeviceInfo() const { return dev_; }
   bool refreshDeviceInfoFromNvs();
 
   using RxTap = void(*)(const uint8_t mac[6], const EspNowMsg&);
   void setRxTap(RxTap t){ tap_ = t; }
 
+  struct RxStats {
+    uint32_t received;    // frames accepted into the ring
+    uint32_t dispatched;  // frames drained by the service task
+    uint32_t dropsFull;   // ring full at receive time
+    uint32_t dropsLen;    // runt or oversize frames
+    uint32_t respDrops;   // responses lost to TX pool exhaustion
+    uint32_t seqDups;     // duplicate requests (seq already seen)
+    uint32_t dupReruns;   // of those, pure reads run again (answer not cached)
+    uint32_t seqResyncs;  // windows restarted (peer reboot / long gap)
+    uint16_t depth;       // frames currently queued
+    uint16_t highWater;   // max depth seen since boot
+    uint16_t capacity;
+  };
+  RxStats rxStats() const;
+  // Frames shed by receive admission (Admission.h), before any other RX work.
+  Admission::Stats admitStats() const { return admit_.stats(); }
+
+  // Called from the service task once the driver reports the frame's fate.
+  using TxDoneTap = void(*)(const uint8_t mac[6], uint8_t type, uint16_t corr, bool acked);
+  void setTxDoneTap(TxDoneTap t){ txTap_ = t; }
+  TxScheduler::Stats txStats() const { return tx_.stats(); }
+  uint16_t txFreeFrames() const { return tx_.freeFrames(); }
+
+  // Request/response client. Returns the correlation id (never 0) or 0 when the
+  // pending table is full / arguments are invalid. Unicast only.
+  uint16_t request(const uint8_t mac[6], uint8_t type, const void* payload, uint16_t len,
+                   ReqDone cb, void* ctx=nullptr, uint8_t retries=ESPNOW_REQ_RETRIES);
+  uint16_t request(const uint8_t mac[6], uint8_t type, const void* payload, uint16_t len,
+                   ReqFuture& fut, uint8_t retries=ESPNOW_REQ_RETRIES);
+  bool cancelRequest(uint16_t corr);
+
+  // Group actuation: one broadcast, applied atomically by every member. With a
+  // callback, members answer and cb reports the tally once `expected` answered or
+  // ESPNOW_GROUP_ACK_MS elapsed. Returns false if not sent (or no tally slot).
+  bool groupSet(uint8_t group, uint32_t chMask, uint32_t onMask,
+                GroupDone cb=nullptr, void* ctx=nullptr, uint8_t expected=0);
+  bool inGroup(uint8_t group) const { return (groupBits_[group >> 5] >> (group & 31)) & 1u; }
+
+  void setRequestTimeout(uint8_t type, uint16_t ms){ reqTimeout_[type] = ms; }
+  uint16_t reqTimeoutMs(uint8_t type) const;
+  size_t pendingRequests() const;
+
   static EspNowCore* instance();
+  static void setInstance(EspNowCore* c);     // host simulation: node being serviced
+
+#if ESPNOW_PROFILE
+  // Per-opcode receive-path cost. inject() queues a recorded frame as if `mac`
+  // had sent it (seq cleared, so repeats run the handler again); false when its
+  // queue is full. Replies go out as usual. The queue is single-producer: call
+  // inject() from one task only (the VirtualBus driver, or one bench task).
+  bool inject(const uint8_t mac[6], const uint8_t* frame, uint16_t len);
+  DispatchProfiler&       profiler()       { return prof_; }
+  const DispatchProfiler& profiler() const { return prof_; }
+#endif
 
 private:
-  static void onSendStatic(const uint8_t* mac_addr, esp_now_send_status_t status);
-  static void onRecvStatic(const uint8_t* mac, const uint8_t* data, int len);
+  static constexpr uint32_t NOTIFY_RX  = 1u << 0;
+  static constexpr uint32_t NOTIFY_TX  = 1u << 1;
+  static constexpr uint32_t NOTIFY_REQ = 1u << 2;
+  static constexpr uint32_t NOTIFY_ROLE= 1u << 3;
+
+  void wake(uint32_t bits);
+
+#ifndef ESPNOW_HOST_SIM
+  static void svcTaskStatic(void* arg);
+  void svcLoop();
+#endif
+  void drainRx(size_t maxBatch);
+  void drainTxDone();
+  void pumpTx();
+  void onTxDone(TxFrame* f, bool acked);
+
+  // Request client (EspNowClient.cpp)
+  struct Pending {
+    uint8_t  state;        // PS_* in EspNowClient.cpp
+    uint8_t  type;
+    uint8_t  attempts;
+    uint8_t  retries;
+    uint16_t corr;
+    uint16_t len;
+    uint8_t  mac[6];
+    uint32_t dueMs;        // next send (PS_WAIT) or response deadline (PS_SENT)
+    uint32_t sentMs;
+    uint16_t seq;          // assigned on the first attempt, reused by retries
+    ReqDone  cb;
+    void*    ctx;
+    uint8_t  payload[ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader)];
+  };
+  uint16_t allocCorrLocked();                 // under reqMux_
+  Pending* findPending(const uint8_t mac[6], uint16_t corr);
+  void     retryOrFail(Pending& p, ReqStatus why, uint32_t nowMs);
+  void     finishPending(Pending& p, ReqStatus st, const uint8_t* payload, uint16_t len, uint32_t nowMs);
+  void     onRequestTxDone(const uint8_t mac[6], uint16_t corr, bool acked);
+  bool     onResponse(const uint8_t mac[6], const EspNowMsg& in);
+  void     finishTally(size_t i, bool complete);
+  uint32_t serviceRequests(uint32_t nowMs);   // returns ms until next due event, or UINT32_MAX
+  void     extendPending(const uint8_t mac[6], uint16_t corr, uint32_t nowMs);
+
+  // Segmented transfer (EspNowSeg.cpp)
+  struct SegTx {
+    uint8_t  state;        // SS_* in EspNowSeg.cpp
+    uint8_t  xid;          // 0 until the first pump
+    uint8_t  mac[6];
+    uint8_t  type;
+    uint8_t  flags;
+    uint16_t corr;
+    uint16_t total;
+    uint16_t count;
+    uint16_t base;         // first fragment not yet acknowledged
+    uint8_t  tries;        // RTOs without progress
+    uint32_t sent;         // bit i: fragment base+i queued since the last loss
+    uint32_t acked;        // bit i: fragment base+i selectively acknowledged
+    uint32_t fast;         // bit i: hole at base+i already resent on a SACK
+    uint32_t lastMs;
+    uint8_t* buf;          // ESPNOW_SEG_MAX_BYTES, allocated on first use
+  };
+  struct SegRx {
+    uint8_t  state;
+    uint8_t  xid;
+    uint8_t  mac[6];
+    uint8_t  type;
+    uint8_t  flags;
+    uint16_t corr;
+    uint16_t total;
+    uint16_t count;
+    uint16_t base;         // first fragment not yet received
+    uint8_t  unacked;      // fragments since our last SegAck
+    uint64_t have;         // bit i: fragment base+i received
+    uint32_t lastMs;
+    uint8_t* buf;
+  };
+  SegTx*   claimSegTx(const uint8_t mac[6], uint8_t type, uint8_t flags, uint16_t corr);
+  void     startSegTx(SegTx& s, uint16_t len);
+  void     pumpSegTx(SegTx& s, uint32_t nowMs);
+  uint8_t  segXidFor(const SegTx& s);
+  bool     sendFragment(SegTx& s, uint16_t idx);
+  void     sendSegAck(const uint8_t mac[6], uint8_t xid, uint8_t status, uint16_t base, uint32_t mask);
+  bool     endLargeReply();                   // drop the dispatch context; true if a large reply went out
+  void     onSegAck(const uint8_t mac[6], const EspNowMsg& in);
+  void     onSegData(const uint8_t mac[6], const EspNowMsg& in);
+  uint32_t serviceSeg(uint32_t nowMs);        // same contract as serviceRequests()
+  void     servicePeers(uint32_t nowMs);      // stale sweep, every ESPNOW_PEER_SWEEP_MS
 
   void onRecv(const uint8_t* mac, const uint8_t* data, int len, int32_t rssi);
-  bool sendFrame(const uint8_t* mac, uint8_t type, uint8_t flags, uint16_t corr, const void* payload, uint16_t len);
+  void dispatch(const uint8_t* mac, const EspNowMsg& in);
+  bool handleLocal(const EspNowMsg& in, EspNowResp& out);     // core opcodes, else the adapter
+  bool handleBundle(const EspNowMsg& in, EspNowResp& out);
+  bool handleLinkStats(const EspNowMsg& in, EspNowResp& out);
+  bool handleTopoDelta(const EspNowMsg& in, EspNowResp& out);
+  bool handleTimeSync(const EspNowMsg& in, EspNowResp& out);
+  bool fromPinned() const;                    // current request's sender
+  static void timeSyncDone(const uint8_t mac[6], const ReqResult& r, void* ctx);
+  bool replyTopologyV2(uint8_t* dst, uint16_t cap, bool large, EspNowResp& out);
+  bool sendFrame(const uint8_t* mac, uint8_t type, uint8_t flags, uint16_t corr, const void* payload, uint16_t len, TxPrio prio, uint16_t seq=0);
+  void answerDuplicate(const uint8_t* mac, const EspNowMsg& in);
+  void rememberResponse(const uint8_t* mac, const EspNowMsg& in, const uint8_t* frame, uint16_t len);
+  void forgetResponses(const uint8_t* mac);
 
   Peers peers_;
+  uint32_t peerSweepMs_{0};
   IRoleAdapter* role_{nullptr};
   const ServiceRefs* services_{nullptr};
   DeviceInfo dev_{};
   Topology topo_{};
   RxTap tap_{nullptr};
+
+  struct RxSlot {
+    uint8_t  mac[6];
+    int32_t  rssi;
+    int64_t  rxUs;        // esp_timer at radioRx()
+    uint16_t len;
+    uint8_t  data[ESP_NOW_MAX_DATA_LEN];
+  };
+  SpscRing<RxSlot, ESPNOW_RX_RING_DEPTH> rx_;
+#if ESPNOW_PROFILE
+  SpscRing<RxSlot, ESPNOW_PROFILE_INJECT_DEPTH> inj_;   // inject() only
+  size_t rxBacklog() const { return rx_.depth() + inj_.depth(); }
+#else
+  size_t rxBacklog() const { return rx_.depth(); }
+#endif
+  IRadio*      radio_{nullptr};
+  TaskHandle_t svcTask_{nullptr};
+  bool         started_{false};
+  volatile uint32_t wakeBits_{0};   // notifications while no task is running
+  uint32_t rxReceived_{0};
+  uint32_t rxDispatched_{0};
+  uint32_t rxDropsFull_{0};
+  uint32_t rxDropsLen_{0};
+  uint32_t respDrops_{0};   // handled, but no TX frame was free for the answer
+  uint8_t  respScratch_[ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader)];
+  uint32_t seqDups_{0};
+  uint32_t dupReruns_{0};
+  uint32_t seqResyncs_{0};
+  uint16_t boot_{0};        // EspNowHeader::boot, drawn once per boot
+
+  // Last answers to sequenced requests, replayed when the request comes again.
+  struct DupResp {
+    uint8_t  mac[6];
+    uint16_t seq;         // 0 = empty slot
+    uint16_t boot;        // requester's boot nonce
+    uint16_t len;         // whole frame, header included
+    uint8_t  frame[ESP_NOW_MAX_DATA_LEN];
+  };
+  DupResp  dupCache_[ESPNOW_DUP_RESP_CACHE]{};
+  uint8_t  dupNext_{0};
+
+  struct TxDoneSlot {
+    uint8_t  mac[6];
+    bool     acked;
+    uint32_t ord;        // completions so far, in driver (send) order
+  };
+  TxScheduler tx_;
+  SpscRing<TxDoneSlot, ESPNOW_TX_DONE_RING_DEPTH> txDone_;
+  TxDoneTap txTap_{nullptr};
+  uint32_t txSendOrd_{0};   // service task: sends the driver accepted
+  uint32_t txDoneOrd_{0};   // Wi-Fi task: completions it reported
+
+  Pending  pending_[ESPNOW_REQ_PENDING_MAX]{};
+  uint16_t nextCorr_{1};
+  uint16_t reqTimeout_[256]{};
+
+  struct Tally {
+    uint16_t  corr;         // 0 = free
+    uint8_t   group;
+    uint8_t   expected;
+    uint8_t   acks;
+    uint8_t   nacks;
+    uint32_t  dueMs;
+    GroupDone cb;
+    void*     ctx;
+  };
+  Tally    tally_[ESPNOW_GROUP_TALLY_MAX]{};
+  uint32_t groupBits_[8]{};                   // groups from the local topology
+  void     refreshGroups();
+  void     rebuildTopologyBlob();
+  std::vector<uint8_t> topoBlob_;             // topoEncode() + T_VERSION stamp
+  std::vector<uint8_t> topoSpare_;            // previous blob, reused by the next rebuild
+  Topology topoNext_{};                       // delta scratch, swapped in once verified
+  TopoStamp topoStamp_{};
+  mutable portMUX_TYPE topoMux_ = portMUX_INITIALIZER_UNLOCKED;
+  mutable portMUX_TYPE reqMux_ = portMUX_INITIALIZER_UNLOCKED;
+
+  SegTx    segTx_[ESPNOW_SEG_TX_SESSIONS]{};
+  SegRx    segRx_[ESPNOW_SEG_RX_SESSIONS]{};
+  struct SegSeen {
+    uint8_t  mac[6];
+    uint8_t  xid;
+    uint8_t  type;
+    uint16_t corr;
+    uint16_t total;
+    uint32_t doneMs;       // 0 = empty; ages out after ESPNOW_SEG_RX_IDLE_MS
+  };
+  SegSeen  segSeen_[4]{};                     // recently completed, so late duplicates get re-ACKed
+  uint8_t  segSeenNext_{0};
+  uint8_t  nextXid_{1};
+  SegStats segSt_{};
+  mutable portMUX_TYPE segMux_ = portMUX_INITIALIZER_UNLOCKED;
+
+  // Request being dispatched to the role adapter (service task only).
+  const uint8_t*   curMac_{nullptr};
+  const EspNowMsg* curReq_{nullptr};
+  SegTx*           curLarge_{nullptr};
+  bool             curLargeSent_{false};
+  int64_t          curRxUs_{0};
+
+  TimeSync tsync_;
+  OtaRx    ota_;
+  Admission admit_;
+
+#if ESPNOW_PROFILE
+  DispatchProfiler prof_;
+#endif
 };
 
 } // namespace espnow
@@ -0,0 +1,87 @@
+#ifndef ESPNOW_HOST_SIM
+#include "EspNowRadio.h"
+#include "EspNowCore.h"
+
+#include <cstring>
+
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_system.h>
+#include <esp_wifi.h>
+
+namespace espnow {
+
+static EspNowCore* g_radioCore = nullptr;
+
+IRadio* defaultRadio(){ static EspNowRadio r; return &r; }
+
+bool EspNowRadio::begin(EspNowCore* core){
+  g_radioCore = core;
+  WiFi.mode(WIFI_STA);
+  if(esp_now_init() != ESP_OK){ return false; }
+  esp_now_register_send_cb(&EspNowRadio::onSendStatic);
+  esp_now_register_recv_cb(&EspNowRadio::onRecvStatic);
+#if !ESPNOW_RECV_INFO && ESPNOW_RSSI_PROMISC
+  wifi_promiscuous_filter_t flt{ WIFI_PROMIS_FILTER_MASK_MGMT };
+  esp_wifi_set_promiscuous_filter(&flt);
+  esp_wifi_set_promiscuous_rx_cb(&EspNowRadio::onPromiscStatic);
+  esp_wifi_set_promiscuous(true);
+#endif
+  return true;
+}
+
+RadioErr EspNowRadio::send(const uint8_t mac[6], const uint8_t* data, uint16_t len){
+  esp_err_t e = esp_now_send(mac, data, len);
+  if(e == ESP_OK) return RADIO_OK;
+  return (e == ESP_ERR_ESPNOW_NO_MEM) ? RADIO_BUSY : RADIO_FAIL;
+}
+
+bool EspNowRadio::addPeer(const uint8_t mac[6], bool encrypt, const uint8_t* lmk){
+  esp_now_peer_info_t p{};
+  std::memcpy(p.peer_addr, mac, 6);
+  p.channel = 0;
+  p.ifidx = WIFI_IF_STA;
+  p.encrypt = encrypt;
+  if(encrypt && lmk) std::memcpy(p.lmk, lmk, 16);
+  return esp_now_add_peer(&p) == ESP_OK;
+}
+
+bool EspNowRadio::delPeer(const uint8_t mac[6]){ return esp_now_del_peer(mac) == ESP_OK; }
+
+void EspNowRadio::localMac(uint8_t mac[6]) const { esp_read_mac(mac, ESP_MAC_WIFI_STA); }
+
+void EspNowRadio::onSendStatic(const uint8_t* mac_addr, esp_now_send_status_t status){
+  if(g_radioCore && mac_addr) g_radioCore->radioTxDone(mac_addr, status == ESP_NOW_SEND_SUCCESS);
+}
+
+#if ESPNOW_RECV_INFO
+void EspNowRadio::onRecvStatic(const esp_now_recv_info_t* info, const uint8_t* data, int len){
+  if(!g_radioCore || !info || !info->src_addr) return;
+  g_radioCore->radioRx(info->src_addr, data, len, info->rx_ctrl ? (int32_t)info->rx_ctrl->rssi : 0);
+}
+#else
+// Both callbacks run in the Wi-Fi task, the promiscuous one first for the same
+// frame, so the last action frame's RSSI belongs to the next receive callback.
+static volatile int32_t g_lastRssi = 0;
+static uint8_t          g_lastRssiMac[6];
+
+void EspNowRadio::onPromiscStatic(void* buf, wifi_promiscuous_pkt_type_t type){
+  if(type != WIFI_PKT_MGMT || !buf) return;
+  const wifi_promiscuous_pkt_t* pkt = static_cast<const wifi_promiscuous_pkt_t*>(buf);
+  const uint8_t* h = pkt->payload;
+  // Action frame (0xD0), vendor-specific category (127), Espressif OUI.
+  if(pkt->rx_ctrl.sig_len < 28 || h[0] != 0xD0 || h[24] != 127 || h[25] != 0x18 || h[26] != 0xFE || h[27] != 0x34) return;
+  std::memcpy(g_lastRssiMac, h + 10, 6);
+  g_lastRssi = pkt->rx_ctrl.rssi;
+}
+
+void EspNowRadio::onRecvStatic(const uint8_t* mac, const uint8_t* data, int len){
+  if(!g_radioCore || !mac) return;
+  int32_t rssi = (g_lastRssi && std::memcmp(g_lastRssiMac, mac, 6) == 0) ? g_lastRssi : 0;
+  g_lastRssi = 0;
+  g_radioCore->radioRx(mac, data, len, rssi);
+}
+#endif
+
+} // namespace espnow
+#endif // ESPNOW_HOST_SIM
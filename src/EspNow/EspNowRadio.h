@@ -0,0 +1,39 @@
+#pragma once
+#ifndef ESPNOW_HOST_SIM
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_idf_version.h>
+#include "IRadio.h"
+
+// IDF 5 hands the receive callback an esp_now_recv_info_t (with RSSI).
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5,0,0)
+  #define ESPNOW_RECV_INFO 1
+#else
+  #define ESPNOW_RECV_INFO 0
+#endif
+
+namespace espnow {
+
+// The real ESP-NOW driver. Callbacks run in the Wi-Fi task.
+class EspNowRadio final : public IRadio {
+public:
+  bool     begin(EspNowCore* core) override;
+  RadioErr send(const uint8_t mac[6], const uint8_t* data, uint16_t len) override;
+  bool     addPeer(const uint8_t mac[6], bool encrypt, const uint8_t* lmk) override;
+  bool     delPeer(const uint8_t mac[6]) override;
+  void     localMac(uint8_t mac[6]) const override;
+
+private:
+  static void onSendStatic(const uint8_t* mac_addr, esp_now_send_status_t status);
+#if ESPNOW_RECV_INFO
+  static void onRecvStatic(const esp_now_recv_info_t* info, const uint8_t* data, int len);
+#else
+  static void onRecvStatic(const uint8_t* mac, const uint8_t* data, int len);
+  static void onPromiscStatic(void* buf, wifi_promiscuous_pkt_type_t type);
+#endif
+};
+
+IRadio* defaultRadio();
+
+} // namespace espnow
+#endif // ESPNOW_HOST_SIM
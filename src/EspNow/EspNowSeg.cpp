@@ -0,0 +1,276 @@
+#include "EspNowCore.h"
+#include "Opcodes.h"
+#include "Segment.h"
+
+#include <cstring>
+#include <climits>
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+namespace espnow {
+
+static_assert(ESPNOW_SEG_WINDOW >= 2 && ESPNOW_SEG_WINDOW <= 32, "SACK bitmap is 32 bits");
+static_assert(ESPNOW_SEG_MAX_BYTES <= 0xFFFF, "SegHeader::total is 16 bits");
+
+enum : uint8_t { SS_FREE=0, SS_CLAIMED=1, SS_ACTIVE=2 };
+
+static uint8_t* segAlloc(){
+  void* p = nullptr;
+#if ESPNOW_PEERS_IN_PSRAM
+  p = heap_caps_malloc(ESPNOW_SEG_MAX_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+  if(!p) p = heap_caps_malloc(ESPNOW_SEG_MAX_BYTES, MALLOC_CAP_8BIT);
+  return static_cast<uint8_t*>(p);
+}
+
+EspNowCore::~EspNowCore(){
+  for(auto& s : segTx_) heap_caps_free(s.buf);
+  for(auto& r : segRx_) heap_caps_free(r.buf);
+}
+
+static inline uint16_t fragCount(uint16_t total){ return (uint16_t)((total + SEG_FRAG_BYTES - 1) / SEG_FRAG_BYTES); }
+static inline uint32_t shr32(uint32_t v, uint16_t n){ return n >= 32 ? 0 : (v >> n); }
+
+// ---- sender ----------------------------------------------------------------
+
+EspNowCore::SegTx* EspNowCore::claimSegTx(const uint8_t mac[6], uint8_t type, uint8_t flags, uint16_t corr){
+  SegTx* s = nullptr;
+  portENTER_CRITICAL(&segMux_);
+  for(auto& e : segTx_) if(e.state == SS_FREE){ e.state = SS_CLAIMED; s = &e; break; }
+  portEXIT_CRITICAL(&segMux_);
+  if(s && !s->buf) s->buf = segAlloc();   // kept for reuse once allocated
+  if(!s || !s->buf){
+    if(s){ portENTER_CRITICAL(&segMux_); s->state = SS_FREE; portEXIT_CRITICAL(&segMux_); }
+    segSt_.txBusy++;
+    return nullptr;
+  }
+  std::memcpy(s->mac, mac, 6);
+  s->type = type; s->flags = (uint8_t)(flags | FLAG_SEG); s->corr = corr;
+  return s;
+}
+
+void EspNowCore::startSegTx(SegTx& s, uint16_t len){
+  s.total = len; s.count = fragCount(len); s.base = 0;
+  s.sent = s.acked = s.fast = 0; s.tries = 0; s.lastMs = millis();
+  s.xid = 0;                                  // assigned by the service task (pumpSegTx)
+  portENTER_CRITICAL(&segMux_);
+  s.state = SS_ACTIVE;
+  portEXIT_CRITICAL(&segMux_);
+  wake(NOTIFY_TX);
+}
+
+// xids count per destination (Peer::segXid), so one wraps only after 255
+// transfers to that peer, long after the receiver's done list forgot it. Peers
+// are owned by the service task, hence the deferred assignment.
+uint8_t EspNowCore::segXidFor(const SegTx& s){
+  for(;;){
+    uint8_t x = peers_.nextSegXid(s.mac);
+    if(!x){ x = nextXid_++; if(!x) continue; }     // peer table full: shared counter
+    bool clash = false;
+    for(auto& e : segTx_) if(&e != &s && e.state == SS_ACTIVE && e.xid == x && std::memcmp(e.mac, s.mac, 6) == 0) clash = true;
+    if(!clash) return x;
+  }
+}
+
+bool EspNowCore::sendLarge(const uint8_t mac[6], uint8_t type, uint8_t flags, uint16_t corr, const void* data, uint16_t len){
+  if(!started_ || !mac || !data || !len || len > ESPNOW_SEG_MAX_BYTES) return false;
+  if(mac[0] & 0x01) return false;     // needs per-peer ACKs
+  SegTx* s = claimSegTx(mac, type, flags, corr);
+  if(!s) return false;
+  std::memcpy(s->buf, data, len);
+  startSegTx(*s, len);
+  return true;
+}
+
+uint8_t* EspNowCore::largeReplyBuffer(uint16_t& cap){
+  cap = 0;
+  if(!curReq_) return nullptr;
+  if(!curLarge_) curLarge_ = claimSegTx(curMac_, curReq_->type, asResponse(curReq_->flags), curReq_->corr);
+  if(!curLarge_) return nullptr;
+  cap = ESPNOW_SEG_MAX_BYTES;
+  return curLarge_->buf;
+}
+
+bool EspNowCore::commitLargeReply(uint16_t len){
+  if(!curLarge_ || curLargeSent_ || !len || len > ESPNOW_SEG_MAX_BYTES) return false;
+  startSegTx(*curLarge_, len);
+  curLargeSent_ = true;
+  return true;
+}
+
+bool EspNowCore::replyLarge(const void* data, uint16_t len){
+  uint16_t cap = 0;
+  uint8_t* b = largeReplyBuffer(cap);
+  if(!b || !data || len > cap) return false;
+  std::memcpy(b, data, len);
+  return commitLargeReply(len);
+}
+
+bool EspNowCore::endLargeReply(){
+  bool sent = curLargeSent_;
+  if(curLarge_ && !sent){ portENTER_CRITICAL(&segMux_); curLarge_->state = SS_FREE; portEXIT_CRITICAL(&segMux_); }
+  curMac_ = nullptr; curReq_ = nullptr; curLarge_ = nullptr; curLargeSent_ = false;
+  return sent;
+}
+
+bool EspNowCore::sendFragment(SegTx& s, uint16_t idx){
+  TxView v;
+  if(!beginFrame(s.mac, s.type, s.flags, s.corr, v)) return false;
+  uint16_t off = (uint16_t)(idx * SEG_FRAG_BYTES);
+  uint16_t n = (uint16_t)(s.total - off);
+  if(n > SEG_FRAG_BYTES) n = SEG_FRAG_BYTES;
+  SegHeader sh{ s.xid, 0, idx, s.count, s.total };
+  std::memcpy(v.body, &sh, sizeof(sh));
+  std::memcpy(v.body + sizeof(sh), s.buf + off, n);
+  return commitFrame(v, (uint16_t)(sizeof(sh) + n), txPrioFor(s.type, s.flags));
+}
+
+// Fill the window with fragments neither queued nor acknowledged, leaving a few
+// pool frames for actuation/responses.
+void EspNowCore::pumpSegTx(SegTx& s, uint32_t nowMs){
+  if(!s.xid) s.xid = segXidFor(s);
+  uint16_t win = (uint16_t)(s.count - s.base);
+  if(win > ESPNOW_SEG_WINDOW) win = ESPNOW_SEG_WINDOW;
+  for(uint16_t i = 0; i < win; ++i){
+    uint32_t bit = 1u << i;
+    if((s.sent | s.acked) & bit) continue;
+    if(tx_.freeFrames() <= ESPNOW_SEG_TX_RESERVE) break;
+    if(!sendFragment(s, (uint16_t)(s.base + i))) break;
+    s.sent |= bit;
+    s.lastMs = nowMs;
+  }
+}
+
+void EspNowCore::onSegAck(const uint8_t mac[6], const EspNowMsg& in){
+  if(in.payload_len < sizeof(SegAck)) return;
+  SegAck a; std::memcpy(&a, in.payload, sizeof(a));
+  SegTx* s = nullptr;
+  for(auto& e : segTx_) if(e.state == SS_ACTIVE && e.xid == a.xid && std::memcmp(e.mac, mac, 6) == 0){ s = &e; break; }
+  if(!s) return;
+  uint32_t now = millis();
+
+  if(a.status == SEG_ST_REJECT){ segSt_.txFail++; s->state = SS_FREE; return; }
+  uint16_t base = (a.status == SEG_ST_DONE) ? s->count : a.base;
+  if(base > s->count) return;
+  if(base < s->base) return;                  // stale ACK overtaken by a newer one
+
+  uint32_t before = s->acked;
+  uint16_t shift = (uint16_t)(base - s->base);
+  s->sent = shr32(s->sent, shift); s->acked = shr32(s->acked, shift); s->fast = shr32(s->fast, shift);
+  s->base = base;
+  if(s->base == s->count){ segSt_.txDone++; s->state = SS_FREE; return; }
+
+  s->acked |= a.mask << 1;
+  if(shift || s->acked != before){ s->tries = 0; s->lastMs = now; }
+  // Holes below the highest SACKed fragment were lost: resend each once per RTO.
+  if(s->acked){
+    uint32_t below = (1u << (31 - __builtin_clz(s->acked))) - 1;
+    uint32_t holes = below & ~s->acked & s->sent & ~s->fast;
+    if(holes){
+      s->sent &= ~holes; s->fast |= holes;
+      segSt_.retrans += (uint32_t)__builtin_popcount(holes);
+    }
+  }
+  pumpSegTx(*s, now);
+}
+
+// ---- receiver --------------------------------------------------------------
+
+void EspNowCore::sendSegAck(const uint8_t mac[6], uint8_t xid, uint8_t status, uint16_t base, uint32_t mask){
+  SegAck a{ xid, status, base, mask };
+  sendFrame(mac, SEG_ACK, 0x00, 0, &a, sizeof(a), TX_RESPONSE);
+}
+
+void EspNowCore::onSegData(const uint8_t mac[6], const EspNowMsg& in){
+  if(in.payload_len < sizeof(SegHeader)){ segSt_.rxReject++; return; }
+  SegHeader sh; std::memcpy(&sh, in.payload, sizeof(sh));
+  const uint8_t* frag = in.payload + sizeof(sh);
+  uint16_t n = (uint16_t)(in.payload_len - sizeof(sh));
+  if(!sh.total || sh.total > ESPNOW_SEG_MAX_BYTES || sh.count != fragCount(sh.total) || sh.idx >= sh.count){
+    segSt_.rxReject++; return;
+  }
+  uint16_t off = (uint16_t)(sh.idx * SEG_FRAG_BYTES);
+  uint16_t want = (uint16_t)(sh.total - off);
+  if(want > SEG_FRAG_BYTES) want = SEG_FRAG_BYTES;
+  if(n != want){ segSt_.rxReject++; return; }
+
+  uint32_t now = millis();
+  SegRx* r = nullptr;
+  for(auto& e : segRx_) if(e.state == SS_ACTIVE && e.xid == sh.xid && std::memcmp(e.mac, mac, 6) == 0){ r = &e; break; }
+  if(!r){
+    for(auto& d : segSeen_){
+      if(!d.doneMs || (uint32_t)(now - d.doneMs) >= ESPNOW_SEG_RX_IDLE_MS) continue;
+      if(d.xid == sh.xid && d.type == in.type && d.corr == in.corr && d.total == sh.total && std::memcmp(d.mac, mac, 6) == 0){
+        segSt_.rxDup++; sendSegAck(mac, sh.xid, SEG_ST_DONE, sh.count, 0); return;
+      }
+    }
+    for(auto& e : segRx_) if(e.state == SS_FREE){ r = &e; break; }
+    if(r && !r->buf) r->buf = segAlloc();
+    if(!r || !r->buf){ segSt_.rxReject++; sendSegAck(mac, sh.xid, SEG_ST_REJECT, 0, 0); return; }
+    std::memcpy(r->mac, mac, 6);
+    r->xid = sh.xid; r->type = in.type; r->flags = (uint8_t)(in.flags & ~FLAG_SEG); r->corr = in.corr;
+    r->total = sh.total; r->count = sh.count; r->base = 0; r->have = 0; r->unacked = 0;
+    r->state = SS_ACTIVE;
+  }
+  r->lastMs = now;
+  // The far side is answering: don't let the request time out mid-transfer.
+  if(isResponse(r->flags) && r->corr) extendPending(mac, r->corr, now);
+
+  if(sh.idx < r->base || sh.idx - r->base >= 64 || (r->have & (1ull << (sh.idx - r->base)))){
+    segSt_.rxDup++;                           // our ACK was lost; repeat it
+    sendSegAck(mac, r->xid, SEG_ST_OK, r->base, (uint32_t)(r->have >> 1));
+    r->unacked = 0;
+    return;
+  }
+  bool inOrder = (sh.idx == r->base);
+  std::memcpy(r->buf + off, frag, n);
+  r->have |= 1ull << (sh.idx - r->base);
+  while(r->have & 1){ r->have >>= 1; r->base++; }
+
+  if(r->base == r->count){
+    sendSegAck(mac, r->xid, SEG_ST_DONE, r->count, 0);
+    SegSeen& d = segSeen_[segSeenNext_++ % (sizeof(segSeen_)/sizeof(segSeen_[0]))];
+    std::memcpy(d.mac, mac, 6);
+    d.xid = r->xid; d.type = r->type; d.corr = r->corr; d.total = r->total; d.doneMs = now ? now : 1;
+    segSt_.rxDone++;
+    EspNowMsg m{ r->type, r->flags, r->corr, r->buf, r->total, 0, 0 };
+    dispatch(mac, m);
+    r->state = SS_FREE;
+    return;
+  }
+  // ACK every half window, and at once on a gap so the sender can fill it.
+  if(!inOrder || ++r->unacked >= ESPNOW_SEG_WINDOW / 2 || sh.idx + 1 == r->count){
+    sendSegAck(mac, r->xid, SEG_ST_OK, r->base, (uint32_t)(r->have >> 1));
+    r->unacked = 0;
+  }
+}
+
+// Retransmit on RTO, keep windows full, drop idle reassemblies.
+uint32_t EspNowCore::serviceSeg(uint32_t nowMs){
+  uint32_t next = UINT32_MAX;
+  for(auto& s : segTx_){
+    if(s.state != SS_ACTIVE) continue;
+    if((s.sent & ~s.acked) && (uint32_t)(nowMs - s.lastMs) >= ESPNOW_SEG_RTO_MS){
+      if(++s.tries > ESPNOW_SEG_MAX_TRIES){ segSt_.txFail++; s.state = SS_FREE; continue; }
+      segSt_.retrans += (uint32_t)__builtin_popcount(s.sent & ~s.acked);
+      s.sent = s.acked; s.fast = 0; s.lastMs = nowMs;
+    }
+    pumpSegTx(s, nowMs);
+    uint32_t left = ESPNOW_SEG_RTO_MS;       // nothing outstanding: waiting on pool frames
+    if(s.sent & ~s.acked){
+      uint32_t el = nowMs - s.lastMs;
+      left = el >= ESPNOW_SEG_RTO_MS ? 1 : ESPNOW_SEG_RTO_MS - el;
+    }
+    if(left < next) next = left;
+  }
+  for(auto& r : segRx_){
+    if(r.state != SS_ACTIVE) continue;
+    uint32_t idle = nowMs - r.lastMs;
+    if(idle >= ESPNOW_SEG_RX_IDLE_MS){ segSt_.rxTimeout++; r.state = SS_FREE; continue; }
+    if(ESPNOW_SEG_RX_IDLE_MS - idle < next) next = ESPNOW_SEG_RX_IDLE_MS - idle;
+  }
+  return next;
+}
+
+} // namespace espnow
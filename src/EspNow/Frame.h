@@ -6,25 +6,41 @@ namespace espnow {
 #pragma pack(push,1)
 struct EspNowHeader {
   uint8_t  type;    // opcode (see Opcodes.h)
-  uint8_t  flags;   // bit0: 1 = response, 0 = request
+  uint8_t  flags;   // see FLAG_* below
   uint16_t corr;    // correlation id (echoed back)
+  uint16_t seq;     // per sender->receiver request sequence; 0 = not sequenced
+  uint16_t boot;    // sender's boot nonce; a new value restarts the receiver's seq window
 };
 #pragma pack(pop)
 
+enum : uint8_t {
+  FLAG_RESP = 0x01,   // 1 = response, 0 = request
+  FLAG_ERR  = 0x02,   // response: handler rejected the request (no body)
+  FLAG_SEG  = 0x04,   // body starts with SegHeader (Segment.h)
+  FLAG_DUP  = 0x08,   // response: request was a duplicate, already executed
+};
+
 struct EspNowMsg  {
   uint8_t  type;
   uint8_t  flags;
   uint16_t corr;
   const uint8_t* payload;
   uint16_t payload_len;
+  uint16_t seq;
+  uint16_t boot;
 };
 
+// View of the outgoing frame body, positioned right after the header.
+// out_cap is the exact room left in the frame; never write past it.
 struct EspNowResp {
   uint8_t* out;
   uint16_t out_len;
+  uint16_t out_cap;
+
+  uint16_t room() const { return out_cap > out_len ? uint16_t(out_cap - out_len) : 0; }
 };
 
-static inline bool isResponse(uint8_t flags) { return (flags & 0x01) != 0; }
-static inline uint8_t asResponse(uint8_t flags) { return flags | 0x01; }
+static inline bool isResponse(uint8_t flags) { return (flags & FLAG_RESP) != 0; }
+static inline uint8_t asResponse(uint8_t flags) { return flags | FLAG_RESP; }
 
 } // namespace espnow
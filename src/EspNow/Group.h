@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+
+namespace espnow {
+
+// SET_GROUP: broadcast actuation. Every node whose topology lists `group`
+// applies (state & ~chMask) | (onMask & chMask) in one write; others ignore it.
+// corr != 0 asks members to answer (unicast response), which the sender tallies.
+#pragma pack(push,1)
+struct SetGroupPayload {
+  uint8_t  group;
+  uint32_t chMask;
+  uint32_t onMask;
+};
+#pragma pack(pop)
+
+struct GroupResult {
+  uint8_t  group;
+  uint16_t corr;
+  uint8_t  expected;   // as passed to EspNowCore::groupSet (0 = unknown)
+  uint8_t  acks;
+  uint8_t  nacks;      // members that answered with FLAG_ERR
+  bool     complete;   // acks + nacks reached expected (always true when expected == 0)
+};
+
+// Invoked from the ESP-NOW service task.
+using GroupDone = void(*)(const GroupResult& r, void* ctx);
+
+} // namespace espnow
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+namespace espnow {
+
+class EspNowCore;
+
+enum RadioErr : uint8_t {
+  RADIO_OK   = 0,
+  RADIO_BUSY = 1,   // driver queue full; the frame is retried later
+  RADIO_FAIL = 2,
+};
+
+// Link layer under EspNowCore. The firmware uses EspNowRadio (ESP-NOW driver);
+// the host simulation (sim/VirtualBus.h) plugs in its own.
+// Implementations report back via EspNowCore::radioRx() / radioTxDone(), one
+// completion per RADIO_OK send.
+class IRadio {
+public:
+  virtual ~IRadio() = default;
+  virtual bool     begin(EspNowCore* core) = 0;
+  virtual RadioErr send(const uint8_t mac[6], const uint8_t* data, uint16_t len) = 0;
+  virtual bool     addPeer(const uint8_t mac[6], bool encrypt, const uint8_t* lmk) = 0;
+  virtual bool     delPeer(const uint8_t mac[6]) = 0;
+  virtual void     localMac(uint8_t mac[6]) const = 0;
+};
+
+} // namespace espnow
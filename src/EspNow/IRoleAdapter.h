@@ -4,12 +4,19 @@
 
 namespace espnow {
 
+struct OpStats;
+
 class IRoleAdapter {
 public:
   virtual ~IRoleAdapter() = default;
   virtual void mount(const ServiceRefs* s) = 0;
   virtual bool handleRequest(const EspNowMsg& in, EspNowResp& out) = 0;
   virtual void onTopologyPushed(const uint8_t* tlv, uint16_t len) {}
+  // Periodic work on the service task (e.g. pushed reports). Returns ms until
+  // it wants to run again (UINT32_MAX = nothing scheduled).
+  virtual uint32_t tick(uint32_t nowMs) { (void)nowMs; return UINT32_MAX; }
+  // Per-opcode counters of table-driven adapters (adapters/OpTable.h).
+  virtual const OpStats* opStats(uint8_t type) const { (void)type; return nullptr; }
 };
 
 } // namespace espnow
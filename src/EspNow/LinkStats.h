@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+namespace espnow {
+
+// GET_LINKSTATS: paged dump of the peer table's link quality.
+//   request : LinkStatsReq (optional; empty = first page)
+//   response: LinkStatsHdr + n x LinkStat
+#pragma pack(push,1)
+struct LinkStatsReq {
+  uint8_t  start;        // first peer index
+  uint8_t  max;          // 0 = as many as fit
+};
+
+struct LinkStatsHdr {
+  uint8_t  total;        // peers in the table
+  uint8_t  start;
+  uint8_t  n;
+};
+
+struct LinkStat {
+  uint8_t  mac[6];
+  int8_t   rssi;         // last frame, dBm (0 = unknown)
+  int8_t   rssiAvg;      // EWMA, dBm
+  uint16_t lossPermille; // EWMA of send-status NACKs
+  uint16_t rttMs;        // EWMA of request round trips (0 = none yet)
+  uint16_t ageS;         // since last frame, saturating
+};
+#pragma pack(pop)
+
+} // namespace espnow
@@ -10,7 +10,10 @@ enum : uint8_t {
   GET_FAN_MODE    = 0x03,  // uint8_t enum {0..4}
   GET_LOGS        = 0x04,  // req:{uint32_t off,uint16_t max}; resp:{bytes}
   GET_FAULTS      = 0x05,  // role-defined small struct
-  GET_TOPOLOGY    = 0x06,  // TLV blob
+  GET_TOPOLOGY    = 0x06,  // req:TopoQuery (optional); resp:TLV blob (V2 if asked), or only its stamp if unchanged
+  BUNDLE          = 0x07,  // several requests in one frame (Bundle.h)
+  GET_LINKSTATS   = 0x08,  // req:LinkStatsReq; resp:paged LinkStat (LinkStats.h)
+  TIME_SYNC       = 0x09,  // req:TimeSyncReq; resp:TimeSyncResp (TimeSync.h); ICM -> node
   BUZZ_PING       = 0x10,  // no body
   LED_PING        = 0x11,  // tiny rgb if supported
   SET_FAN_MODE    = 0x12,  // uint8_t
@@ -18,16 +21,26 @@ enum : uint8_t {
   RESTART_HARD    = 0x14,  // esp_restart if allowed
   SILENCE_OUTPUTS = 0x15,  // buzzer/led off
   SET_TIME        = 0x16,  // uint32_t unix
+  FW_BEGIN        = 0x17,  // req:FwBeginReq; resp:FwStatus (Ota.h)
+  FW_CHUNK        = 0x18,  // FwChunkHdr + data, corr 0, unicast or broadcast
+  FW_STATUS       = 0x19,  // req:{uint8_t xid}; resp:FwStatus
+  FW_COMMIT       = 0x1A,  // req:FwCommitReq; resp:FwStatus
+  SEG_ACK         = 0x1F,  // transport: SegAck for segmented transfers
 
   // Relay (production)
   GET_RELAY_STATES= 0x20,  // bitmap/array
   SET_RELAY       = 0x21,  // {uint8_t ch; uint8_t on; uint16_t ms}
+  SET_GROUP       = 0x22,  // broadcast SetGroupPayload (Group.h)
+  SET_RELAY_AT    = 0x23,  // SetRelayAtPayload (RelayAt.h): mask write at a network time
 
   // Sensor (production)
   GET_TFLUNA_RAW  = 0x30,  // struct from Sensor/TFLuna
   GET_ENV         = 0x31,  // BME280 (tempC, hum, press)
   GET_LUX         = 0x32,  // VEML value
   SET_THRESHOLDS  = 0x33,  // SensorManager thresholds
+  GET_PRESENCE    = 0x34,  // uint8_t: bit0 A, bit1 B, bits2-3 direction
+  SENS_SUBSCRIBE  = 0x35,  // req:SensSubReq; resp:SensSubResp (SensReport.h)
+  SENS_REPORT     = 0x36,  // pushed to subscribers, corr 0, not answered
 
   // PMS
   GET_VI          = 0x40,  // VI struct
@@ -39,8 +52,24 @@ enum : uint8_t {
   REMOVE_PEER     = 0x51,  // MAC in payload
   PUSH_TOPOLOGY   = 0x52,  // TLV blob
   PUSH_CONFIG     = 0x53,  // role-specific config
+  PUSH_TOPO_DELTA = 0x54,  // req:delta TLV (TopologyTlv.h); resp:TopoDeltaResp
 
   // Emulators mirror production; payload prepends {uint8_t idx;}
+  // idx VIRT_MULTI + u16 mask reads several virtuals at once (adapters/VirtMux.h)
 };
 
+// Reads with no side effects. A retried one whose cached answer is gone runs
+// again instead of coming back as FLAG_DUP without data (EspNowCore::answerDuplicate).
+static inline bool isPureRead(uint8_t type){
+  switch(type){
+    case GET_TEMP: case GET_TIME: case GET_FAN_MODE: case GET_LOGS: case GET_FAULTS:
+    case GET_TOPOLOGY: case GET_LINKSTATS:
+    case GET_RELAY_STATES: case GET_TFLUNA_RAW: case GET_ENV: case GET_LUX: case GET_PRESENCE:
+    case GET_VI: case GET_POWER_SOURCE:
+      return true;
+    default:
+      return false;
+  }
+}
+
 } // namespace espnow
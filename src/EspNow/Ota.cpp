@@ -0,0 +1,23 @@
+#include "Ota.h"
+
+namespace espnow {
+
+static_assert(ESPNOW_OTA_CHUNK > 0 && ESPNOW_OTA_CHUNK <= FW_CHUNK_MAX, "ESPNOW_OTA_CHUNK must fit one frame");
+static_assert(ESPNOW_OTA_WINDOW >= 2 && ESPNOW_OTA_WINDOW <= 32, "FwStatus::have is 32 bits");
+
+// Nibble table: 64 bytes of flash, about 2 cycles per bit.
+uint32_t fwCrc32(uint32_t crc, const uint8_t* p, size_t n){
+  static const uint32_t T[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  crc = ~crc;
+  while(n--){
+    crc ^= *p++;
+    crc = (crc >> 4) ^ T[crc & 0x0F];
+    crc = (crc >> 4) ^ T[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+} // namespace espnow
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <esp_now.h>
+#include "Frame.h"
+#include "../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Firmware over ESP-NOW. The sender (adapters/OtaTx.h) opens a session per
+// target with FW_BEGIN, streams FW_CHUNK frames (corr 0, unicast or broadcast)
+// inside a sliding window, polls FW_STATUS for what arrived and resends the
+// holes, then FW_COMMIT. The node (OtaRx.h) keeps only the window: chunks are
+// written to the inactive OTA partition in order as soon as they are contiguous.
+//   FW_BEGIN  req: FwBeginReq        resp: FwStatus
+//   FW_CHUNK  req: FwChunkHdr + data (no answer; a bad CRC is simply a hole)
+//   FW_STATUS req: {uint8_t xid}     resp: FwStatus
+//   FW_COMMIT req: FwCommitReq       resp: FwStatus (image CRC checked, boot slot set)
+#pragma pack(push,1)
+struct FwBeginReq {
+  uint8_t  xid;          // session id, != 0
+  uint32_t size;         // image bytes
+  uint32_t crc32;        // whole image (fwCrc32)
+  uint16_t chunk;        // bytes per chunk, <= FW_CHUNK_MAX
+};
+
+struct FwChunkHdr {
+  uint8_t  xid;
+  uint16_t idx;
+  uint32_t crc32;        // this chunk's data
+};
+
+struct FwCommitReq {
+  uint8_t  xid;
+  uint8_t  reboot;       // restart ESPNOW_OTA_REBOOT_MS after answering
+};
+
+struct FwStatus {
+  uint8_t  xid;
+  uint8_t  state;        // FWS_*
+  uint8_t  err;          // FW_*
+  uint16_t base;         // first chunk not yet written
+  uint32_t have;         // bit i: chunk base+i held in the window
+  uint32_t written;      // bytes in flash
+};
+#pragma pack(pop)
+
+enum : uint8_t { FWS_IDLE = 0, FWS_RECEIVING = 1, FWS_COMPLETE = 2, FWS_COMMITTED = 3, FWS_FAILED = 4 };
+
+enum : uint8_t {
+  FW_OK               = 0,
+  FW_ERR_NO_PARTITION = 1,   // no OTA slot in the partition table
+  FW_ERR_TOO_BIG      = 2,
+  FW_ERR_ARGS         = 3,
+  FW_ERR_NO_MEM       = 4,
+  FW_ERR_FLASH        = 5,
+  FW_ERR_XID          = 6,   // not this node's session
+  FW_ERR_INCOMPLETE   = 7,
+  FW_ERR_CRC          = 8,   // image CRC mismatch at commit
+  FW_ERR_IMAGE        = 9,   // esp_ota_end() rejected the image
+  // sender side only
+  FW_ERR_TIMEOUT      = 0x80,
+  FW_ERR_READ         = 0x81,
+  FW_ERR_ABORTED      = 0x82,
+};
+
+constexpr uint16_t FW_CHUNK_MAX = uint16_t(ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader) - sizeof(FwChunkHdr));
+
+// CRC-32 (IEEE, reflected). Start with 0 and feed the image in any split.
+uint32_t fwCrc32(uint32_t crc, const uint8_t* p, size_t n);
+
+} // namespace espnow
@@ -0,0 +1,120 @@
+#include "OtaRx.h"
+#include <cstring>
+
+#include <esp_heap_caps.h>
+
+namespace espnow {
+
+OtaRx::~OtaRx(){
+  if(open_) esp_ota_abort(h_);
+  heap_caps_free(buf_);
+}
+
+bool OtaRx::reply(EspNowResp& out, uint8_t xid, uint8_t err) const {
+  if(out.out_cap < sizeof(FwStatus)) return false;
+  FwStatus s{ xid, xid == xid_ ? state_ : uint8_t(FWS_IDLE), err, base_, have_, written_ };
+  std::memcpy(out.out, &s, sizeof(s));
+  out.out_len = sizeof(s);
+  return true;
+}
+
+void OtaRx::fail(uint8_t err){
+  if(open_){ esp_ota_abort(h_); open_ = false; }
+  state_ = FWS_FAILED; err_ = err;
+}
+
+// A retried FW_BEGIN for the live session just reports progress.
+bool OtaRx::onBegin(const EspNowMsg& in, EspNowResp& out){
+  if(in.payload_len < sizeof(FwBeginReq)) return false;
+  FwBeginReq r; std::memcpy(&r, in.payload, sizeof(r));
+  if(r.xid && r.xid == xid_ && state_ != FWS_FAILED) return reply(out, r.xid, FW_OK);
+  if(open_){ esp_ota_abort(h_); open_ = false; }
+  xid_ = r.xid; state_ = FWS_FAILED;
+  base_ = 0; have_ = 0; written_ = 0; running_ = 0;
+  if(!r.xid || !r.size || !r.chunk || r.chunk > FW_CHUNK_MAX || (r.size + r.chunk - 1) / r.chunk > 0xFFFF)
+    return reply(out, r.xid, err_ = FW_ERR_ARGS);
+  part_ = esp_ota_get_next_update_partition(nullptr);
+  if(!part_) return reply(out, r.xid, err_ = FW_ERR_NO_PARTITION);
+  if(r.size > part_->size) return reply(out, r.xid, err_ = FW_ERR_TOO_BIG);
+  if(!buf_) buf_ = static_cast<uint8_t*>(heap_caps_malloc(size_t(ESPNOW_OTA_WINDOW) * FW_CHUNK_MAX, MALLOC_CAP_8BIT));
+  if(!buf_) return reply(out, r.xid, err_ = FW_ERR_NO_MEM);
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+  const size_t eraseHint = OTA_WITH_SEQUENTIAL_WRITES;   // erase sector by sector, not all up front
+#else
+  const size_t eraseHint = r.size;
+#endif
+  if(esp_ota_begin(part_, eraseHint, &h_) != ESP_OK) return reply(out, r.xid, err_ = FW_ERR_FLASH);
+  open_ = true;
+  size_ = r.size; crc_ = r.crc32; chunk_ = r.chunk;
+  count_ = uint16_t((r.size + r.chunk - 1) / r.chunk);
+  state_ = FWS_RECEIVING; err_ = FW_OK;
+  return reply(out, r.xid, FW_OK);
+}
+
+bool OtaRx::onChunk(const EspNowMsg& in){
+  if(in.payload_len < sizeof(FwChunkHdr)) return false;
+  FwChunkHdr h; std::memcpy(&h, in.payload, sizeof(h));
+  if(h.xid != xid_ || state_ != FWS_RECEIVING) return false;   // another node's session
+  const uint8_t* d = in.payload + sizeof(h);
+  uint16_t n = uint16_t(in.payload_len - sizeof(h));
+  uint32_t want = (h.idx + 1u == count_) ? size_ - uint32_t(h.idx) * chunk_ : chunk_;
+  if(h.idx >= count_ || n != want || fwCrc32(0, d, n) != h.crc32){ st_.badCrc++; return false; }
+  if(h.idx < base_){ st_.dups++; return true; }
+  uint16_t off = uint16_t(h.idx - base_);
+  if(off >= ESPNOW_OTA_WINDOW){ st_.outside++; return false; }
+  if(have_ & (1u << off)){ st_.dups++; return true; }
+  std::memcpy(buf_ + size_t(h.idx % ESPNOW_OTA_WINDOW) * FW_CHUNK_MAX, d, n);
+  have_ |= 1u << off;
+  st_.chunks++;
+  drain();
+  return true;
+}
+
+// Writes the contiguous run at the window start; flash is only ever written in order.
+void OtaRx::drain(){
+  while(state_ == FWS_RECEIVING && (have_ & 1u)){
+    const uint8_t* p = buf_ + size_t(base_ % ESPNOW_OTA_WINDOW) * FW_CHUNK_MAX;
+    uint32_t n = (base_ + 1u == count_) ? size_ - uint32_t(base_) * chunk_ : chunk_;
+    if(esp_ota_write(h_, p, n) != ESP_OK){ fail(FW_ERR_FLASH); return; }
+    running_ = fwCrc32(running_, p, n);
+    written_ += n;
+    base_++; have_ >>= 1;
+    if(base_ == count_) state_ = FWS_COMPLETE;
+  }
+}
+
+bool OtaRx::onStatus(const EspNowMsg& in, EspNowResp& out){
+  if(in.payload_len < 1) return false;
+  uint8_t xid = in.payload[0];
+  return reply(out, xid, xid == xid_ ? err_ : uint8_t(FW_ERR_XID));
+}
+
+bool OtaRx::onCommit(const EspNowMsg& in, EspNowResp& out, uint32_t nowMs){
+  if(in.payload_len < sizeof(FwCommitReq)) return false;
+  FwCommitReq r; std::memcpy(&r, in.payload, sizeof(r));
+  if(r.xid != xid_) return reply(out, r.xid, FW_ERR_XID);
+  if(state_ == FWS_COMPLETE){
+    open_ = false;
+    if(running_ != crc_){ esp_ota_abort(h_); state_ = FWS_FAILED; err_ = FW_ERR_CRC; }
+    else if(esp_ota_end(h_) != ESP_OK){ state_ = FWS_FAILED; err_ = FW_ERR_IMAGE; }
+    else if(esp_ota_set_boot_partition(part_) != ESP_OK){ state_ = FWS_FAILED; err_ = FW_ERR_FLASH; }
+    else state_ = FWS_COMMITTED;
+  }
+  if(state_ == FWS_RECEIVING) return reply(out, r.xid, FW_ERR_INCOMPLETE);
+  if(state_ == FWS_COMMITTED && r.reboot && !reboot_){ reboot_ = true; rebootMs_ = nowMs + ESPNOW_OTA_REBOOT_MS; }
+  return reply(out, r.xid, err_);
+}
+
+bool OtaRx::rebootDue(uint32_t nowMs){
+  if(!reboot_ || (int32_t)(nowMs - rebootMs_) < 0) return false;
+  reboot_ = false;
+  return true;
+}
+
+uint32_t OtaRx::rebootWaitMs(uint32_t nowMs) const {
+  if(!reboot_) return UINT32_MAX;
+  int32_t d = (int32_t)(rebootMs_ - nowMs);
+  return d > 0 ? uint32_t(d) : 0;
+}
+
+} // namespace espnow
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <esp_ota_ops.h>
+#include "Frame.h"
+#include "Ota.h"
+
+namespace espnow {
+
+// Node side of the firmware transfer (Ota.h), run by the core for every role.
+// One session at a time; a FW_BEGIN with another xid replaces it. Chunks are
+// held in a ESPNOW_OTA_WINDOW buffer only until the gap before them fills.
+class OtaRx {
+public:
+  struct Stats {
+    uint32_t chunks;      // accepted into the window
+    uint32_t dups;        // already held or written
+    uint32_t badCrc;
+    uint32_t outside;     // beyond the window
+  };
+
+  ~OtaRx();
+  bool onBegin (const EspNowMsg& in, EspNowResp& out);
+  bool onChunk (const EspNowMsg& in);
+  bool onStatus(const EspNowMsg& in, EspNowResp& out);
+  bool onCommit(const EspNowMsg& in, EspNowResp& out, uint32_t nowMs);
+  bool rebootDue(uint32_t nowMs);      // true once, when a commit asked for it
+  uint32_t rebootWaitMs(uint32_t nowMs) const;   // UINT32_MAX when none is pending
+
+  uint8_t state() const { return state_; }
+  Stats   stats() const { return st_; }
+
+private:
+  bool reply(EspNowResp& out, uint8_t xid, uint8_t err) const;
+  void drain();
+  void fail(uint8_t err);
+
+  uint8_t  xid_{0};
+  uint8_t  state_{FWS_IDLE};
+  uint8_t  err_{FW_OK};
+  uint32_t size_{0}, crc_{0}, running_{0}, written_{0};
+  uint16_t chunk_{0}, count_{0}, base_{0};
+  uint32_t have_{0};                   // bit i: chunk base_+i buffered
+  uint8_t* buf_{nullptr};              // ESPNOW_OTA_WINDOW * FW_CHUNK_MAX, kept once allocated
+  esp_ota_handle_t h_{0};
+  const esp_partition_t* part_{nullptr};
+  bool     open_{false};
+  bool     reboot_{false};
+  uint32_t rebootMs_{0};
+  Stats    st_{};
+};
+
+} // namespace espnow
@@ -1,83 +1,306 @@
 #include "Peers.h"
 #include <cstring>
+#include <new>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
 
 namespace espnow {
 
-Peers::Peers() : used_(0) {}
+static_assert(ESPNOW_PEER_CAPACITY < 0x7FFF, "peer index is int16_t");
+
+Peers::Peers() {}
+
+Peers::~Peers(){
+  if(table_) heap_caps_free(table_);
+  if(index_) heap_caps_free(index_);
+}
 
 static inline bool macEq(const uint8_t* a, const uint8_t* b){ return std::memcmp(a,b,6)==0; }
 
-int Peers::indexOf(const uint8_t mac[6]) const {
-  for(size_t i=0;i<used_;++i) if(macEq(table_[i].mac, mac)) return (int)i;
+static void* peerAlloc(size_t bytes){
+  void* p = nullptr;
+#if ESPNOW_PEERS_IN_PSRAM
+  p = heap_caps_calloc(1, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+  if(!p) p = heap_caps_calloc(1, bytes, MALLOC_CAP_8BIT);
+  return p;
+}
+
+bool Peers::ensureStorage(){
+  if(table_ && index_) return true;
+  table_ = static_cast<Peer*>(peerAlloc(sizeof(Peer) * ESPNOW_PEER_CAPACITY));
+  index_ = static_cast<int16_t*>(peerAlloc(sizeof(int16_t) * BUCKETS));
+  if(!table_ || !index_){
+    if(table_) heap_caps_free(table_);
+    if(index_) heap_caps_free(index_);
+    table_ = nullptr; index_ = nullptr;
+    return false;
+  }
+  for(size_t i=0;i<ESPNOW_PEER_CAPACITY;++i) new (&table_[i]) Peer();
+  for(size_t b=0;b<BUCKETS;++b) index_[b] = -1;
+  return true;
+}
+
+// FNV-1a; the NIC-specific tail bytes carry most of the entropy.
+size_t Peers::hashMac(const uint8_t mac[6]){
+  uint32_t h = 2166136261u;
+  for(int i=5;i>=0;--i){ h ^= mac[i]; h *= 16777619u; }
+  return h & (BUCKETS - 1);
+}
+
+int Peers::slotOf(const uint8_t mac[6]) const {
+  if(!index_) return -1;
+  for(size_t b = hashMac(mac), n = 0; n < BUCKETS; b = (b + 1) & (BUCKETS - 1), ++n){
+    int16_t i = index_[b];
+    if(i < 0) return -1;
+    if(macEq(table_[i].mac, mac)) return (int)b;
+  }
   return -1;
 }
 
+int Peers::indexOf(const uint8_t mac[6]) const {
+  int b = slotOf(mac);
+  return b < 0 ? -1 : index_[b];
+}
+
+int Peers::lruVictim(uint32_t nowMs) const {
+  int victim = -1; uint32_t oldest = 0;
+  for(size_t i=0;i<used_;++i){
+    const Peer& p = table_[i];
+    if(p.flags & PEER_PINNED) continue;
+    uint32_t age = nowMs - p.lastSeenMs;
+    if(age >= ESPNOW_PEER_STALE_MS && age >= oldest){ oldest = age; victim = (int)i; }
+  }
+  return victim;
+}
+
+int Peers::insert(const uint8_t mac[6], uint8_t role, uint32_t nowMs){
+  if(!ensureStorage()) return -1;
+  if(used_ >= ESPNOW_PEER_CAPACITY){
+    int v = lruVictim(nowMs);
+    if(v < 0) return -1;
+    eraseAt((size_t)v);
+  }
+  size_t idx = used_++;
+  Peer& p = table_[idx];
+  p = Peer();
+  std::memcpy(p.mac, mac, 6);
+  p.role = role;
+  size_t b = hashMac(mac);
+  while(index_[b] >= 0) b = (b + 1) & (BUCKETS - 1);
+  index_[b] = (int16_t)idx;
+  return (int)idx;
+}
+
+// Backward-shift delete keeps probe chains intact without tombstones.
+void Peers::eraseAt(size_t idx){
+  int hole = slotOf(table_[idx].mac);
+  if(hole < 0) return;
+  index_[hole] = -1;
+  for(size_t b = (hole + 1) & (BUCKETS - 1); index_[b] >= 0; b = (b + 1) & (BUCKETS - 1)){
+    size_t home = hashMac(table_[index_[b]].mac);
+    // Move b into the hole if its home is not cyclically within (hole, b].
+    bool between = (hole <= (int)b) ? ((int)home > hole && home <= b) : ((int)home > hole || home <= b);
+    if(between) continue;
+    index_[hole] = index_[b];
+    index_[b] = -1;
+    hole = (int)b;
+  }
+  size_t last = used_ - 1;
+  if(idx != last){
+    int lb = slotOf(table_[last].mac);
+    table_[idx] = table_[last];
+    if(lb >= 0) index_[lb] = (int16_t)idx;
+  }
+  used_--;
+}
+
 bool Peers::add(const uint8_t mac[6], uint8_t role){
   int idx = indexOf(mac);
   if(idx >= 0) { table_[idx].role = role; return true; }
-  if(used_ >= MAX_PEERS) return false;
-  std::memcpy(table_[used_].mac, mac, 6);
-  table_[used_].role = role;
-  table_[used_].rssi = INT32_MIN;
-  table_[used_].lastSeenMs = 0;
-  table_[used_].name[0] = 0;
-  std::memcpy(table_[used_].token, "\0\0\0\0\0\0\0\0", 8);
-  used_++;
+  return insert(mac, role, lastNowMs_) >= 0;
+}
+
+bool Peers::pin(const uint8_t mac[6], uint8_t role){
+  int idx = indexOf(mac);
+  if(idx < 0) idx = insert(mac, role, lastNowMs_);
+  if(idx < 0) return false;
+  table_[idx].role = role;
+  table_[idx].flags = (uint8_t)((table_[idx].flags & ~PEER_PENDING) | PEER_PINNED);
+  return true;
+}
+
+bool Peers::addPending(const uint8_t mac[6]){
+  int idx = indexOf(mac);
+  if(idx >= 0 && (table_[idx].flags & PEER_PINNED)) return true;
+  if(idx < 0) idx = insert(mac, 0, lastNowMs_);
+  if(idx < 0) return false;
+  table_[idx].flags |= PEER_PENDING;
+  table_[idx].lastSeenMs = lastNowMs_;
+  return true;
+}
+
+size_t Peers::pendingCount() const {
+  size_t n = 0;
+  for(size_t i = 0; i < used_; ++i) if(table_[i].flags & PEER_PENDING) n++;
+  return n;
+}
+
+bool Peers::evictOldestPending(uint8_t mac[6]){
+  int victim = -1; uint32_t oldest = 0;
+  for(size_t i = 0; i < used_; ++i){
+    const Peer& p = table_[i];
+    if(!(p.flags & PEER_PENDING)) continue;
+    uint32_t age = lastNowMs_ - p.lastSeenMs;
+    if(victim < 0 || age > oldest){ oldest = age; victim = (int)i; }
+  }
+  if(victim < 0) return false;
+  std::memcpy(mac, table_[victim].mac, 6);
+  eraseAt((size_t)victim);
   return true;
 }
 
 bool Peers::remove(const uint8_t mac[6]){
   int idx = indexOf(mac);
   if(idx < 0) return false;
-  if((size_t)idx != used_-1) table_[idx] = table_[used_-1];
-  used_--;
+  eraseAt((size_t)idx);
   return true;
 }
 
 bool Peers::has(const uint8_t mac[6]) const { return indexOf(mac) >= 0; }
 
-bool Peers::setRole(const uint8_t mac[6], uint8_t role){
+const Peer* Peers::find(const uint8_t mac[6]) const {
   int idx = indexOf(mac);
-  if(idx < 0) return false;
-  table_[idx].role = role;
+  return idx < 0 ? nullptr : &table_[idx];
+}
+
+Peer* Peers::find(const uint8_t mac[6]){
+  int idx = indexOf(mac);
+  return idx < 0 ? nullptr : &table_[idx];
+}
+
+bool Peers::setRole(const uint8_t mac[6], uint8_t role){
+  Peer* p = find(mac);
+  if(!p) return false;
+  p->role = role;
   return true;
 }
 
 bool Peers::setName(const uint8_t mac[6], const char* name32){
-  int idx = indexOf(mac);
-  if(idx < 0) return false;
-  std::strncpy(table_[idx].name, name32, sizeof(table_[idx].name));
-  table_[idx].name[sizeof(table_[idx].name)-1] = 0;
+  Peer* p = find(mac);
+  if(!p) return false;
+  std::strncpy(p->name, name32, sizeof(p->name));
+  p->name[sizeof(p->name)-1] = 0;
   return true;
 }
 
 bool Peers::setToken(const uint8_t mac[6], const char token32[32]){
-  int idx = indexOf(mac);
-  if(idx < 0) return false;
-  std::memcpy(table_[idx].token, token32, 32);
+  Peer* p = find(mac);
+  if(!p) return false;
+  std::memcpy(p->token, token32, 32);
   return true;
 }
 
 bool Peers::updateSeen(const uint8_t mac[6], int32_t rssi, uint32_t nowMs){
+  lastNowMs_ = nowMs;
   int idx = indexOf(mac);
-  if(idx < 0) { if(!add(mac)) return false; idx = indexOf(mac); }
-  table_[idx].rssi = rssi;
-  table_[idx].lastSeenMs = nowMs;
+  if(idx < 0) idx = insert(mac, 0, nowMs);
+  if(idx < 0) return false;
+  Peer& p = table_[idx];
+  p.lastSeenMs = nowMs;
+  if(rssi == 0) return true;                 // driver gave no RSSI for this frame
+  p.rssi = rssi;
+  if(p.flags & PEER_RSSI) p.rssiAvgQ4 = (int16_t)(p.rssiAvgQ4 + (rssi * 16 - p.rssiAvgQ4) / 8);
+  else { p.rssiAvgQ4 = (int16_t)(rssi * 16); p.flags |= PEER_RSSI; }
   return true;
 }
 
+uint16_t Peers::nextTxSeq(const uint8_t mac[6]){
+  Peer* p = find(mac);
+  if(!p) return 0;
+  if(!++p->txSeq) p->txSeq = 1;
+  return p->txSeq;
+}
+
+// A sender that rebooted restarts at seq 1 with a new boot nonce; without the
+// nonce check its first 64 requests would land inside the old window as dups.
+// Starts at a random point so a reboot does not replay the previous run's xids.
+uint8_t Peers::nextSegXid(const uint8_t mac[6]){
+  Peer* p = find(mac);
+  if(!p) return 0;
+  if(!p->segXid) p->segXid = (uint8_t)esp_random();
+  if(!++p->segXid) p->segXid = 1;
+  return p->segXid;
+}
+
+SeqVerdict Peers::checkSeq(Peer& p, uint16_t seq, uint16_t boot){
+  int16_t d = (int16_t)(seq - p.rxSeqTop);
+  if(!(p.flags & PEER_SEQ) || boot != p.rxBoot || d <= -64){
+    SeqVerdict v = (p.flags & PEER_SEQ) ? SEQ_RESYNC : SEQ_NEW;
+    p.flags |= PEER_SEQ; p.rxSeqTop = seq; p.rxSeqMask = 1; p.rxBoot = boot;
+    return v;
+  }
+  if(d > 0){
+    p.rxSeqMask = (d >= 64) ? 1 : ((p.rxSeqMask << d) | 1);
+    p.rxSeqTop = seq;
+    return SEQ_NEW;
+  }
+  uint64_t bit = 1ull << (-d);
+  if(p.rxSeqMask & bit){ p.rxDups++; return SEQ_DUP; }
+  p.rxSeqMask |= bit;
+  return SEQ_NEW;
+}
+
+bool Peers::resetSeq(const uint8_t mac[6]){
+  Peer* p = find(mac);
+  if(!p) return false;
+  p->flags &= (uint8_t)~PEER_SEQ;
+  return true;
+}
+
+bool Peers::noteTx(const uint8_t mac[6], bool ok){
+  Peer* p = find(mac);
+  if(!p) return false;
+  if(ok) p->txOk++; else p->txFail++;
+  if(ok && (p->flags & PEER_PENDING)) p->flags = (uint8_t)((p->flags & ~PEER_PENDING) | PEER_PINNED);
+  p->lossQ4 = (uint16_t)(p->lossQ4 + ((ok ? 0 : 16000) - (int32_t)p->lossQ4) / 16);
+  return true;
+}
+
+bool Peers::noteRtt(const uint8_t mac[6], uint32_t rttMs){
+  Peer* p = find(mac);
+  if(!p) return false;
+  if(rttMs > 0xFFFF) rttMs = 0xFFFF;
+  p->rttMs = p->rttMs ? (uint16_t)((p->rttMs * 7u + rttMs) / 8u) : (uint16_t)(rttMs ? rttMs : 1);
+  return true;
+}
+
+bool Peers::evictStale(uint32_t nowMs, uint8_t mac[6], uint32_t maxAgeMs){
+  lastNowMs_ = nowMs;
+  for(size_t i = used_; i-- > 0; ){
+    const Peer& p = table_[i];
+    if(p.flags & PEER_PINNED) continue;
+    if((uint32_t)(nowMs - p.lastSeenMs) < maxAgeMs) continue;
+    std::memcpy(mac, p.mac, 6);
+    eraseAt(i);
+    return true;
+  }
+  return false;
+}
+
 size_t Peers::count() const { return used_; }
 
 bool Peers::getByIndex(size_t i, Peer& out) const {
-  if(i>=used_) return false;
-  out = table_[i];
+  const Peer* p = at(i);
+  if(!p) return false;
+  out = *p;
   return true;
 }
 
 bool Peers::getByMac(const uint8_t mac[6], Peer& out) const {
-  int idx = indexOf(mac);
-  if(idx < 0) return false;
-  out = table_[idx];
+  const Peer* p = find(mac);
+  if(!p) return false;
+  out = *p;
   return true;
 }
 
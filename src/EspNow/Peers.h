@@ -1,38 +1,100 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <climits>
+#include "../Config/EspNowConfig.h"
+#include "Admission.h"
 
 namespace espnow {
 
+enum : uint8_t {
+  PEER_PINNED = 0x01,   // registered explicitly (addPeer / pairing); never evicted
+  PEER_SEQ    = 0x02,   // rxSeqTop/rxSeqMask hold a window
+  PEER_RSSI   = 0x04,   // rssiAvgQ4 holds a sample
+  PEER_PENDING= 0x08,   // added by PAIR_EXCHANGE; pinned on the first ACKed frame to it
+};
+
+enum SeqVerdict : uint8_t { SEQ_NEW=0, SEQ_DUP=1, SEQ_RESYNC=2 };
+
 struct Peer {
   uint8_t  mac[6]{};
   uint8_t  role{0};
-  int32_t  rssi{INT32_MIN};
+  uint8_t  flags{0};      // PEER_*
+  int32_t  rssi{INT32_MIN};  // last frame, dBm
+  int16_t  rssiAvgQ4{0};     // EWMA (1/8) of rssi, x16
+  uint16_t lossQ4{0};        // EWMA (1/16) of NACKs, permille x16
+  uint16_t rttMs{0};         // EWMA (1/8) of request round trips
   uint32_t lastSeenMs{0};
   char     name[32]{};
   char     token[32]{};
+  uint32_t txOk{0};       // send callbacks reporting ACK
+  uint32_t txFail{0};     // send callbacks reporting NACK / lost completion
+  uint16_t txSeq{0};      // last seq sent to this peer
+  uint8_t  segXid{0};     // last segmented-transfer xid sent to this peer
+  uint16_t rxSeqTop{0};   // highest seq received from this peer
+  uint64_t rxSeqMask{0};  // bit i: rxSeqTop - i seen
+  uint16_t rxBoot{0};     // sender's boot nonce the window belongs to
+  uint32_t rxDups{0};
+  TokenBucket admit;      // receive admission while pinned
 };
 
+// Dense Peer storage + open-addressing (linear probe) MAC index.
+// Pointers returned by find()/at() stay valid until the next add/remove.
 class Peers {
 public:
   Peers();
+  ~Peers();
+  Peers(const Peers&) = delete;
+  Peers& operator=(const Peers&) = delete;
+
   bool add(const uint8_t mac[6], uint8_t role=0);
+  bool pin(const uint8_t mac[6], uint8_t role=0);      // add + PEER_PINNED
+  bool addPending(const uint8_t mac[6]);               // add + PEER_PENDING unless pinned
+  size_t pendingCount() const;
+  bool evictOldestPending(uint8_t mac[6]);             // mac = the one dropped
   bool remove(const uint8_t mac[6]);
   bool has(const uint8_t mac[6]) const;
   bool setRole(const uint8_t mac[6], uint8_t role);
   bool setName(const uint8_t mac[6], const char* name32);
   bool setToken(const uint8_t mac[6], const char token32[32]);
   bool updateSeen(const uint8_t mac[6], int32_t rssi, uint32_t nowMs);
+  bool noteTx(const uint8_t mac[6], bool ok);
+  bool noteRtt(const uint8_t mac[6], uint32_t rttMs);
+  uint16_t   nextTxSeq(const uint8_t mac[6]);        // 0 if mac is unknown
+  uint8_t    nextSegXid(const uint8_t mac[6]);       // 0 if mac is unknown
+  SeqVerdict checkSeq(Peer& p, uint16_t seq, uint16_t boot);  // marks seq as seen
+  bool       resetSeq(const uint8_t mac[6]);         // next sequenced frame starts a new window
+  bool evictStale(uint32_t nowMs, uint8_t mac[6], uint32_t maxAgeMs=ESPNOW_PEER_STALE_MS);   // one per call
+
   size_t count() const;
+  size_t capacity() const { return ESPNOW_PEER_CAPACITY; }
+
+  // In-place access (no Peer copies).
+  const Peer* find(const uint8_t mac[6]) const;
+  Peer*       find(const uint8_t mac[6]);
+  const Peer* at(size_t i) const { return (i < used_) ? &table_[i] : nullptr; }
+  const Peer* begin() const { return table_; }
+  const Peer* end() const { return table_ ? table_ + used_ : nullptr; }
+
   bool getByIndex(size_t i, Peer& out) const;
   bool getByMac(const uint8_t mac[6], Peer& out) const;
   void forEach(bool (*fn)(const Peer&)) const;
 
 private:
-  static constexpr size_t MAX_PEERS = 32;
-  Peer table_[MAX_PEERS];
-  size_t used_;
-  int indexOf(const uint8_t mac[6]) const;
+  static constexpr size_t BUCKETS = [](){ size_t b = 1; while(b < ESPNOW_PEER_CAPACITY * 2) b <<= 1; return b; }();
+
+  bool ensureStorage();
+  static size_t hashMac(const uint8_t mac[6]);
+  int  slotOf(const uint8_t mac[6]) const;     // bucket holding mac, or -1
+  int  indexOf(const uint8_t mac[6]) const;    // dense index, or -1
+  int  insert(const uint8_t mac[6], uint8_t role, uint32_t nowMs);
+  void eraseAt(size_t idx);
+  int  lruVictim(uint32_t nowMs) const;
+
+  Peer*    table_{nullptr};   // dense, [0, used_)
+  int16_t* index_{nullptr};   // BUCKETS entries, -1 = empty
+  size_t   used_{0};
+  uint32_t lastNowMs_{0};
 };
 
 } // namespace espnow
@@ -0,0 +1,162 @@
+#include "Profile.h"
+#if ESPNOW_PROFILE
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#ifdef ESPNOW_HOST_SIM
+#include <chrono>
+#endif
+
+// ---- allocation counter ----------------------------------------------------
+// Global operator new is replaced so allocations made while a frame is being
+// handled can be counted. Only the armed task counts; other tasks pass through.
+
+static volatile bool     g_armed  = false;
+static TaskHandle_t      g_task   = nullptr;
+static volatile uint32_t g_allocs = 0;
+
+static inline void countAlloc(){
+  if(g_armed && xTaskGetCurrentTaskHandle() == g_task) g_allocs++;
+}
+
+static void* allocOrDie(size_t n){
+  countAlloc();
+  void* p = std::malloc(n ? n : 1);
+  if(!p){
+#if defined(__cpp_exceptions)
+    throw std::bad_alloc();
+#else
+    std::abort();
+#endif
+  }
+  return p;
+}
+
+void* operator new(size_t n){ return allocOrDie(n); }
+void* operator new[](size_t n){ return allocOrDie(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { countAlloc(); return std::malloc(n ? n : 1); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { countAlloc(); return std::malloc(n ? n : 1); }
+void  operator delete(void* p) noexcept { std::free(p); }
+void  operator delete[](void* p) noexcept { std::free(p); }
+void  operator delete(void* p, size_t) noexcept { std::free(p); }
+void  operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace espnow {
+
+// ---- clock -----------------------------------------------------------------
+#ifdef ESPNOW_HOST_SIM
+static uint64_t ticks(){
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static uint32_t elapsedNs(uint64_t t0){ return (uint32_t)(ticks() - t0); }
+#else
+static uint64_t ticks(){ return ESP.getCycleCount(); }
+static uint32_t elapsedNs(uint64_t t0){
+  uint32_t cyc = ESP.getCycleCount() - (uint32_t)t0;     // wraps every ~18 s at 240 MHz
+  return (uint32_t)((uint64_t)cyc * 1000u / ESP.getCpuFreqMHz());
+}
+#endif
+
+// ---- stack -----------------------------------------------------------------
+// Paint the unused stack below the caller, then find the deepest byte touched.
+#ifndef ESPNOW_HOST_SIM
+static constexpr uint8_t  PAINT       = 0xA5;
+static constexpr uintptr_t PAINT_GUARD = 64;    // never write the bottom of the stack
+static constexpr uintptr_t PAINT_SKIP  = 256;   // room for begin() and memset() themselves
+#endif
+
+void DispatchProfiler::begin(uint16_t key){
+  cur_ = slot(key);
+  if(!cur_){ untracked_++; return; }
+#ifndef ESPNOW_HOST_SIM
+  sp0_ = (uint8_t*)__builtin_frame_address(0);
+  paintLo_ = pxTaskGetStackStart(nullptr) + PAINT_GUARD;
+  if(sp0_ > paintLo_ + PAINT_SKIP) std::memset(paintLo_, PAINT, (size_t)(sp0_ - PAINT_SKIP - paintLo_));
+  else paintLo_ = nullptr;
+#endif
+  g_task = xTaskGetCurrentTaskHandle();
+  a0_ = g_allocs;
+  g_armed = true;
+  t0_ = ticks();
+}
+
+void DispatchProfiler::end(){
+  if(!cur_) return;
+  uint32_t ns = elapsedNs(t0_);
+  g_armed = false;
+  uint32_t allocs = g_allocs - a0_;
+  uint32_t stack = 0;
+#ifndef ESPNOW_HOST_SIM
+  if(paintLo_){
+    const uint8_t* p = paintLo_;
+    const uint8_t* top = sp0_ - PAINT_SKIP;
+    while(p < top && *p == PAINT) ++p;
+    stack = (uint32_t)(sp0_ - p);
+  }
+#endif
+  OpProfile& o = *cur_;
+  cur_ = nullptr;
+  o.frames++;
+  o.totalNs += ns;
+  o.allocs  += allocs;
+  if(ns > o.maxNs) o.maxNs = ns;
+  if(allocs > o.maxAllocs) o.maxAllocs = allocs;
+  if(stack > o.maxStack) o.maxStack = stack;
+  if((o.budgetNs     != OpProfile::NO_LIMIT && ns     > o.budgetNs) ||
+     (o.budgetAllocs != OpProfile::NO_LIMIT && allocs > o.budgetAllocs) ||
+     (o.budgetStack  != OpProfile::NO_LIMIT && stack  > o.budgetStack)) o.overBudget++;
+}
+
+OpProfile* DispatchProfiler::slot(uint16_t key){
+  OpProfile* freeSlot = nullptr;
+  for(auto& o : ops_){
+    if(o.key == key) return &o;
+    if(o.key == 0xFFFF && !freeSlot) freeSlot = &o;
+  }
+  if(freeSlot) freeSlot->key = key;
+  return freeSlot;
+}
+
+bool DispatchProfiler::setBudget(uint8_t type, bool response, uint32_t maxNs, uint32_t maxAllocs, uint32_t maxStack){
+  OpProfile* o = slot(profileKey(type, response));
+  if(!o) return false;
+  o->budgetNs = maxNs; o->budgetAllocs = maxAllocs; o->budgetStack = maxStack;
+  return true;
+}
+
+const OpProfile* DispatchProfiler::find(uint8_t type, bool response) const {
+  uint16_t key = profileKey(type, response);
+  for(const auto& o : ops_) if(o.key == key) return &o;
+  return nullptr;
+}
+
+uint32_t DispatchProfiler::overBudget() const {
+  uint32_t n = 0;
+  for(const auto& o : ops_) n += o.overBudget;
+  return n;
+}
+
+void DispatchProfiler::reset(){
+  for(auto& o : ops_){
+    o.frames = 0; o.totalNs = 0; o.maxNs = 0; o.allocs = 0;
+    o.maxAllocs = 0; o.maxStack = 0; o.overBudget = 0;
+  }
+  untracked_ = 0;
+}
+
+void DispatchProfiler::clear(){
+  for(auto& o : ops_){
+    o = OpProfile{};
+    o.key = 0xFFFF;
+    o.budgetNs = o.budgetAllocs = o.budgetStack = OpProfile::NO_LIMIT;
+  }
+  untracked_ = 0;
+}
+
+} // namespace espnow
+#endif // ESPNOW_PROFILE
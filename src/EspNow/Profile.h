@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Cost of one opcode on the receive path, accumulated while ESPNOW_PROFILE=1.
+// Requests and responses of the same opcode are kept apart (see profileKey()).
+struct OpProfile {
+  static constexpr uint32_t NO_LIMIT = 0xFFFFFFFFu;
+
+  uint16_t key;           // profileKey(); 0xFFFF = unused slot
+  uint32_t frames;
+  uint64_t totalNs;
+  uint32_t maxNs;
+  uint32_t allocs;        // operator new calls by the service task, all frames
+  uint32_t maxAllocs;     // worst single frame
+  uint32_t maxStack;      // bytes below onRecv(), worst frame (0 on the host)
+  uint32_t overBudget;    // frames that broke any limit below
+  uint32_t budgetNs;
+  uint32_t budgetAllocs;
+  uint32_t budgetStack;
+
+  uint32_t avgNs() const { return frames ? (uint32_t)(totalNs / frames) : 0; }
+};
+
+inline uint16_t profileKey(uint8_t type, bool response){ return (uint16_t)(type | (response ? 0x100 : 0)); }
+
+// Service task only. begin()/end() bracket one received frame.
+class DispatchProfiler {
+public:
+  DispatchProfiler(){ clear(); }
+
+  void begin(uint16_t key);
+  void end();
+
+  // Limits checked on every frame of that key; breaches count in overBudget so a
+  // host run can fail on a regression. Pass OpProfile::NO_LIMIT to leave one open.
+  bool setBudget(uint8_t type, bool response, uint32_t maxNs, uint32_t maxAllocs, uint32_t maxStack);
+
+  const OpProfile* find(uint8_t type, bool response=false) const;
+  const OpProfile* table() const { return ops_; }       // ESPNOW_PROFILE_OPS slots
+  uint32_t overBudget() const;                          // all keys
+  uint32_t untracked() const { return untracked_; }     // frames with no free slot
+  void     reset();                                     // counters only, budgets stay
+  void     clear();                                     // everything
+
+  struct Scope {
+    Scope(DispatchProfiler& p, uint16_t key) : p_(p) { p_.begin(key); }
+    ~Scope(){ p_.end(); }
+    DispatchProfiler& p_;
+  };
+
+private:
+  OpProfile* slot(uint16_t key);
+
+  OpProfile ops_[ESPNOW_PROFILE_OPS];
+  OpProfile* cur_{nullptr};
+  uint64_t  t0_{0};
+  uint32_t  a0_{0};
+  uint8_t*  sp0_{nullptr};
+  uint8_t*  paintLo_{nullptr};
+  uint32_t  untracked_{0};
+};
+
+} // namespace espnow
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+namespace espnow {
+
+// SET_RELAY_AT: apply (state & ~chMask) | (onMask & chMask) at atUs, in network
+// time (EspNowCore::networkTimeUs()). Sent ahead of the instant, so nodes switch
+// together whatever the airtime. Refused when the node is not synced, atUs is
+// more than ESPNOW_RELAY_AT_GRACE_MS past or ESPNOW_RELAY_AT_HORIZON_MS ahead,
+// or its queue is full. Emulators prepend {idx}; masks then use the virtual's
+// own channel numbering.
+#pragma pack(push,1)
+struct SetRelayAtPayload {
+  int64_t  atUs;
+  uint32_t chMask;
+  uint32_t onMask;
+};
+#pragma pack(pop)
+
+} // namespace espnow
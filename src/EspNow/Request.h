@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Frame.h"
+
+namespace espnow {
+
+class EspNowCore;
+
+enum ReqStatus : uint8_t {
+  REQ_OK         = 0,   // response received (payload may be empty)
+  REQ_REMOTE_ERR = 1,   // peer answered with FLAG_ERR
+  REQ_TIMEOUT    = 2,   // no response after all attempts
+  REQ_SEND_FAIL  = 3,   // driver/peer never ACKed after all attempts
+  REQ_CANCELLED  = 4,
+  REQ_DUPLICATE  = 5,   // peer had already executed it (earlier answer lost); no payload
+};
+
+struct ReqResult {
+  ReqStatus      status;
+  uint8_t        type;
+  uint16_t       corr;
+  uint8_t        attempts;  // sends made, first one included
+  uint32_t       rttMs;     // last send -> response (0 on timeout/send failure/cancel)
+  const uint8_t* payload;   // valid only for the duration of the callback
+  uint16_t       len;
+};
+
+// Invoked from the ESP-NOW service task; keep it short.
+using ReqDone = void(*)(const uint8_t mac[6], const ReqResult& r, void* ctx);
+
+// Caller-owned completion slot: no heap, one waiter. Keeps one frame's worth of
+// payload; use the callback form for segmented (multi-frame) responses.
+struct ReqFuture {
+  volatile bool done = false;
+  ReqStatus     status = REQ_CANCELLED;
+  uint16_t      len = 0;
+  uint32_t      rttMs = 0;
+  uint8_t       data[ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader)];
+  TaskHandle_t  volatile waiter = nullptr;
+  EspNowCore*   core = nullptr;   // set by EspNowCore::request(..., fut)
+  uint16_t      corr = 0;         // 0 = never queued, nothing will complete it
+
+  bool ready() const { return done; }
+
+  // Blocks the calling task (via its notification value) until completion or
+  // timeout. On timeout the request is cancelled, and wait() returns only once
+  // the service task is done with this future, so it may then leave scope.
+  // Returns true if a result arrived. Never call it from the ESP-NOW service
+  // task or a ReqDone callback: the completion it waits for runs there.
+  bool wait(uint32_t timeoutMs);
+
+  // The future may be released as soon as `done` is seen: touch nothing after.
+  static void complete(const uint8_t*, const ReqResult& r, void* ctx){
+    ReqFuture* f = static_cast<ReqFuture*>(ctx);
+    f->status = r.status;
+    f->rttMs  = r.rttMs;
+    f->len    = (r.len <= sizeof(f->data)) ? r.len : (uint16_t)sizeof(f->data);
+    if(r.payload && f->len) std::memcpy(f->data, r.payload, f->len);
+    TaskHandle_t w = f->waiter;
+    f->done = true;
+    if(w) xTaskNotifyGive(w);
+  }
+};
+
+} // namespace espnow
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <esp_now.h>
+#include "Frame.h"
+
+namespace espnow {
+
+// Segmented transfer wire format.
+// Data: EspNowHeader{type,flags|FLAG_SEG,corr} + SegHeader + fragment bytes.
+//       type/flags/corr are those of the whole message, so a reassembled
+//       response still matches its request.
+// Ack:  EspNowHeader{SEG_ACK,0,0} + SegAck, receiver -> sender.
+#pragma pack(push,1)
+struct SegHeader {
+  uint8_t  xid;     // transfer id, unique per sender among live transfers
+  uint8_t  rsv;
+  uint16_t idx;     // fragment index
+  uint16_t count;   // fragments in the message
+  uint16_t total;   // message bytes
+};
+
+struct SegAck {
+  uint8_t  xid;
+  uint8_t  status;  // SEG_ST_*
+  uint16_t base;    // first fragment not yet received (cumulative)
+  uint32_t mask;    // bit i: fragment base+1+i received (selective)
+};
+#pragma pack(pop)
+
+enum : uint8_t { SEG_ST_OK=0, SEG_ST_DONE=1, SEG_ST_REJECT=2 };
+
+static constexpr uint16_t SEG_FRAG_BYTES =
+  (uint16_t)(ESP_NOW_MAX_DATA_LEN - sizeof(EspNowHeader) - sizeof(SegHeader));
+
+} // namespace espnow
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+namespace espnow {
+
+// Topology roleParams of a SENS/SEMU: the relays each (virtual) sensor drives
+// on its own (adapters/LaneRules.h). A sequence of lane records:
+//   SensLaneHdr, then nNeg + nPos SensRelayRef (NEGRLS first, nearest first).
+// A car moving A->B runs a wave over POSRLS (ahead); B->A over NEGRLS.
+// lead/stepMs/onMs of 0 take the node's defaults (VLEAD_CT/VLEAD_MS/VON_MS).
+#pragma pack(push,1)
+struct SensLaneHdr {
+  uint8_t  virt;         // SENS: 0; SEMU: pair index
+  uint8_t  nNeg;         // NEGRLS (behind / prev)
+  uint8_t  nPos;         // POSRLS (ahead / next)
+  uint8_t  lead;         // relays lit per edge, nearest first
+  uint16_t onMs;         // how long each relay stays on
+  uint16_t stepMs;       // delay between consecutive relays
+};
+
+struct SensRelayRef {
+  uint8_t  mac[6];
+  uint8_t  idx;          // REMU virtual, or SENS_RELAY_PHYS for a production relay
+  uint8_t  ch;
+};
+#pragma pack(pop)
+
+enum : uint8_t { SENS_RELAY_PHYS = 0xFF };
+
+} // namespace espnow
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+namespace espnow {
+
+// Push-mode sensor telemetry.
+//   SENS_SUBSCRIBE: the requester becomes a subscriber. The node samples the
+//   pairs in `mask` every periodMs and pushes a SENS_REPORT every `decim`
+//   samples, or at once when a pair's presence/direction bits change.
+//   periodMs 0 cancels. SEMU takes no idx prefix here: mask picks the
+//   pairs. A subscription lapses after ESPNOW_SENS_SUB_LEASE_MS unless
+//   renewed by subscribing again.
+//   SENS_REPORT: SensReportHdr + one SensPairRec per bit of hdr.mask, in
+//   ascending pair order (all SEMU pairs coalesced into one frame). The ICM
+//   hands it to IcmRoleAdapter's report sink.
+#pragma pack(push,1)
+struct SensSubReq {
+  uint16_t periodMs;     // sampling cadence; raised to ESPNOW_SENS_MIN_PERIOD_MS
+  uint8_t  decim;        // push every n-th sample (0/1 = every sample)
+  uint16_t mask;         // pairs wanted (SENS: bit 0)
+};
+
+struct SensSubResp {
+  uint16_t periodMs;     // granted cadence (0 = cancelled)
+  uint16_t mask;         // pairs that will be reported
+};
+
+struct SensReportHdr {
+  uint8_t  seq;          // per subscription, wraps; gaps = lost reports
+  uint8_t  why;          // SENS_WHY_*
+  uint16_t mask;
+  uint16_t lux;          // shared ALS, saturating
+};
+
+struct SensPairRec {
+  uint8_t  pres;         // bit0 A, bit1 B, bits2-3 direction (as GET_PRESENCE)
+  uint16_t aMm;
+  uint16_t bMm;
+};
+#pragma pack(pop)
+
+enum : uint8_t { SENS_WHY_CADENCE = 0, SENS_WHY_EDGE = 1 };
+
+} // namespace espnow
@@ -1,16 +1,20 @@
 #pragma once
 #include <cstdint>
 
+// Peripheral classes live in the global namespace; naming them here lets the
+// glue in adapters/ see the real type once the .cpp includes its header.
+class RelayManager;
+
 namespace espnow {
 
 // Forward declarations only; include real headers in .cpp files
-struct RelayManager; struct SensorManager; struct DS18B20U;
+struct SensorManager; struct DS18B20U;
 struct BME280Manager; struct VEML7700Manager; struct CoolingManager;
 struct BuzzerManager; struct RGBLed; struct PmsPower;
 struct RTCManager; struct LogFS; struct NvsManager; struct TFLunaManager;
 
 struct ServiceRefs {
-  RelayManager*    relay   = nullptr;
+  ::RelayManager*  relay   = nullptr;
   SensorManager*   sensor  = nullptr;
   DS18B20U*        ds18b20 = nullptr;
   BME280Manager*   bme     = nullptr;
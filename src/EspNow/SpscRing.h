@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace espnow {
+
+// Fixed-capacity single-producer/single-consumer ring.
+// Producer: acquire() -> fill slot in place -> publish().
+// Consumer: front() -> read slot in place -> pop().
+template<typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N-1)) == 0, "SpscRing depth must be a power of two");
+public:
+  T* acquire(){
+    uint32_t h = head_.load(std::memory_order_relaxed);
+    if(h - tail_.load(std::memory_order_acquire) >= N) return nullptr;
+    return &slots_[h & (N-1)];
+  }
+  void publish(){
+    uint32_t h = head_.load(std::memory_order_relaxed) + 1;
+    head_.store(h, std::memory_order_release);
+    uint32_t d = h - tail_.load(std::memory_order_relaxed);
+    if(d > high_) high_ = d;
+  }
+
+  T* front(){
+    uint32_t t = tail_.load(std::memory_order_relaxed);
+    if(t == head_.load(std::memory_order_acquire)) return nullptr;
+    return &slots_[t & (N-1)];
+  }
+  void pop(){ tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  size_t depth() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  size_t highWater() const { return high_; }
+  static constexpr size_t capacity(){ return N; }
+
+private:
+  T slots_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  volatile uint32_t high_{0};   // written by producer only
+};
+
+} // namespace espnow
@@ -0,0 +1,122 @@
+#include "TimeSync.h"
+#include <cstring>
+#include <esp_heap_caps.h>
+
+namespace espnow {
+
+static int32_t clamp32(int64_t v){ return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : int32_t(v); }
+
+bool TimeSync::onProbe(const uint8_t* body, uint16_t len, int64_t t2, int64_t t3, TimeSyncResp& out){
+  if(len < sizeof(TimeSyncReq)) return false;
+  TimeSyncReq r; std::memcpy(&r, body, sizeof(r));
+  if(!r.seq) return false;
+  if(r.prevSeq && r.prevSeq == pSeq_) sample(pT1_, pT2_, pT3_, r.prevT4);
+  pSeq_ = r.seq; pT1_ = r.t1; pT2_ = t2; pT3_ = t3;
+  portENTER_CRITICAL(&mux_);
+  int64_t off = offsetAt(t3);
+  portEXIT_CRITICAL(&mux_);
+  out = TimeSyncResp{ r.seq, t2, t3, off, skew_, uint8_t(synced_ ? 1 : 0) };
+  return true;
+}
+
+// One exchange: theta = local - network, assuming equal one-way delays. Frames
+// that sat in a queue show up as long round trips and are skipped. Small errors
+// are slewed in by halves; large ones (boot, ICM restart) step the offset.
+// Skew comes from the offset's drift over at least ESPNOW_TSYNC_SKEW_SPAN_MS.
+void TimeSync::sample(int64_t t1, int64_t t2, int64_t t3, int64_t t4){
+  int64_t rtt = (t4 - t1) - (t3 - t2);
+  if(rtt < 0 || rtt > INT32_MAX){ st_.rejected++; return; }
+  uint32_t d = uint32_t(rtt), minD = d;
+  for(uint8_t i = 0; i < nDelays_; ++i) if(delays_[i] < minD) minD = delays_[i];
+  delays_[delayNext_] = d; delayNext_ = uint8_t((delayNext_ + 1) % ESPNOW_TSYNC_WINDOW);
+  if(nDelays_ < ESPNOW_TSYNC_WINDOW) nDelays_++;
+  st_.lastDelayUs = d;
+  if(d > 2 * minD + ESPNOW_TSYNC_SLACK_US){ st_.rejected++; return; }
+
+  int64_t theta = ((t2 - t1) + (t3 - t4)) / 2;
+  int64_t at    = t2 + (t3 - t2) / 2;
+  portENTER_CRITICAL(&mux_);
+  int64_t err = synced_ ? theta - offsetAt(at) : 0;
+  if(!synced_ || err > ESPNOW_TSYNC_STEP_US || err < -ESPNOW_TSYNC_STEP_US){
+    off_ = theta; ref_ = at; synced_ = true;
+    anchorAt_ = at; anchorTheta_ = theta;
+    st_.steps++;
+  }else{
+    off_ = offsetAt(at) + err / 2; ref_ = at;
+    int64_t span = at - anchorAt_;
+    if(span >= int64_t(ESPNOW_TSYNC_SKEW_SPAN_MS) * 1000){
+      int32_t meas = clamp32((theta - anchorTheta_) * 1000000000 / span);
+      skew_ = haveSkew_ ? int32_t((int64_t(skew_) + meas) / 2) : meas;
+      haveSkew_ = true;
+      anchorAt_ = at; anchorTheta_ = theta;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  st_.lastErrUs = clamp32(err);
+  st_.samples++;
+}
+
+int64_t TimeSync::toNetwork(int64_t localUs) const {
+  if(!synced_) return localUs;
+  portENTER_CRITICAL(&mux_);
+  int64_t off = offsetAt(localUs);
+  portEXIT_CRITICAL(&mux_);
+  return localUs - off;
+}
+
+TimeSync::~TimeSync(){
+  if(slots_) heap_caps_free(slots_);
+}
+
+int TimeSync::indexOf(const uint8_t mac[6]) const {
+  if(!slots_) return -1;
+  for(int i = 0; i < ESPNOW_TSYNC_SLOTS; ++i)
+    if(slots_[i].seq && std::memcmp(slots_[i].mac, mac, 6) == 0) return i;
+  return -1;
+}
+
+const TimeSync::Slot* TimeSync::find(const uint8_t mac[6]) const {
+  int i = indexOf(mac);
+  return i < 0 ? nullptr : &slots_[i];
+}
+
+// A slot in use holds the t4 its peer needs with the next probe; dropping it
+// restarts that peer's exchange, so only peers gone quiet give theirs up.
+TimeSync::Slot* TimeSync::slot(const uint8_t mac[6], uint32_t nowMs){
+  if(!slots_){
+    slots_ = static_cast<Slot*>(heap_caps_calloc(ESPNOW_TSYNC_SLOTS, sizeof(Slot), MALLOC_CAP_8BIT));
+    if(!slots_) return nullptr;
+  }
+  int i = indexOf(mac);
+  if(i >= 0) return &slots_[i];
+  Slot* s = nullptr;
+  for(int k = 0; k < ESPNOW_TSYNC_SLOTS; ++k){
+    Slot& c = slots_[k];
+    if(!c.seq){ s = &c; break; }
+    if(nowMs - c.lastMs >= ESPNOW_TSYNC_STALE_MS && (!s || (int32_t)(c.lastMs - s->lastMs) < 0)) s = &c;
+  }
+  if(!s) return nullptr;
+  *s = Slot{};
+  std::memcpy(s->mac, mac, 6);
+  return s;
+}
+
+void TimeSync::makeProbe(Slot& s, int64_t t1, uint32_t nowMs, TimeSyncReq& out){
+  s.seq = uint8_t(s.seq == 0xFF ? 1 : s.seq + 1);
+  s.t1 = t1; s.lastMs = nowMs;
+  out = TimeSyncReq{ s.seq, t1, s.ansSeq, s.ansSeq ? s.t4 : 0 };
+}
+
+void TimeSync::onAnswer(const uint8_t mac[6], const TimeSyncResp& r, int64_t t4){
+  int i = indexOf(mac);
+  if(i < 0 || r.seq != slots_[i].seq) return;     // late answer to an older probe
+  Slot& s = slots_[i];
+  s.ansSeq   = r.seq;
+  s.t4       = t4;
+  s.offsetUs = ((r.t2 - s.t1) + (r.t3 - t4)) / 2;
+  int64_t rtt = (t4 - s.t1) - (r.t3 - r.t2);
+  s.delayUs  = rtt < 0 ? 0 : uint32_t(rtt);
+  s.synced   = r.synced != 0;
+}
+
+} // namespace espnow
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include "../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// TIME_SYNC: NTP-style exchange the ICM runs against every peer. Timestamps are
+// esp_timer microseconds; the ICM's esp_timer is the network clock.
+//   request : TimeSyncReq  (t1 = ICM send time; prevSeq/prevT4 = when the ICM
+//             received the answer to the previous exchange, 0 = none)
+//   response: TimeSyncResp (t2 = node receive, t3 = node send, and the node's
+//             current estimate for the ICM's diagnostics)
+// With prevT4 the node holds all four timestamps of that exchange and runs the
+// estimator itself, so one frame each way per period is enough.
+#pragma pack(push,1)
+struct TimeSyncReq {
+  uint8_t  seq;          // 1..255
+  int64_t  t1;
+  uint8_t  prevSeq;
+  int64_t  prevT4;
+};
+
+struct TimeSyncResp {
+  uint8_t  seq;
+  int64_t  t2;
+  int64_t  t3;
+  int64_t  offsetUs;     // local - network at t3
+  int32_t  skewPpb;      // local clock rate error
+  uint8_t  synced;
+};
+#pragma pack(pop)
+
+// Both sides of TIME_SYNC. Node: offset/skew estimate against the ICM and the
+// network clock built on it. ICM: per-peer exchange state (the last answer's
+// t4) and its own view of each peer's offset. The core does the I/O.
+class TimeSync {
+public:
+  struct Stats {
+    uint32_t samples;     // complete exchanges accepted
+    uint32_t rejected;    // exchanges dropped by the delay filter
+    uint32_t steps;       // offset set outright instead of slewed
+    uint32_t lastDelayUs; // round trip minus the node's turnaround
+    int32_t  lastErrUs;   // last sample against the prediction
+  };
+
+  // ICM side: one slot per peer probed.
+  struct Slot {
+    uint8_t  mac[6];
+    uint8_t  seq;         // last probe sent, 0 = slot free
+    uint8_t  ansSeq;      // last probe answered
+    int64_t  t1;          // when seq went out
+    int64_t  t4;          // when ansSeq's answer arrived
+    int64_t  offsetUs;    // ICM's estimate of the peer, local - network
+    uint32_t delayUs;
+    uint32_t lastMs;      // last probe sent
+    bool     synced;      // as reported by the peer
+  };
+
+  // Node side. t2 = receive stamp of the request, t3 = stamp for the answer.
+  bool onProbe(const uint8_t* body, uint16_t len, int64_t t2, int64_t t3, TimeSyncResp& out);
+  int64_t toNetwork(int64_t localUs) const;
+  bool    synced() const { return synced_; }
+  int32_t skewPpb() const { return skew_; }
+  Stats   stats() const { return st_; }
+
+  // ICM side. slot() claims a free slot when mac is new, or one not probed for
+  // ESPNOW_TSYNC_STALE_MS; never one mid-exchange. nullptr when none is left.
+  ~TimeSync();
+  Slot*       slot(const uint8_t mac[6], uint32_t nowMs);
+  const Slot* find(const uint8_t mac[6]) const;
+  void        makeProbe(Slot& s, int64_t t1, uint32_t nowMs, TimeSyncReq& out);
+  void        onAnswer(const uint8_t mac[6], const TimeSyncResp& r, int64_t t4);
+
+private:
+  void sample(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+  int64_t offsetAt(int64_t localUs) const { return off_ + skew_ * (localUs - ref_) / 1000000000; }
+
+  // Node estimate: local - network = off_ + skew_ * (local - ref_).
+  int64_t  off_{0};
+  int64_t  ref_{0};
+  int32_t  skew_{0};
+  bool     synced_{false};
+  bool     haveSkew_{false};
+  int64_t  anchorAt_{0}, anchorTheta_{0};      // start of the skew baseline
+  uint32_t delays_[ESPNOW_TSYNC_WINDOW]{};     // recent round trips, for the filter
+  uint8_t  nDelays_{0}, delayNext_{0};
+  uint8_t  pSeq_{0};                           // exchange awaiting its t4
+  int64_t  pT1_{0}, pT2_{0}, pT3_{0};
+  Stats    st_{};
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+
+  Slot*    slots_{nullptr};                    // ESPNOW_TSYNC_SLOTS, ICM only
+  int      indexOf(const uint8_t mac[6]) const;
+};
+
+} // namespace espnow
@@ -9,70 +9,445 @@ static constexpr uint8_t T_ROLE         = 0x02;
 static constexpr uint8_t T_NEIGHBORS    = 0x03;
 static constexpr uint8_t T_ROLE_PARAMS  = 0x04;
 static constexpr uint8_t T_EMU_COUNT    = 0x05;
+static constexpr uint8_t T_GROUPS       = 0x06;
+static constexpr uint8_t T_VERSION      = 0x07;   // TopoStamp, always last
+static constexpr uint8_t T_FORMAT       = 0x08;   // u8 TLV version; first record, v2 and up only
+// Delta records
+static constexpr uint8_t T_DELTA_BASE   = 0x10;   // TopoStamp the delta applies to
+static constexpr uint8_t T_DELTA_HASH   = 0x11;   // u32 hash of the result
+static constexpr uint8_t T_NB_SPLICE    = 0x12;   // u16 at, u16 remove, mac6 x n
+static constexpr uint8_t T_RP_SPLICE    = 0x13;   // u16 at, u16 remove, bytes
 
 static Topology g_localTopo;
 
-static inline void putU16(std::vector<uint8_t>& v, uint16_t x){
-  v.push_back(uint8_t(x & 0xFF)); v.push_back(uint8_t((x>>8)&0xFF));
+static inline uint16_t getU16(const uint8_t* p){ return uint16_t(p[0] | (uint16_t(p[1])<<8)); }
+static inline uint32_t getU32(const uint8_t* p){ return uint32_t(getU16(p)) | (uint32_t(getU16(p+2))<<16); }
+
+static inline size_t lenBytes(uint16_t len){ return len < 0xFF ? 1 : 3; }
+static inline size_t recBytes(uint16_t len){ return 1 + lenBytes(len) + len; }
+
+// LEB128, used for v2 record lengths and MAC codes.
+static inline size_t putVar(uint8_t* b, uint32_t v){
+  size_t n = 0;
+  do { uint8_t x = v & 0x7F; v >>= 7; b[n++] = uint8_t(x | (v ? 0x80 : 0)); } while(v);
+  return n;
+}
+static inline bool getVar(const uint8_t*& p, const uint8_t* e, uint32_t& v){
+  v = 0;
+  for(int sh=0; sh<35; sh+=7){
+    if(p >= e) return false;
+    uint8_t b = *p++;
+    v |= uint32_t(b & 0x7F) << sh;
+    if(!(b & 0x80)) return true;
+  }
+  return false;
 }
 
-static inline uint16_t getU16(const uint8_t* p){ return uint16_t(p[0] | (uint16_t(p[1])<<8)); }
+// ---- v2 MAC lists ----------------------------------------------------------
+// Value of a v2 T_NEIGHBORS record: {u8 n, n x OUI[3]} then one varint per MAC,
+// zigzag(suffix - previous suffix) * (n+1) + dictionary index. Index n means
+// "not in the dictionary": the six bytes follow the varint literally.
+static constexpr uint8_t MAC_DICT_MAX = 8;
 
-bool topoEncode(const Topology& t, std::vector<uint8_t>& out){
-  out.clear();
-  // ROLE
-  out.push_back(T_ROLE); out.push_back(1); out.push_back(t.role);
-  // TOKEN
-  out.push_back(T_DEVICE_TOKEN); out.push_back(32); for(int i=0;i<32;++i) out.push_back(uint8_t(t.token[i]));
-  // NEIGHBORS
-  if(!t.neighbors.empty()){
-    out.push_back(T_NEIGHBORS);
-    uint16_t len = (uint16_t)(t.neighbors.size()*6);
-    out.push_back(uint8_t(len & 0xFF)); out.push_back(uint8_t((len>>8)&0xFF));
-    for(auto& m: t.neighbors) for(int i=0;i<6;++i) out.push_back(m[i]);
+struct MacDict {
+  uint8_t n = 0;
+  uint8_t oui[MAC_DICT_MAX][3];
+  uint8_t find(const uint8_t* m) const {
+    for(uint8_t i=0;i<n;++i) if(std::memcmp(oui[i], m, 3) == 0) return i;
+    return n;
   }
-  // ROLE_PARAMS
-  if(!t.roleParams.empty()){
-    out.push_back(T_ROLE_PARAMS);
-    uint16_t len = (uint16_t)t.roleParams.size();
-    out.push_back(uint8_t(len & 0xFF)); out.push_back(uint8_t((len>>8)&0xFF));
-    out.insert(out.end(), t.roleParams.begin(), t.roleParams.end());
+};
+
+static inline uint32_t suffix24(const uint8_t* m){ return uint32_t(m[3])<<16 | uint32_t(m[4])<<8 | m[5]; }
+static inline uint32_t zigzag24(uint32_t cur, uint32_t prev){
+  int32_t d = int32_t((cur - prev) & 0xFFFFFF);
+  if(d >= 0x800000) d -= 0x1000000;
+  return (uint32_t(d) << 1) ^ uint32_t(d >> 31);
+}
+
+// OUIs used by two or more MACs, first seen first.
+static void buildDict(const uint8_t* macs, uint16_t count, MacDict& d){
+  for(uint16_t i=0;i<count && d.n<MAC_DICT_MAX;++i){
+    const uint8_t* m = macs + 6u*i;
+    if(d.find(m) != d.n) continue;
+    for(uint16_t j=i+1;j<count;++j)
+      if(std::memcmp(macs + 6u*j, m, 3) == 0){ std::memcpy(d.oui[d.n++], m, 3); break; }
   }
-  // EMU_COUNT
-  if(t.emuCount){
-    out.push_back(T_EMU_COUNT); out.push_back(1); out.push_back(t.emuCount);
+}
+
+// Encoded size (out == nullptr) or the encoding itself.
+static size_t packMacs(const uint8_t* macs, uint16_t count, const MacDict& d, uint8_t* out){
+  uint8_t tmp[5];
+  size_t n = 1 + 3u*d.n;
+  if(out){ out[0] = d.n; std::memcpy(out + 1, d.oui, 3u*d.n); }
+  uint32_t prev = 0;
+  for(uint16_t i=0;i<count;++i){
+    const uint8_t* m = macs + 6u*i;
+    uint8_t idx = d.find(m);
+    uint32_t code = (idx == d.n ? 0 : zigzag24(suffix24(m), prev)) * (d.n + 1u) + idx;
+    size_t k = putVar(out ? out + n : tmp, code);
+    n += k;
+    if(idx == d.n){ if(out) std::memcpy(out + n, m, 6); n += 6; }
+    prev = suffix24(m);
+  }
+  return n;
+}
+
+// Calls emit(mac6) per MAC; false on a malformed list.
+template<typename F>
+static bool unpackMacs(const uint8_t* p, uint16_t L, F&& emit){
+  const uint8_t* e = p + L;
+  if(L < 1 || p[0] > MAC_DICT_MAX || L < 1u + 3u*p[0]) return false;
+  uint8_t n = p[0];
+  const uint8_t* oui = p + 1;
+  p += 1 + 3u*n;
+  uint32_t prev = 0;
+  uint8_t m[6];
+  while(p < e){
+    uint32_t code;
+    if(!getVar(p, e, code)) return false;
+    uint32_t idx = code % (n + 1u), zz = code / (n + 1u);
+    if(idx == n){
+      if(e - p < 6) return false;
+      std::memcpy(m, p, 6); p += 6;
+    }else{
+      uint32_t s = (prev + ((zz >> 1) ^ (0u - (zz & 1)))) & 0xFFFFFF;
+      std::memcpy(m, oui + 3u*idx, 3);
+      m[3] = uint8_t(s >> 16); m[4] = uint8_t(s >> 8); m[5] = uint8_t(s);
+    }
+    prev = suffix24(m);
+    emit(m);
   }
   return true;
 }
 
-bool topoDecode(const uint8_t* tlv, uint16_t len, Topology& out){
-  out = Topology{};
+// ---- writer ----------------------------------------------------------------
+TopoWriter::TopoWriter(uint8_t* buf, size_t cap, uint8_t version)
+  : p_(buf), n_(0), cap_(cap), ok_(true), v2_(version >= TOPO_TLV_V2) {
+  if(v2_){ uint8_t h[3] = { T_FORMAT, 1, TOPO_TLV_V2 }; put(h, 3); }
+}
+
+bool TopoWriter::put(const void* data, size_t len){
+  if(!ok_ || len > cap_ - n_){ ok_ = false; return false; }
+  if(len && p_) std::memcpy(p_ + n_, data, len);
+  n_ += len;
+  return true;
+}
+
+bool TopoWriter::open(uint8_t type, uint16_t len){
+  uint8_t h[4] = { type, uint8_t(len), 0, 0 };
+  if(v2_) return put(h, 1 + putVar(h + 1, len));
+  if(len >= 0xFF){ h[1] = 0xFF; h[2] = uint8_t(len); h[3] = uint8_t(len>>8); }
+  return put(h, 1 + lenBytes(len));
+}
+
+bool TopoWriter::role(uint8_t r){ return open(T_ROLE, 1) && put(&r, 1); }
+bool TopoWriter::token(const char tok[32]){ return open(T_DEVICE_TOKEN, 32) && put(tok, 32); }
+bool TopoWriter::neighbors(const uint8_t* macs, uint16_t count){
+  if(!count) return true;
+  if(!v2_) return open(T_NEIGHBORS, (uint16_t)(count*6)) && put(macs, count*6u);
+  MacDict d;
+  buildDict(macs, count, d);
+  size_t n = packMacs(macs, count, d, nullptr);
+  if(n > 0xFFFF || !open(T_NEIGHBORS, (uint16_t)n)) return false;
+  if(n > cap_ - n_ || !ok_){ ok_ = false; return false; }
+  if(p_) packMacs(macs, count, d, p_ + n_);
+  n_ += n;
+  return true;
+}
+bool TopoWriter::roleParams(const uint8_t* p, uint16_t len){ return !len || (open(T_ROLE_PARAMS, len) && put(p, len)); }
+bool TopoWriter::emuCount(uint8_t n){ return !n || (open(T_EMU_COUNT, 1) && put(&n, 1)); }
+bool TopoWriter::groups(const uint8_t* g, uint8_t n){ return !n || n == 0xFF || (open(T_GROUPS, n) && put(g, n)); }
+static inline void stampBytes(const TopoStamp& s, uint8_t b[8]){
+  for(int i=0;i<4;++i){ b[i] = uint8_t(s.version >> (8*i)); b[4+i] = uint8_t(s.hash >> (8*i)); }
+}
+
+bool TopoWriter::stamp(const TopoStamp& s){
+  uint8_t b[8];
+  stampBytes(s, b);
+  return open(T_VERSION, 8) && put(b, 8);
+}
+
+// ---- encode ----------------------------------------------------------------
+static_assert(sizeof(std::array<uint8_t,6>) == 6, "neighbour MACs must pack to 6 bytes");
+
+// A writer over no buffer only counts.
+size_t topoEncodedSize(const Topology& t, uint8_t version){
+  return topoEncode(t, nullptr, SIZE_MAX, version);
+}
+
+size_t topoEncode(const Topology& t, uint8_t* out, size_t cap, uint8_t version){
+  TopoWriter w(out, cap, version);
+  w.role(t.role);
+  w.token(t.token);
+  w.neighbors(t.neighbors.empty() ? nullptr : t.neighbors[0].data(), (uint16_t)t.neighbors.size());
+  w.roleParams(t.roleParams.data(), (uint16_t)t.roleParams.size());
+  w.emuCount(t.emuCount);
+  if(t.groups.size() < 0xFF) w.groups(t.groups.data(), (uint8_t)t.groups.size());
+  return w.ok() ? w.size() : 0;
+}
+
+size_t topoEncode(const TopologyFixed& t, uint8_t* out, size_t cap, uint8_t version){
+  TopoWriter w(out, cap, version);
+  w.role(t.role);
+  w.token(t.token);
+  w.neighbors(&t.neighbors[0][0], t.neighborCount);
+  w.roleParams(t.roleParams, t.roleParamsLen);
+  w.emuCount(t.emuCount);
+  w.groups(t.groups, t.groupCount);
+  return w.ok() ? w.size() : 0;
+}
+
+bool topoEncode(const Topology& t, std::vector<uint8_t>& out, uint8_t version){
+  out.resize(topoEncodedSize(t, version));
+  return topoEncode(t, out.data(), out.size(), version) == out.size();
+}
+
+// ---- decode ----------------------------------------------------------------
+// v1 has no header. A v2 blob opens with a v1-framed T_FORMAT record, so older
+// decoders skip it, but everything after it has varint lengths.
+uint8_t topoTlvVersion(const uint8_t* tlv, uint16_t len){
+  return (len >= 3 && tlv[0] == T_FORMAT && tlv[1] == 1) ? tlv[2] : uint8_t(TOPO_TLV_V1);
+}
+
+// Calls fn(type, value, len) per record; false on a truncated record or an
+// unknown TLV version.
+template<typename F>
+static bool walk(const uint8_t* tlv, uint16_t len, F&& fn){
   const uint8_t* p = tlv;
   const uint8_t* e = tlv + len;
+  uint8_t ver = topoTlvVersion(tlv, len);
+  if(ver > TOPO_TLV_V2) return false;
+  if(ver == TOPO_TLV_V2) p += 3;
   while(p+2 <= e){
-    uint8_t t = p[0]; uint8_t l = p[1]; p+=2;
-    uint16_t L = l;
-    if(l==0xFF){ if(p+2>e) return false; L = getU16(p); p+=2; }
-    if(p+L>e) return false;
+    uint8_t t = *p++; uint32_t L;
+    if(ver == TOPO_TLV_V2){ if(!getVar(p, e, L) || L > 0xFFFF) return false; }
+    else{ L = *p++; if(L==0xFF){ if(p+2>e) return false; L = getU16(p); p+=2; } }
+    if(L > size_t(e - p)) return false;
+    if(!fn(t, p, (uint16_t)L)) return true;
+    p += L;
+  }
+  return true;
+}
+
+static bool wellFormed(const uint8_t* tlv, uint16_t len){
+  bool v2 = topoTlvVersion(tlv, len) == TOPO_TLV_V2;
+  bool macs = true;
+  return walk(tlv, len, [&](uint8_t t, const uint8_t* p, uint16_t L){
+    if(v2 && t == T_NEIGHBORS) macs = unpackMacs(p, L, [](const uint8_t*){});
+    return macs;
+  }) && macs;
+}
+
+// v2 MACs are rebuilt into a small block and handed out a block at a time.
+static void deliverMacs(const uint8_t* p, uint16_t L, TopoVisitor& v){
+  uint8_t blk[16][6];
+  uint16_t n = 0;
+  unpackMacs(p, L, [&](const uint8_t* m){
+    std::memcpy(blk[n++], m, 6);
+    if(n == 16){ v.neighbors(&blk[0][0], n); n = 0; }
+  });
+  if(n) v.neighbors(&blk[0][0], n);
+}
+
+static void deliver(const uint8_t* tlv, uint16_t len, TopoVisitor& v){
+  bool v2 = topoTlvVersion(tlv, len) == TOPO_TLV_V2;
+  walk(tlv, len, [&v, v2](uint8_t t, const uint8_t* p, uint16_t L){
     switch(t){
-      case T_ROLE: if(L>=1) out.role = p[0]; break;
-      case T_DEVICE_TOKEN: if(L>=32) std::memcpy(out.token, p, 32); break;
-      case T_NEIGHBORS: {
-        out.neighbors.clear();
-        for(uint16_t i=0;i+6<=L;i+=6){ std::array<uint8_t,6> m; std::memcpy(m.data(), p+i, 6); out.neighbors.push_back(m); }
-      } break;
-      case T_ROLE_PARAMS: out.roleParams.assign(p, p+L); break;
-      case T_EMU_COUNT: if(L>=1) out.emuCount = p[0]; break;
+      case T_ROLE:         if(L>=1) v.role(p[0]); break;
+      case T_DEVICE_TOKEN: if(L>=32) v.token(reinterpret_cast<const char*>(p)); break;
+      case T_NEIGHBORS:    if(v2) deliverMacs(p, L, v); else v.neighbors(p, (uint16_t)(L/6)); break;
+      case T_ROLE_PARAMS:  v.roleParams(p, L); break;
+      case T_EMU_COUNT:    if(L>=1) v.emuCount(p[0]); break;
+      case T_GROUPS:       v.groups(p, L); break;
+      case T_VERSION:      if(L>=8) v.stamp(TopoStamp{ getU32(p), getU32(p+4) }); break;
     }
-    p += L;
+    return true;
+  });
+}
+
+bool topoVisit(const uint8_t* tlv, uint16_t len, TopoVisitor& v){
+  if(!wellFormed(tlv, len)) return false;
+  deliver(tlv, len, v);
+  return true;
+}
+
+namespace {
+struct VecSink : TopoVisitor {
+  Topology& t;
+  explicit VecSink(Topology& o) : t(o) {}
+  void role(uint8_t r) override { t.role = r; }
+  void token(const char* tok) override { std::memcpy(t.token, tok, 32); }
+  void neighbors(const uint8_t* m, uint16_t n) override {
+    size_t at = t.neighbors.size();
+    t.neighbors.resize(at + n);
+    std::memcpy(t.neighbors[at].data(), m, n * 6u);
+  }
+  void roleParams(const uint8_t* p, uint16_t n) override { t.roleParams.assign(p, p+n); }
+  void emuCount(uint8_t n) override { t.emuCount = n; }
+  void groups(const uint8_t* g, uint16_t n) override { t.groups.assign(g, g+n); }
+};
+
+struct FixedSink : TopoVisitor {
+  TopologyFixed& t;
+  bool fits = true;
+  explicit FixedSink(TopologyFixed& o) : t(o) {}
+  void role(uint8_t r) override { t.role = r; }
+  void token(const char* tok) override { std::memcpy(t.token, tok, 32); }
+  void neighbors(const uint8_t* m, uint16_t n) override {
+    uint16_t room = (uint16_t)(ESPNOW_TOPO_MAX_NEIGHBORS - t.neighborCount);
+    if(n > room){ fits = false; n = room; }
+    std::memcpy(t.neighbors[t.neighborCount], m, n * 6u); t.neighborCount += n;
   }
+  void roleParams(const uint8_t* p, uint16_t n) override {
+    if(n > sizeof(t.roleParams)){ fits = false; n = sizeof(t.roleParams); }
+    std::memcpy(t.roleParams, p, n); t.roleParamsLen = n;
+  }
+  void emuCount(uint8_t n) override { t.emuCount = n; }
+  void groups(const uint8_t* g, uint16_t n) override {
+    if(n > sizeof(t.groups)){ fits = false; n = sizeof(t.groups); }
+    std::memcpy(t.groups, g, n); t.groupCount = (uint8_t)n;
+  }
+};
+} // namespace
+
+// Both leave `out` untouched when the framing is bad.
+bool topoDecode(const uint8_t* tlv, uint16_t len, Topology& out){
+  if(!wellFormed(tlv, len)) return false;
+  out.role = 0; std::memset(out.token, 0, sizeof(out.token)); out.emuCount = 0;
+  out.neighbors.clear(); out.roleParams.clear(); out.groups.clear();
+  VecSink s(out);
+  deliver(tlv, len, s);
   return true;
 }
 
+bool topoDecode(const uint8_t* tlv, uint16_t len, TopologyFixed& out){
+  if(!wellFormed(tlv, len)) return false;
+  out.role = 0; std::memset(out.token, 0, sizeof(out.token)); out.emuCount = 0;
+  out.neighborCount = 0; out.roleParamsLen = 0; out.groupCount = 0;
+  FixedSink s(out);
+  deliver(tlv, len, s);
+  return s.fits;
+}
+
+uint32_t topoHash(const uint8_t* data, size_t len){
+  uint32_t h = 2166136261u;
+  for(size_t i=0;i<len;++i){ h ^= data[i]; h *= 16777619u; }
+  return h;
+}
+
+void topoAppendStamp(std::vector<uint8_t>& out, const TopoStamp& s){
+  size_t at = out.size();
+  out.resize(at + recBytes(8));
+  TopoWriter(out.data() + at, recBytes(8)).stamp(s);
+}
+
+bool topoFindStamp(const uint8_t* tlv, uint16_t len, TopoStamp& out){
+  bool found = false;
+  bool ok = walk(tlv, len, [&](uint8_t t, const uint8_t* p, uint16_t L){
+    if(t != T_VERSION || L < 8) return true;
+    out.version = getU32(p); out.hash = getU32(p+4); found = true;
+    return false;
+  });
+  return ok && found;
+}
+
+bool topoNotModified(const uint8_t* tlv, uint16_t len){
+  return len == 10 && tlv[0] == T_VERSION && tlv[1] == 8;
+}
+
+// ---- delta -----------------------------------------------------------------
+uint32_t topoHashOf(const Topology& t){
+  std::vector<uint8_t> v;
+  topoEncode(t, v);
+  return topoHash(v.data(), v.size());
+}
+
+// Common prefix/suffix of two sequences; what lies between is the splice.
+template<typename A, typename B>
+static void spliceBounds(const A& a, const B& b, size_t& pre, size_t& suf){
+  size_t n = a.size() < b.size() ? a.size() : b.size();
+  pre = 0; while(pre < n && a[pre] == b[pre]) pre++;
+  suf = 0; while(suf < n - pre && a[a.size()-1-suf] == b[b.size()-1-suf]) suf++;
+}
+
+// Record header and {at, remove}; the caller put()s the inserted bytes after it.
+static bool openSplice(TopoWriter& w, uint8_t type, size_t at, size_t remove, size_t insBytes){
+  if(at > 0xFFFF || remove > 0xFFFF || insBytes > 0xFFFF - 4) return false;
+  uint8_t h[4] = { uint8_t(at), uint8_t(at>>8), uint8_t(remove), uint8_t(remove>>8) };
+  return w.open(type, (uint16_t)(4 + insBytes)) && w.put(h, 4);
+}
+
+size_t topoDiff(const Topology& from, const Topology& to, const TopoStamp& base, uint8_t* out, size_t cap){
+  TopoWriter w(out, cap);
+  uint8_t b[8];
+  stampBytes(base, b);
+  w.open(T_DELTA_BASE, 8); w.put(b, 8);
+  uint32_t h = topoHashOf(to);
+  for(int i=0;i<4;++i) b[i] = uint8_t(h >> (8*i));
+  w.open(T_DELTA_HASH, 4); w.put(b, 4);
+
+  if(from.role != to.role) w.role(to.role);
+  if(std::memcmp(from.token, to.token, 32) != 0) w.token(to.token);
+  if(from.emuCount != to.emuCount){ w.open(T_EMU_COUNT, 1); w.put(&to.emuCount, 1); }
+  if(from.groups != to.groups && to.groups.size() < 0xFF){
+    w.open(T_GROUPS, (uint16_t)to.groups.size()); w.put(to.groups.data(), to.groups.size());
+  }
+
+  size_t pre, suf;
+  spliceBounds(from.neighbors, to.neighbors, pre, suf);
+  size_t rm = from.neighbors.size() - pre - suf, ins = to.neighbors.size() - pre - suf;
+  if(rm || ins){
+    if(!openSplice(w, T_NB_SPLICE, pre, rm, ins*6)) return 0;
+    for(size_t i=0;i<ins;++i) w.put(to.neighbors[pre+i].data(), 6);
+  }
+  spliceBounds(from.roleParams, to.roleParams, pre, suf);
+  rm = from.roleParams.size() - pre - suf; ins = to.roleParams.size() - pre - suf;
+  if(rm || ins){
+    if(!openSplice(w, T_RP_SPLICE, pre, rm, ins)) return 0;
+    w.put(to.roleParams.data() + pre, ins);
+  }
+  return w.ok() ? w.size() : 0;
+}
+
+template<typename V, typename T>
+static bool splice(V& v, const uint8_t* p, uint16_t L, size_t unit){
+  if(L < 4 || (L - 4) % unit) return false;
+  size_t at = getU16(p), rm = getU16(p+2), ins = (L - 4) / unit;
+  if(at > v.size() || rm > v.size() - at) return false;
+  v.erase(v.begin() + at, v.begin() + at + rm);
+  if(!ins) return true;
+  v.insert(v.begin() + at, ins, T{});
+  std::memcpy(&v[at], p + 4, ins * unit);
+  return true;
+}
+
+TopoDeltaStatus topoApplyDelta(Topology& t, const TopoStamp& cur, const uint8_t* d, uint16_t len, uint32_t& resultHash){
+  resultHash = 0;
+  if(!wellFormed(d, len) || len < 10 || d[0] != T_DELTA_BASE || d[1] != 8) return TOPO_DELTA_BAD;
+  uint32_t v = getU32(d+2), h = getU32(d+6);
+  if(!cur.version || h != cur.hash || (v && v != cur.version)) return TOPO_DELTA_RESYNC;
+  bool ok = true;
+  walk(d + 10, (uint16_t)(len - 10), [&](uint8_t type, const uint8_t* p, uint16_t L){
+    switch(type){
+      case T_DELTA_HASH:   if(L>=4) resultHash = getU32(p); break;
+      case T_ROLE:         if(L>=1) t.role = p[0]; break;
+      case T_DEVICE_TOKEN: if(L>=32) std::memcpy(t.token, p, 32); break;
+      case T_EMU_COUNT:    if(L>=1) t.emuCount = p[0]; break;
+      case T_GROUPS:       t.groups.assign(p, p+L); break;
+      case T_NB_SPLICE:    ok = splice<decltype(t.neighbors), std::array<uint8_t,6>>(t.neighbors, p, L, 6); break;
+      case T_RP_SPLICE:    ok = splice<decltype(t.roleParams), uint8_t>(t.roleParams, p, L, 1); break;
+      default:             ok = false; break;   // no silent partial apply of an unknown op
+    }
+    return ok;
+  });
+  return ok ? TOPO_DELTA_OK : TOPO_DELTA_BAD;
+}
+
 // Local store glue
 void setLocalTopology(const Topology& t){ g_localTopo = t; }
 const Topology& getLocalTopology(){ return g_localTopo; }
-bool importLocalTopology(const uint8_t* tlv, uint16_t len){ Topology t; if(!topoDecode(tlv,len,t)) return false; g_localTopo = t; return true; }
+bool importLocalTopology(const uint8_t* tlv, uint16_t len){ return topoDecode(tlv,len,g_localTopo); }
 bool exportLocalTopology(std::vector<uint8_t>& tlvOut){ return topoEncode(g_localTopo, tlvOut); }
 
 } // namespace espnow
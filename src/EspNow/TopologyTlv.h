@@ -1,7 +1,9 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 #include <array>
+#include "../Config/EspNowConfig.h"
 
 namespace espnow {
 
@@ -13,12 +15,146 @@ struct Topology {
   std::vector<std::array<uint8_t,6>> neighbors;
   std::vector<uint8_t> roleParams;
   uint8_t   emuCount = 0;
+  std::vector<uint8_t> groups;         // SET_GROUP ids this node answers to
 };
 
-// TLV encode/decode
-bool topoEncode(const Topology& t, std::vector<uint8_t>& outTLV);
+// Fixed-capacity Topology for the receive path and embedded callers: no heap.
+// Decoding more than fits truncates and reports failure.
+struct TopologyFixed {
+  uint8_t   role = 0;
+  char      token[32] = {0};
+  uint8_t   neighbors[ESPNOW_TOPO_MAX_NEIGHBORS][6];
+  uint16_t  neighborCount = 0;
+  uint8_t   roleParams[ESPNOW_TOPO_MAX_PARAMS];
+  uint16_t  roleParamsLen = 0;
+  uint8_t   emuCount = 0;
+  uint8_t   groups[ESPNOW_TOPO_MAX_GROUPS];
+  uint8_t   groupCount = 0;
+};
+
+// TLV versions. V1 is the original framing (u8 length, 0xFF + u16 escape, raw
+// MACs). V2 opens with a T_FORMAT record and uses varint lengths and a shared-OUI
+// dictionary with delta-coded MAC suffixes; a peer only gets V2 after it asked
+// for it (TopoQuery::tlv) or answered in it. Decoders take either.
+enum : uint8_t { TOPO_TLV_V1 = 1, TOPO_TLV_V2 = 2 };
+uint8_t topoTlvVersion(const uint8_t* tlv, uint16_t len);
+
+// TLV encode/decode. The vector forms keep the capacity `out` already has, so
+// decoding into the same Topology again does not allocate.
+bool topoEncode(const Topology& t, std::vector<uint8_t>& outTLV, uint8_t version = TOPO_TLV_V1);
 bool topoDecode(const uint8_t* tlv, uint16_t len, Topology& out);
 
+// Streaming forms over caller buffers. Encoders return the bytes written, or 0
+// when `cap` is too small; topoEncodedSize() gives the exact size beforehand.
+size_t topoEncodedSize(const Topology& t, uint8_t version = TOPO_TLV_V1);
+size_t topoEncode(const Topology& t, uint8_t* out, size_t cap, uint8_t version = TOPO_TLV_V1);
+size_t topoEncode(const TopologyFixed& t, uint8_t* out, size_t cap, uint8_t version = TOPO_TLV_V1);
+bool   topoDecode(const uint8_t* tlv, uint16_t len, TopologyFixed& out);
+
+// Identity of an encoded topology. GET_TOPOLOGY answers end with a T_VERSION
+// record carrying it; version counts local changes since boot, hash is FNV-1a
+// over the records before it.
+struct TopoStamp {
+  uint32_t version;
+  uint32_t hash;
+};
+uint32_t topoHash(const uint8_t* data, size_t len);
+void     topoAppendStamp(std::vector<uint8_t>& tlv, const TopoStamp& s);
+bool     topoFindStamp(const uint8_t* tlv, uint16_t len, TopoStamp& out);
+// A reply holding nothing but the stamp: the caller's copy is current.
+bool     topoNotModified(const uint8_t* tlv, uint16_t len);
+
+// GET_TOPOLOGY request body (optional): the stamp of the copy the caller holds,
+// then optionally the highest TLV version it decodes (absent = V1).
+#pragma pack(push,1)
+struct TopoQuery {
+  uint32_t version;
+  uint32_t hash;
+  uint8_t  tlv;
+};
+#pragma pack(pop)
+
+// Writes TLV records into a caller buffer. Every call fails (and latches !ok())
+// once the buffer is full; nothing past cap is ever touched. A null buffer only
+// counts. In V2 the T_FORMAT header is written first.
+class TopoWriter {
+public:
+  TopoWriter(uint8_t* buf, size_t cap, uint8_t version = TOPO_TLV_V1);
+
+  bool role(uint8_t r);
+  bool token(const char tok[32]);
+  bool neighbors(const uint8_t* macs, uint16_t count);   // count * 6 bytes, packed
+  bool roleParams(const uint8_t* p, uint16_t len);
+  bool emuCount(uint8_t n);
+  bool groups(const uint8_t* g, uint8_t n);
+  bool stamp(const TopoStamp& s);
+
+  // Raw record, for callers streaming a value in pieces: open() the header, then
+  // put() exactly `len` bytes.
+  bool open(uint8_t type, uint16_t len);
+  bool put(const void* data, size_t len);
+
+  size_t size() const { return n_; }
+  bool   ok() const { return ok_; }
+
+private:
+  uint8_t* p_;
+  size_t   n_;
+  size_t   cap_;
+  bool     ok_;
+  bool     v2_;
+};
+
+// Decoder callbacks. Neighbours come one MAC at a time and role params as a slice,
+// both pointing into the TLV itself (valid only during the call). Sinks that
+// copy the list whole can override neighbors() instead; a V2 list arrives in
+// several blocks, in order.
+struct TopoVisitor {
+  virtual ~TopoVisitor() = default;
+  virtual void role(uint8_t r){ (void)r; }
+  virtual void token(const char* tok32){ (void)tok32; }
+  virtual void neighbor(const uint8_t* mac6){ (void)mac6; }
+  virtual void neighbors(const uint8_t* macs, uint16_t count){ for(uint16_t i=0;i<count;++i) neighbor(macs + 6u*i); }
+  virtual void roleParams(const uint8_t* p, uint16_t len){ (void)p; (void)len; }
+  virtual void emuCount(uint8_t n){ (void)n; }
+  virtual void groups(const uint8_t* g, uint16_t n){ (void)g; (void)n; }
+  virtual void stamp(const TopoStamp& s){ (void)s; }
+};
+
+// Checks the framing first, so a malformed TLV is rejected before any callback.
+bool topoVisit(const uint8_t* tlv, uint16_t len, TopoVisitor& v);
+
+// Topology deltas (PUSH_TOPO_DELTA). Same TLV framing; a delta names the stamp
+// it applies to, optionally the hash of the result, then only what changed:
+// role/token/emu count/groups records replace the field, and splice records
+// remove `remove` entries at `at` and insert the rest, which covers adding,
+// dropping and replacing neighbours or role-param bytes. A base version of 0
+// matches on the hash alone, so the ICM can delta right after a full push.
+enum TopoDeltaStatus : uint8_t {
+  TOPO_DELTA_OK     = 0,
+  TOPO_DELTA_RESYNC = 1,   // base stamp or result hash differs: send the full TLV
+  TOPO_DELTA_BAD    = 2,   // malformed, or a splice out of range
+};
+
+#pragma pack(push,1)
+struct TopoDeltaResp {
+  uint8_t  status;         // TopoDeltaStatus
+  uint32_t version;        // stamp the node holds afterwards
+  uint32_t hash;
+};
+#pragma pack(pop)
+
+uint32_t topoHashOf(const Topology& t);   // hash the stamp of `t` would carry
+
+// Smallest delta turning `from` (stamped `base`) into `to`: one splice per list
+// around the common prefix/suffix. Returns 0 if it does not fit `cap`.
+size_t topoDiff(const Topology& from, const Topology& to, const TopoStamp& base, uint8_t* out, size_t cap);
+
+// Applies `delta` to `t` if its base matches `cur`. `t` is left half-edited on
+// failure, so pass a copy. resultHash is the hash the sender expects (0 = none).
+TopoDeltaStatus topoApplyDelta(Topology& t, const TopoStamp& cur, const uint8_t* delta, uint16_t len,
+                               uint32_t& resultHash);
+
 // Local store accessors (defined in EspNowCore.cpp)
 void setLocalTopology(const Topology& t);
 const Topology& getLocalTopology();
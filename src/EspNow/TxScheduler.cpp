@@ -0,0 +1,177 @@
+#include "TxScheduler.h"
+#include "Opcodes.h"
+#include "Frame.h"
+#include <cstring>
+
+namespace espnow {
+
+enum : uint8_t { TF_FREE=0, TF_BUILDING=1, TF_QUEUED=2, TF_FLIGHT=3 };
+
+TxPrio txPrioFor(uint8_t type, uint8_t flags){
+  if(isResponse(flags)) return type == GET_LOGS ? TX_LOG : TX_RESPONSE;
+  switch(type){
+    case SET_RELAY:
+    case SET_GROUP:
+    case SET_RELAY_AT:
+    case SILENCE_OUTPUTS:
+    case SET_POWER_GROUPS:
+    case TIME_SYNC:        return TX_ACTUATION;   // queueing skews t1
+    case GET_LOGS:
+    case FW_BEGIN:
+    case FW_CHUNK:
+    case FW_STATUS:                               // FIFO behind the chunks it asks about
+    case FW_COMMIT:        return TX_LOG;
+    default:               return TX_TELEMETRY;
+  }
+}
+
+TxScheduler::TxScheduler(){
+  for(auto& f : pool_){ f.state = TF_FREE; f.next = -1; }
+  for(int p=0;p<TX_PRIO_COUNT;++p){ laneHead_[p] = laneTail_[p] = -1; laneDepth_[p] = 0; }
+}
+
+TxFrame* TxScheduler::alloc(){
+  TxFrame* out = nullptr;
+  portENTER_CRITICAL(&mux_);
+  for(auto& f : pool_) if(f.state == TF_FREE){ f.state = TF_BUILDING; f.next = -1; out = &f; break; }
+  if(!out) st_.poolFull++;
+  portEXIT_CRITICAL(&mux_);
+  return out;
+}
+
+void TxScheduler::release(TxFrame* f){
+  if(!f) return;
+  portENTER_CRITICAL(&mux_);
+  f->state = TF_FREE;
+  portEXIT_CRITICAL(&mux_);
+}
+
+void TxScheduler::enqueue(TxFrame* f, TxPrio p){
+  int16_t i = indexOf(f);
+  portENTER_CRITICAL(&mux_);
+  f->prio = p; f->state = TF_QUEUED; f->next = -1;
+  if(laneTail_[p] >= 0) pool_[laneTail_[p]].next = i; else laneHead_[p] = i;
+  laneTail_[p] = i;
+  laneDepth_[p]++;
+  st_.queued++;
+  portEXIT_CRITICAL(&mux_);
+}
+
+uint8_t TxScheduler::inFlightFor(const uint8_t mac[6]) const {
+  uint8_t n = 0;
+  for(int16_t i = flightHead_; i >= 0; i = pool_[i].next) if(std::memcmp(pool_[i].mac, mac, 6) == 0) n++;
+  return n;
+}
+
+TxFrame* TxScheduler::next(uint32_t nowMs){
+  TxFrame* out = nullptr;
+  portENTER_CRITICAL(&mux_);
+  if(inFlight_ < ESPNOW_TX_MAX_INFLIGHT){
+    for(int p = 0; p < TX_PRIO_COUNT && !out; ++p){
+      // Skip frames whose peer is at its budget so one slow peer can't block the lane.
+      int16_t prev = -1;
+      for(int16_t i = laneHead_[p]; i >= 0; prev = i, i = pool_[i].next){
+        if(inFlightFor(pool_[i].mac) >= ESPNOW_TX_INFLIGHT_PER_PEER) continue;
+        if(prev >= 0) pool_[prev].next = pool_[i].next; else laneHead_[p] = pool_[i].next;
+        if(laneTail_[p] == i) laneTail_[p] = prev;
+        laneDepth_[p]--;
+        out = &pool_[i];
+        break;
+      }
+    }
+    if(out){
+      int16_t i = indexOf(out);
+      out->state = TF_FLIGHT; out->next = -1; out->sentMs = nowMs;
+      if(flightTail_ >= 0) pool_[flightTail_].next = i; else flightHead_ = i;
+      flightTail_ = i;
+      inFlight_++;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  return out;
+}
+
+void TxScheduler::unlinkFlight(int16_t i){
+  int16_t prev = -1;
+  for(int16_t j = flightHead_; j >= 0; prev = j, j = pool_[j].next){
+    if(j != i) continue;
+    if(prev >= 0) pool_[prev].next = pool_[j].next; else flightHead_ = pool_[j].next;
+    if(flightTail_ == j) flightTail_ = prev;
+    pool_[j].next = -1;
+    inFlight_--;
+    return;
+  }
+}
+
+void TxScheduler::requeueFront(TxFrame* f){
+  int16_t i = indexOf(f);
+  portENTER_CRITICAL(&mux_);
+  unlinkFlight(i);
+  f->state = TF_QUEUED;
+  f->next = laneHead_[f->prio];
+  laneHead_[f->prio] = i;
+  if(laneTail_[f->prio] < 0) laneTail_[f->prio] = i;
+  laneDepth_[f->prio]++;
+  portEXIT_CRITICAL(&mux_);
+}
+
+TxFrame* TxScheduler::complete(const uint8_t mac[6], uint32_t ord){
+  TxFrame* out = nullptr;
+  portENTER_CRITICAL(&mux_);
+  for(int16_t i = flightHead_; i >= 0; i = pool_[i].next){
+    if(std::memcmp(pool_[i].mac, mac, 6) != 0) continue;
+    if((int32_t)(pool_[i].tag - ord) > 0){ st_.stale++; break; }
+    unlinkFlight(i);
+    out = &pool_[i];
+    break;
+  }
+  portEXIT_CRITICAL(&mux_);
+  return out;
+}
+
+TxFrame* TxScheduler::expired(uint32_t nowMs){
+  TxFrame* out = nullptr;
+  portENTER_CRITICAL(&mux_);
+  if(flightHead_ >= 0 && (uint32_t)(nowMs - pool_[flightHead_].sentMs) > ESPNOW_TX_DONE_TIMEOUT_MS){
+    int16_t i = flightHead_;
+    unlinkFlight(i);
+    out = &pool_[i];
+  }
+  portEXIT_CRITICAL(&mux_);
+  return out;
+}
+
+void TxScheduler::finish(TxFrame* f, bool ok){
+  portENTER_CRITICAL(&mux_);
+  unlinkFlight(indexOf(f));     // no-op when complete()/expired() already did it
+  if(ok) st_.acked++; else st_.nacked++;
+  f->state = TF_FREE;
+  portEXIT_CRITICAL(&mux_);
+}
+
+bool TxScheduler::hasQueued() const {
+  bool any = false;
+  portENTER_CRITICAL(&mux_);
+  for(int p=0;p<TX_PRIO_COUNT;++p) if(laneHead_[p] >= 0){ any = true; break; }
+  portEXIT_CRITICAL(&mux_);
+  return any;
+}
+
+uint16_t TxScheduler::freeFrames() const {
+  uint16_t n = 0;
+  portENTER_CRITICAL(&mux_);
+  for(auto& f : pool_) if(f.state == TF_FREE) n++;
+  portEXIT_CRITICAL(&mux_);
+  return n;
+}
+
+TxScheduler::Stats TxScheduler::stats() const {
+  portENTER_CRITICAL(&mux_);
+  Stats s = st_;
+  s.inFlight = inFlight_;
+  for(int p=0;p<TX_PRIO_COUNT;++p) s.laneDepth[p] = laneDepth_[p];
+  portEXIT_CRITICAL(&mux_);
+  return s;
+}
+
+} // namespace espnow
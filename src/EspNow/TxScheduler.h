@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include "../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Lane order is service order: a lower value always goes out first.
+enum TxPrio : uint8_t { TX_ACTUATION=0, TX_RESPONSE=1, TX_TELEMETRY=2, TX_LOG=3, TX_PRIO_COUNT=4 };
+
+TxPrio txPrioFor(uint8_t type, uint8_t flags);
+
+struct TxFrame {
+  uint8_t  mac[6];
+  uint8_t  prio;
+  uint8_t  state;       // internal: free / building / queued / in flight
+  int16_t  next;        // internal: lane or in-flight link
+  uint16_t len;         // bytes in buf (header included)
+  uint32_t sentMs;
+  uint32_t tag;         // send ordinal, matched against the completion's
+  uint8_t  buf[ESP_NOW_MAX_DATA_LEN];
+};
+
+class TxScheduler {
+public:
+  struct Stats {
+    uint32_t queued;
+    uint32_t acked;
+    uint32_t nacked;
+    uint32_t poolFull;
+    uint32_t stale;       // completions for frames already aged out
+    uint16_t inFlight;
+    uint16_t laneDepth[TX_PRIO_COUNT];
+  };
+
+  TxScheduler();
+
+  TxFrame* alloc();                        // any task; nullptr when the pool is exhausted
+  void     release(TxFrame* f);            // give back an unqueued frame
+  void     enqueue(TxFrame* f, TxPrio p);  // any task
+
+  // Service task only.
+  TxFrame* next(uint32_t nowMs);           // next sendable frame, moved to in-flight
+  void     requeueFront(TxFrame* f);       // driver refused it for lack of memory; retry later
+  // Oldest in-flight frame for mac, or nullptr. ord is the completion's send
+  // ordinal: a frame tagged later than it means this completion belonged to
+  // one expired() already aged out, so it is dropped instead of matched.
+  TxFrame* complete(const uint8_t mac[6], uint32_t ord);
+  TxFrame* expired(uint32_t nowMs);        // in-flight frame whose completion never came
+  void     finish(TxFrame* f, bool ok);    // account + return to pool (unlinks if still in flight)
+
+  bool     hasInFlight() const { return flightHead_ >= 0; }
+  bool     hasQueued() const;
+  uint16_t freeFrames() const;
+  Stats    stats() const;
+
+private:
+  int16_t  indexOf(const TxFrame* f) const { return (int16_t)(f - pool_); }
+  uint8_t  inFlightFor(const uint8_t mac[6]) const;
+  void     unlinkFlight(int16_t i);
+
+  TxFrame  pool_[ESPNOW_TX_POOL];
+  int16_t  laneHead_[TX_PRIO_COUNT];
+  int16_t  laneTail_[TX_PRIO_COUNT];
+  uint16_t laneDepth_[TX_PRIO_COUNT];
+  int16_t  flightHead_{-1};
+  int16_t  flightTail_{-1};
+  uint16_t inFlight_{0};
+  Stats    st_{};
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+} // namespace espnow
@@ -0,0 +1,88 @@
+#include "OpTable.h"
+#include "CommonOps.h"
+#include "../EspNowCore.h"
+#include <cstring>
+
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/DS18B20U.h")
+  #include "../../Peripheral/DS18B20U.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/CoolingManager.h")
+  #include "../../Peripheral/CoolingManager.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/BuzzerManager.h")
+  #include "../../Peripheral/BuzzerManager.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/RGBLed.h")
+  #include "../../Peripheral/RGBLed.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/RTCManager.h")
+  #include "../../Peripheral/RTCManager.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/LogFS.h")
+  #include "../../Peripheral/LogFS.h"
+#endif
+
+// The glue probes are resolved once, here, for every role.
+namespace espnow { namespace ops {
+
+bool getTemp(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  float c=0;
+  if(S && S->ds18b20) glue::TempReader<DS18B20U>::read(S->ds18b20, c);
+  std::memcpy(out.out, &c, sizeof(c)); out.out_len = sizeof(c); return true;
+}
+
+bool getTime(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  uint32_t t=0; if(S && S->rtc) glue::RtcGet<RTCManager>::get(S->rtc, t);
+  std::memcpy(out.out,&t,sizeof(t)); out.out_len=sizeof(t); return true;
+}
+
+bool setTime(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  uint32_t t; std::memcpy(&t, in.payload, 4);
+  out.out_len = 0;
+  return S && S->rtc && glue::RtcSet<RTCManager>::set(S->rtc, t);
+}
+
+bool getFanMode(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  uint8_t m=0; if(S && S->cooling) glue::CoolingGet<CoolingManager>::get(S->cooling, m);
+  out.out[0]=m; out.out_len=1; return true;
+}
+
+bool setFanMode(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  out.out_len=0;
+  return S && S->cooling && glue::CoolingSet<CoolingManager>::set(S->cooling, in.payload[0]);
+}
+
+bool buzzPing(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  out.out_len=0;
+  return S && S->buzzer && glue::BuzzerPing<BuzzerManager>::go(S->buzzer);
+}
+
+bool ledPing(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  out.out_len=0;
+  return S && S->rgb && glue::LedPing<RGBLed>::go(S->rgb);
+}
+
+bool getLogs(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  if(!S || !S->logs) return false;
+  LogsReq r{}; std::memcpy(&r, in.payload, sizeof(r));
+  if(r.max > out.out_cap){
+    // More than one frame asked for: stream it as a segmented reply.
+    uint16_t cap = 0;
+    uint8_t* big = EspNowCore::instance() ? EspNowCore::instance()->largeReplyBuffer(cap) : nullptr;
+    if(big){
+      size_t n = glue::LogRead<LogFS>::read(S->logs, r.off, big, r.max < cap ? r.max : cap);
+      if(n > out.out_cap) return EspNowCore::instance()->commitLargeReply((uint16_t)n);
+      std::memcpy(out.out, big, n); out.out_len = (uint16_t)n; return true;
+    }
+    r.max = out.out_cap;
+  }
+  size_t n = glue::LogRead<LogFS>::read(S->logs, r.off, out.out, r.max);
+  out.out_len = (uint16_t)n; return true;
+}
+
+bool getTopology(IRoleAdapter&, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  auto* core = EspNowCore::instance();
+  return core && core->replyTopology(in, out);
+}
+
+}} // namespace espnow::ops
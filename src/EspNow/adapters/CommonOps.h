@@ -133,6 +133,14 @@ struct RelaySet<T, std::void_t<decltype(std::declval<T>().pulse(uint8_t(0), uint
   static bool set(T* r, uint8_t ch, bool on, uint16_t ms){ if(ms==0){ r->set(ch,on); return true; } r->pulse(ch,ms,on); return true; }
 };
 
+// Atomic partial update: channels outside chMask keep their state.
+template<typename T, typename = void>
+struct RelayApplyMask { static bool apply(T*, uint32_t, uint32_t){ return false; } };
+template<typename T>
+struct RelayApplyMask<T, std::void_t<decltype(std::declval<T>().writeMask(uint32_t(0))), decltype(std::declval<T>().getStatesBitmap())>> {
+  static bool apply(T* r, uint32_t ch, uint32_t on){ r->writeMask((r->getStatesBitmap() & ~ch) | (on & ch)); return true; }
+};
+
 template<typename T, typename = void>
 struct LuxGet { static bool get(T*, uint32_t& v){ v=0; return false; } };
 template<typename T>
@@ -173,6 +181,21 @@ struct SensorSetThresh<T, std::void_t<decltype(std::declval<T>().setThresholds((
   static bool set(T* s, const uint8_t* d, uint16_t n){ s->setThresholds(d, n); return true; }
 };
 
+// One TF-Luna pair (SENS: idx 0, SEMU: 0..count-1). dir uses SensorManager::Direction values.
+struct PairRead { uint16_t aMm; uint16_t bMm; bool presentA; bool presentB; uint8_t dir; };
+template<typename T, typename = void>
+struct SensorPollPair { static bool poll(T*, uint8_t, PairRead&){ return false; } };
+template<typename T>
+struct SensorPollPair<T, std::void_t<decltype(std::declval<T>().pollPair(uint8_t(0), std::declval<typename T::PairReport&>()))>> {
+  static bool poll(T* s, uint8_t idx, PairRead& o){
+    typename T::PairReport r{};
+    if(!s->pollPair(idx, r)) return false;
+    o.aMm = r.A.dist_mm; o.bMm = r.B.dist_mm;
+    o.presentA = r.presentA; o.presentB = r.presentB; o.dir = (uint8_t)r.direction;
+    return true;
+  }
+};
+
 template<typename T, typename = void>
 struct PmsGetVI { struct VI{ float v; float i; }; static bool get(T*, VI& o){ o={0,0}; return false; } };
 template<typename T>
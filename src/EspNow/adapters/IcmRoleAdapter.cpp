@@ -1,45 +1,71 @@
 #include "IcmRoleAdapter.h"
 #include "../Opcodes.h"
 #include "../EspNowCore.h"
-#include "../TopologyTlv.h"
-#include "CommonOps.h"
 #include <cstring>
 
 namespace espnow {
 
-bool IcmRoleAdapter::handleRequest(const EspNowMsg& in, EspNowResp& out){
-  switch(in.type){
-    case PAIR_EXCHANGE: {
-      if(in.payload_len == 6){
-        EspNowCore::instance()->addPeer(in.payload, false, nullptr);
-      }
-      out.out_len = 0; return true;
-    }
-    case REMOVE_PEER: {
-      if(in.payload_len == 6){
-        EspNowCore::instance()->removePeer(in.payload);
-        out.out_len = 0; return true;
-      }
-      return false;
-    }
-    case PUSH_TOPOLOGY: {
-      EspNowCore::instance()->importLocalTopology(in.payload, in.payload_len);
-      out.out_len = 0; return true;
-    }
-    case GET_TOPOLOGY: {
-      auto* core = EspNowCore::instance();
-      if(!core) return false;
-      std::vector<uint8_t> tlv; core->exportLocalTopology(tlv);
-      if(tlv.size() > 256) return false;
-      std::memcpy(out.out, tlv.data(), tlv.size());
-      out.out_len = (uint16_t)tlv.size(); return true;
-    }
-    default: return false;
-  }
+static bool pairExchange(IRoleAdapter&, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  auto* core = EspNowCore::instance();
+  if(core) core->pairPeer(in.payload);
+  out.out_len = 0; return true;
+}
+
+static bool removePeer(IRoleAdapter&, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  auto* core = EspNowCore::instance();
+  if(!core) return false;
+  core->removePeer(in.payload);
+  out.out_len = 0; return true;
+}
+
+static bool pushTopology(IRoleAdapter&, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  auto* core = EspNowCore::instance();
+  if(core) core->importLocalTopology(in.payload, in.payload_len);
+  out.out_len = 0; return true;
+}
+
+// Pushed with corr 0: nothing goes back.
+static bool sensReport(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  auto* core = EspNowCore::instance();
+  const uint8_t* mac = core ? core->requesterMac() : nullptr;
+  if(!mac) return false;
+  static_cast<IcmRoleAdapter&>(a).deliverReport(mac, in.payload, in.payload_len);
+  out.out_len = 0; return true;
 }
 
+static constexpr OpDef kIcmOps[] = {
+  { PAIR_EXCHANGE, 6, 0, pairExchange },
+  { REMOVE_PEER,   6, 0, removePeer   },
+  { PUSH_TOPOLOGY, 0, 0, pushTopology },
+  { SENS_REPORT,   sizeof(SensReportHdr), 0, sensReport },
+};
+static constexpr auto kIcmTable = makeOpTable(kCommonOps, kIcmOps);
+
+IcmRoleAdapter::IcmRoleAdapter() : ops_(kIcmTable) {}
+
 void IcmRoleAdapter::onTopologyPushed(const uint8_t* tlv, uint16_t len){
   (void)tlv; (void)len;
 }
 
+// The ICM's esp_timer is the network clock; keep every peer locked to it.
+uint32_t IcmRoleAdapter::tick(uint32_t nowMs){
+  auto* core = EspNowCore::instance();
+  uint32_t wait = core ? core->serviceTimeSync(nowMs) : UINT32_MAX;
+  uint32_t otaMs = ota_.service(nowMs);
+  return otaMs < wait ? otaMs : wait;
+}
+
+void IcmRoleAdapter::deliverReport(const uint8_t mac[6], const uint8_t* body, uint16_t len){
+  SensReportHdr h; std::memcpy(&h, body, sizeof(h));
+  SensPairRec recs[16];
+  uint8_t n = 0;
+  for(uint8_t i = 0; i < 16; ++i){
+    if(!(h.mask & (1u << i))) continue;
+    if(sizeof(h) + (n + 1u) * sizeof(SensPairRec) > len) return;   // truncated
+    std::memcpy(&recs[n], body + sizeof(h) + n * sizeof(SensPairRec), sizeof(SensPairRec));
+    ++n;
+  }
+  if(sink_) sink_(mac, h, recs, n, sinkCtx_);
+}
+
 } // namespace espnow
@@ -1,15 +1,34 @@
 #pragma once
 #include "../IRoleAdapter.h"
+#include "OpTable.h"
+#include "../SensReport.h"
+#include "OtaTx.h"
 
 namespace espnow {
 
 class IcmRoleAdapter final : public IRoleAdapter {
 public:
+  IcmRoleAdapter();
   void mount(const ServiceRefs* s) override { S = s; }
-  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override;
+  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override { return ops_.dispatch(*this, S, in, out); }
+  const OpStats* opStats(uint8_t type) const override { return ops_.stats(type); }
   void onTopologyPushed(const uint8_t* tlv, uint16_t len) override;
+  uint32_t tick(uint32_t nowMs) override;     // TIME_SYNC rounds, firmware transfer
+
+  // SENS_REPORT pushes from subscribed sensors; n records, one per bit of h.mask.
+  // Invoked from the ESP-NOW service task.
+  using ReportSink = void(*)(const uint8_t mac[6], const SensReportHdr& h, const SensPairRec* recs, uint8_t n, void* ctx);
+  void setReportSink(ReportSink fn, void* ctx=nullptr){ sink_ = fn; sinkCtx_ = ctx; }
+  void deliverReport(const uint8_t mac[6], const uint8_t* body, uint16_t len);
+
+  // Firmware distribution to nodes (Ota.h); driven from tick().
+  OtaTx& ota(){ return ota_; }
 private:
   const ServiceRefs* S = nullptr;
+  OpDispatcher ops_;
+  ReportSink sink_{nullptr};
+  void*      sinkCtx_{nullptr};
+  OtaTx      ota_;
 };
 
 } // namespace espnow
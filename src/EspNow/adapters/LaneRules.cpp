@@ -0,0 +1,114 @@
+#include "LaneRules.h"
+#include "../EspNowCore.h"
+#include "../Opcodes.h"
+#include <cstring>
+
+namespace espnow {
+
+enum : uint8_t { DIR_NONE = 0, DIR_A_TO_B = 1, DIR_B_TO_A = 2 };   // GET_PRESENCE bits 2-3
+
+LaneRules::LaneRules() : wave_(&LaneRules::send, this) {
+  for(uint8_t v = 0; v < 16; ++v) setDefaults(v, ESPNOW_WAVE_LEAD_CT, ESPNOW_WAVE_STEP_MS, ESPNOW_WAVE_ON_MS);
+}
+
+void LaneRules::setDefaults(uint8_t v, uint8_t lead, uint16_t stepMs, uint16_t onMs){
+  if(v >= 16) return;
+  dLead_[v] = lead; dStepMs_[v] = stepMs; dOnMs_[v] = onMs;
+}
+
+void LaneRules::sync(){
+  auto* core = EspNowCore::instance();
+  if(!core) return;
+  TopoStamp s = core->topologyStamp();
+  if(s.version == stamp_.version && s.hash == stamp_.hash) return;
+  stamp_ = s;
+  wave_.reset();      // switch off with the old frames; the timer is idle now,
+                      // so nothing reads acts_ until the next observe()
+  const auto& rp = core->getLocalTopology().roleParams;
+  if(compile(rp.data(), (uint16_t)rp.size())) return;
+  portENTER_CRITICAL(&mux_);
+  st_.rejected++;
+  portEXIT_CRITICAL(&mux_);
+}
+
+// All or nothing: a bad record leaves no rules rather than half a lane.
+bool LaneRules::compile(const uint8_t* p, uint16_t len){
+  nActs_ = 0; mask_ = 0;
+  std::memset(negCount_, 0, sizeof(negCount_));
+  std::memset(posCount_, 0, sizeof(posCount_));
+  auto* core = EspNowCore::instance();
+  uint16_t off = 0;
+  while(off < len){
+    if(uint16_t(len - off) < sizeof(SensLaneHdr)) break;
+    SensLaneHdr h; std::memcpy(&h, p + off, sizeof(h)); off += sizeof(h);
+    uint16_t n = uint16_t(h.nNeg + h.nPos);
+    if(h.virt >= 16 || uint16_t(len - off) < n * sizeof(SensRelayRef) || nActs_ + n > ESPNOW_SENS_RULE_ACTS_MAX) break;
+    negFirst_[h.virt] = nActs_;                 negCount_[h.virt] = h.nNeg;
+    posFirst_[h.virt] = uint8_t(nActs_ + h.nNeg); posCount_[h.virt] = h.nPos;
+    lead_[h.virt] = h.lead; stepMs_[h.virt] = h.stepMs; onMs_[h.virt] = h.onMs;
+    for(uint16_t i = 0; i < n; ++i, off += sizeof(SensRelayRef)){
+      SensRelayRef r; std::memcpy(&r, p + off, sizeof(r));
+      Act& a = acts_[nActs_++];
+      std::memcpy(a.mac, r.mac, 6);
+      uint8_t k = 0;
+      if(r.idx != SENS_RELAY_PHYS) a.body[k++] = r.idx;
+      a.body[k++] = r.ch; a.body[k++] = 1; a.body[k++] = 0; a.body[k++] = 0;   // on, latched
+      a.len = k;
+      if(core) core->addPeer(r.mac);    // registered now, not on the edge
+    }
+    mask_ |= uint16_t(1u << h.virt);
+  }
+  if(off == len) return true;
+  nActs_ = 0; mask_ = 0;
+  std::memset(negCount_, 0, sizeof(negCount_));
+  std::memset(posCount_, 0, sizeof(posCount_));
+  return false;
+}
+
+// A->B waves over POSRLS and drops NEGRLS relays not lit yet; B->A the reverse.
+bool LaneRules::observe(uint8_t v, uint8_t pres){
+  if(v >= 16 || !(mask_ & (1u << v))) return false;
+  uint8_t was = last_[v] >> 2, dir = pres >> 2;
+  last_[v] = pres;
+  if(dir == was || dir == DIR_NONE) return false;
+  bool ab = dir == DIR_A_TO_B;
+  uint8_t  lead = lead_[v] ? lead_[v] : dLead_[v];
+  uint8_t  n    = ab ? posCount_[v] : negCount_[v];
+  if(!n) return false;
+  if(lead && lead < n) n = lead;
+  portENTER_CRITICAL(&mux_);
+  st_.fired++;
+  portEXIT_CRITICAL(&mux_);
+  wave_.trigger(ab ? posFirst_[v] : negFirst_[v], n,
+                stepMs_[v] ? stepMs_[v] : dStepMs_[v], onMs_[v] ? onMs_[v] : dOnMs_[v],
+                ab ? negFirst_[v] : posFirst_[v], ab ? negCount_[v] : posCount_[v]);
+  return true;
+}
+
+// Uncorrelated (corr 0): relays act without answering; the ICM learns from
+// the SENS_REPORT that follows. Runs on the service task or the esp_timer task.
+void LaneRules::send(void* ctx, uint8_t act, bool on){
+  auto& self = *static_cast<LaneRules*>(ctx);
+  auto* core = EspNowCore::instance();
+  if(!core || act >= self.nActs_) return;
+  const Act& a = self.acts_[act];
+  EspNowCore::TxView tv{ nullptr, nullptr, 0 };
+  bool ok = core->beginFrame(a.mac, SET_RELAY, 0, 0, tv) && tv.cap >= a.len;
+  if(ok){
+    std::memcpy(tv.body, a.body, a.len);
+    tv.body[a.len - 3] = on ? 1 : 0;
+    ok = core->commitFrame(tv, a.len, TX_ACTUATION);
+  }else core->abortFrame(tv);
+  portENTER_CRITICAL(&self.mux_);
+  if(ok) self.st_.frames++; else self.st_.drops++;
+  portEXIT_CRITICAL(&self.mux_);
+}
+
+LaneRules::Stats LaneRules::stats() const {
+  portENTER_CRITICAL(&mux_);
+  Stats s = st_;
+  portEXIT_CRITICAL(&mux_);
+  return s;
+}
+
+} // namespace espnow
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include "../SensLane.h"
+#include "../TopologyTlv.h"
+#include "../../Config/EspNowConfig.h"
+#include "WaveSeq.h"
+
+namespace espnow {
+
+// Local SENS/SEMU rule engine: a direction edge on a (virtual) sensor runs a
+// relay wave over its NEGRLS/POSRLS relays (WaveSeq), without the ICM. The
+// frames are resolved from the topology roleParams (SensLane.h) when the
+// topology changes, so each step is a copy into a TX frame.
+class LaneRules {
+public:
+  struct Stats {
+    uint32_t fired;       // edges that had relays to drive
+    uint32_t frames;      // SET_RELAY frames queued
+    uint32_t drops;       // no TX frame free
+    uint32_t rejected;    // lane records that did not fit or parse
+  };
+
+  LaneRules();
+
+  // Recompiles when the local topology stamp moved. Cheap otherwise.
+  void sync();
+  bool empty() const { return !nActs_; }
+  uint16_t virtMask() const { return mask_; }
+
+  // Wave shape for lanes that leave it at 0 (per virtual).
+  void setDefaults(uint8_t v, uint8_t lead, uint16_t stepMs, uint16_t onMs);
+
+  // One sample of virtual v (GET_PRESENCE bits). Starts a wave on a direction
+  // change; returns true if one started.
+  bool observe(uint8_t v, uint8_t pres);
+  Stats stats() const;
+  const WaveSeq& wave() const { return wave_; }
+
+private:
+  struct Act {
+    uint8_t mac[6];
+    uint8_t len;
+    uint8_t body[5];      // [idx] ch on ms
+  };
+  bool compile(const uint8_t* p, uint16_t len);
+  static void send(void* ctx, uint8_t act, bool on);
+
+  Act      acts_[ESPNOW_SENS_RULE_ACTS_MAX];
+  uint8_t  nActs_{0};
+  uint8_t  negFirst_[16]{}, negCount_[16]{};
+  uint8_t  posFirst_[16]{}, posCount_[16]{};
+  uint8_t  lead_[16]{};                       // lane values, 0 = default
+  uint16_t stepMs_[16]{}, onMs_[16]{};
+  uint8_t  dLead_[16];                        // node defaults
+  uint16_t dStepMs_[16], dOnMs_[16];
+  uint8_t  last_[16]{};
+  uint16_t mask_{0};
+  TopoStamp stamp_{0, 0};
+  WaveSeq  wave_;
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+  Stats    st_{};       // under mux_: send() runs on either task
+};
+
+} // namespace espnow
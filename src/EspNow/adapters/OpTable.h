@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "../Frame.h"
+#include "../ServiceRefs.h"
+#include "../Opcodes.h"
+#include "../../Config/EspNowConfig.h"
+
+namespace espnow {
+
+class IRoleAdapter;
+
+// One opcode of a role. The dispatcher checks the lengths, so a handler never
+// sees a body shorter than minLen nor an answer buffer smaller than outMin.
+using OpFn = bool(*)(IRoleAdapter& self, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+
+struct OpDef {
+  uint8_t type;
+  uint8_t minLen;
+  uint8_t outMin;
+  OpFn    fn;
+};
+
+struct OpStats {
+  uint32_t calls;       // handler ran
+  uint32_t failed;      // handler returned false
+  uint32_t rejected;    // body too short / no room; handler not run
+};
+
+// Built at compile time: slot[type] is the defs index + 1 (0 = not handled).
+template<size_t N>
+struct OpTable {
+  uint8_t slot[256];
+  OpDef   defs[N];
+};
+
+// Common ops first, then the role's own; a role entry replaces a common one.
+template<size_t A, size_t B>
+constexpr OpTable<A + B> makeOpTable(const OpDef (&common)[A], const OpDef (&role)[B]){
+  static_assert(A + B <= ESPNOW_ROLE_OPS_MAX, "raise ESPNOW_ROLE_OPS_MAX");
+  OpTable<A + B> t{};
+  size_t n = 0;
+  for(size_t i = 0; i < A; ++i, ++n){ t.defs[n] = common[i]; t.slot[common[i].type] = uint8_t(n + 1); }
+  for(size_t i = 0; i < B; ++i, ++n){ t.defs[n] = role[i];   t.slot[role[i].type]   = uint8_t(n + 1); }
+  return t;
+}
+
+// Per-adapter front end of a table: one indexed lookup, length checks, counters.
+// Unknown opcodes are refused before anything else runs.
+class OpDispatcher {
+public:
+  template<size_t N>
+  explicit OpDispatcher(const OpTable<N>& t) : slot_(t.slot), defs_(t.defs) {}
+
+  bool dispatch(IRoleAdapter& self, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+    uint8_t i = slot_[in.type];
+    if(!i){ unknown_++; return false; }
+    const OpDef& d = defs_[i - 1];
+    OpStats& st = st_[i - 1];
+    if(in.payload_len < d.minLen || out.out_cap < d.outMin){ st.rejected++; return false; }
+    st.calls++;
+    if(d.fn(self, S, in, out)) return true;
+    st.failed++;
+    return false;
+  }
+
+  bool handles(uint8_t type) const { return slot_[type] != 0; }
+  const OpStats* stats(uint8_t type) const { return slot_[type] ? &st_[slot_[type] - 1] : nullptr; }
+  uint32_t unknown() const { return unknown_; }
+
+private:
+  const uint8_t* slot_;
+  const OpDef*   defs_;
+  OpStats        st_[ESPNOW_ROLE_OPS_MAX]{};
+  uint32_t       unknown_{0};
+};
+
+// Opcodes every production role answers the same way (CommonOps.cpp).
+namespace ops {
+bool getTemp    (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool getTime    (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool setTime    (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool getFanMode (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool setFanMode (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool buzzPing   (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool ledPing    (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool getLogs    (IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+bool getTopology(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out);
+
+struct LogsReq { uint32_t off; uint16_t max; } __attribute__((packed));
+} // namespace ops
+
+inline constexpr OpDef kCommonOps[] = {
+  { GET_TEMP,     0, 4,                    ops::getTemp     },
+  { GET_TIME,     0, 4,                    ops::getTime     },
+  { SET_TIME,     4, 0,                    ops::setTime     },
+  { GET_FAN_MODE, 0, 1,                    ops::getFanMode  },
+  { SET_FAN_MODE, 1, 0,                    ops::setFanMode  },
+  { BUZZ_PING,    0, 0,                    ops::buzzPing    },
+  { LED_PING,     0, 0,                    ops::ledPing     },
+  { GET_LOGS,     sizeof(ops::LogsReq), 0, ops::getLogs     },
+  { GET_TOPOLOGY, 0, 0,                    ops::getTopology },
+};
+
+} // namespace espnow
@@ -0,0 +1,226 @@
+#include "OtaTx.h"
+#include "../EspNowCore.h"
+#include "../Opcodes.h"
+#include <cstring>
+
+#include <esp_system.h>
+
+namespace espnow {
+
+enum : uint8_t { T_BEGIN = 0, T_SEND = 1, T_COMMIT = 2, T_DONE = 3 };
+
+static const uint8_t kBroadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+bool OtaTx::start(const uint8_t (*macs)[6], uint8_t n, uint32_t size, uint32_t crc32, bool multicast,
+                  ReadFn read, DoneFn done, void* ctx, bool reboot){
+  if(active_ || !macs || !n || !size || !read || !EspNowCore::instance()) return false;
+  if((size + ESPNOW_OTA_CHUNK - 1) / ESPNOW_OTA_CHUNK > 0xFFFF) return false;
+  n_ = 0;
+  for(uint8_t i = 0; i < n && n_ < ESPNOW_OTA_TARGETS; ++i){
+    Target& t = t_[n_++];
+    t = Target{};
+    std::memcpy(t.mac, macs[i], 6);
+    t.state = T_BEGIN;
+  }
+  size_ = size; crc_ = crc32; count_ = uint16_t((size + ESPNOW_OTA_CHUNK - 1) / ESPNOW_OTA_CHUNK);
+  multicast_ = multicast; reboot_ = reboot;
+  read_ = read; done_ = done; ctx_ = ctx;
+  next_ = 0; rr_ = 0; readErr_ = false;
+  xid_ = uint8_t(esp_random() % 255 + 1);
+  active_ = true;
+  return true;
+}
+
+uint8_t OtaTx::startRole(uint8_t role, uint32_t size, uint32_t crc32, ReadFn read, DoneFn done, void* ctx, bool reboot){
+  auto* core = EspNowCore::instance();
+  if(!core) return 0;
+  uint8_t macs[ESPNOW_OTA_TARGETS][6];
+  uint8_t n = 0;
+  for(const Peer* p = core->peers().begin(); p && p != core->peers().end() && n < ESPNOW_OTA_TARGETS; ++p)
+    if(p->role == role && !(p->mac[0] & 0x01)) std::memcpy(macs[n++], p->mac, 6);
+  return start(macs, n, size, crc32, true, read, done, ctx, reboot) ? n : 0;
+}
+
+void OtaTx::abort(){
+  for(uint8_t i = 0; i < n_; ++i) if(t_[i].state != T_DONE) finish(t_[i], FW_ERR_ABORTED);
+}
+
+OtaTx::Target* OtaTx::find(const uint8_t mac[6]){
+  for(uint8_t i = 0; i < n_; ++i) if(std::memcmp(t_[i].mac, mac, 6) == 0) return &t_[i];
+  return nullptr;
+}
+
+void OtaTx::finish(Target& t, uint8_t err){
+  t.state = T_DONE; t.err = err; t.waiting = false;
+  if(err) st_.failed++;
+  if(done_) done_(t.mac, err, ctx_);
+  bool live = false;
+  for(uint8_t i = 0; i < n_; ++i) if(t_[i].state != T_DONE) live = true;
+  active_ = live;
+}
+
+uint16_t OtaTx::chunkLen(uint16_t idx) const {
+  return idx + 1u == count_ ? uint16_t(size_ - uint32_t(idx) * ESPNOW_OTA_CHUNK) : uint16_t(ESPNOW_OTA_CHUNK);
+}
+
+// Reads straight into the TX frame; the CRC is taken over what was read.
+bool OtaTx::sendChunk(const uint8_t mac[6], uint16_t idx){
+  auto* core = EspNowCore::instance();
+  if(!core || core->txFreeFrames() <= ESPNOW_SEG_TX_RESERVE) return false;
+  EspNowCore::TxView v{ nullptr, nullptr, 0 };
+  uint16_t n = chunkLen(idx);
+  if(!core->beginFrame(mac, FW_CHUNK, 0x00, 0, v)) return false;
+  if(v.cap < sizeof(FwChunkHdr) + n){ core->abortFrame(v); return false; }
+  uint8_t* d = v.body + sizeof(FwChunkHdr);
+  if(!read_(ctx_, uint32_t(idx) * ESPNOW_OTA_CHUNK, d, n)){ core->abortFrame(v); readErr_ = true; return false; }
+  FwChunkHdr h{ xid_, idx, fwCrc32(0, d, n) };
+  std::memcpy(v.body, &h, sizeof(h));
+  return core->commitFrame(v, uint16_t(sizeof(h) + n), TX_LOG);
+}
+
+// true while blocked with work left (pool reserve reached).
+bool OtaTx::pumpUnicast(Target& t){
+  for(uint8_t i = 0; i < ESPNOW_OTA_WINDOW && t.resend; ++i){
+    if(!(t.resend & (1u << i))) continue;
+    if(!sendChunk(t.mac, uint16_t(t.base + i))) return true;
+    t.resend &= ~(1u << i);
+    st_.resent++;
+  }
+  while(t.next < count_ && t.next < t.base + ESPNOW_OTA_WINDOW){
+    if(!sendChunk(t.mac, t.next)) return true;
+    t.next++;
+    st_.chunks++;
+  }
+  return false;
+}
+
+// The window starts at the slowest target; a chunk is rebroadcast once for
+// every target still missing it.
+uint16_t OtaTx::sharedBase() const {
+  uint16_t base = count_;
+  for(uint8_t i = 0; i < n_; ++i) if(t_[i].state == T_SEND && t_[i].base < base) base = t_[i].base;
+  return base;
+}
+
+bool OtaTx::pumpMulticast(){
+  uint16_t base = sharedBase();
+  for(uint16_t c = base; c < next_ && c < base + ESPNOW_OTA_WINDOW; ++c){
+    bool need = false;
+    for(uint8_t i = 0; i < n_; ++i){
+      const Target& t = t_[i];
+      if(t.state == T_SEND && c >= t.base && c < t.base + ESPNOW_OTA_WINDOW && (t.resend >> (c - t.base)) & 1u) need = true;
+    }
+    if(!need) continue;
+    if(!sendChunk(kBroadcast, c)) return true;
+    for(uint8_t i = 0; i < n_; ++i){
+      Target& t = t_[i];
+      if(t.state == T_SEND && c >= t.base && c < t.base + ESPNOW_OTA_WINDOW) t.resend &= ~(1u << (c - t.base));
+    }
+    st_.resent++;
+  }
+  while(next_ < count_ && next_ < base + ESPNOW_OTA_WINDOW){
+    if(!sendChunk(kBroadcast, next_)) return true;
+    next_++;
+    st_.chunks++;
+  }
+  return false;
+}
+
+void OtaTx::request(Target& t, uint8_t type){
+  auto* core = EspNowCore::instance();
+  if(!core) return;
+  uint8_t body[sizeof(FwBeginReq)];
+  uint16_t len = 0;
+  if(type == FW_BEGIN){
+    FwBeginReq b{ xid_, size_, crc_, uint16_t(ESPNOW_OTA_CHUNK) };
+    std::memcpy(body, &b, sizeof(b)); len = sizeof(b);
+  }else if(type == FW_COMMIT){
+    FwCommitReq c{ xid_, uint8_t(reboot_ ? 1 : 0) };
+    std::memcpy(body, &c, sizeof(c)); len = sizeof(c);
+  }else{
+    body[0] = xid_; len = 1;
+  }
+  uint16_t corr = core->request(t.mac, type, body, len, &OtaTx::onReply, this);
+  if(!corr) return;                   // pending table full: next pass
+  t.corr = corr; t.waiting = true;
+  if(type == FW_STATUS) st_.polls++;
+}
+
+// Holes are chunks sent but neither written nor held, below the highest one
+// held: the tail may still be on its way. With no progress since the last
+// poll the tail counts too.
+void OtaTx::update(Target& t, const FwStatus& s){
+  bool stalled = s.base == t.base && s.have == t.have;
+  t.base = s.base; t.have = s.have; t.resend = 0;
+  if(!multicast_ && t.next < t.base) t.next = t.base;
+  uint16_t sent = multicast_ ? next_ : t.next;
+  uint8_t top = 0;
+  for(uint8_t i = 0; i < ESPNOW_OTA_WINDOW; ++i) if(t.have & (1u << i)) top = uint8_t(i + 1);
+  for(uint8_t i = 0; i < ESPNOW_OTA_WINDOW; ++i){
+    uint32_t c = uint32_t(t.base) + i;
+    if(c >= sent || (i >= top && !stalled)) break;
+    if(!(t.have & (1u << i))) t.resend |= 1u << i;
+  }
+}
+
+void OtaTx::onReply(const uint8_t mac[6], const ReqResult& r, void* ctx){
+  auto& self = *static_cast<OtaTx*>(ctx);
+  Target* t = self.find(mac);
+  if(!self.active_ || !t || !t->waiting || t->corr != r.corr) return;   // from an aborted session
+  t->waiting = false;
+  if(r.status != REQ_OK || r.len < sizeof(FwStatus)){
+    if(r.type == FW_STATUS && r.status == REQ_TIMEOUT && ++t->misses < ESPNOW_OTA_MAX_MISSES) return;
+    self.finish(*t, FW_ERR_TIMEOUT);
+    return;
+  }
+  t->misses = 0;
+  FwStatus s; std::memcpy(&s, r.payload, sizeof(s));
+  if(s.err != FW_OK){ self.finish(*t, s.err); return; }
+  if(r.type == FW_COMMIT){
+    self.finish(*t, s.state == FWS_COMMITTED ? uint8_t(FW_OK) : uint8_t(FW_ERR_INCOMPLETE));
+    return;
+  }
+  t->state = T_SEND;
+  self.update(*t, s);
+}
+
+uint32_t OtaTx::service(uint32_t){
+  if(!active_) return UINT32_MAX;
+  bool again = false, sending = false;
+  for(uint8_t k = 0; k < n_; ++k){
+    Target& t = t_[(rr_ + k) % n_];
+    if(t.state == T_DONE || t.waiting) continue;
+    if(t.state == T_SEND && t.base >= count_) t.state = T_COMMIT;
+    if(t.state == T_BEGIN || t.state == T_COMMIT){ request(t, t.state == T_BEGIN ? FW_BEGIN : FW_COMMIT); again |= !t.waiting; continue; }
+    if(multicast_){ sending = true; continue; }
+    if(pumpUnicast(t)){ again = true; continue; }
+    request(t, FW_STATUS);          // window sent: ask what arrived
+    again |= !t.waiting;
+  }
+  rr_ = n_ ? uint8_t((rr_ + 1) % n_) : 0;
+  if(sending){
+    auto* core = EspNowCore::instance();
+    // Unicast polls may pass broadcast chunks still queued (per-peer budgets),
+    // and would then report them as holes.
+    if(pumpMulticast()) again = true;
+    else if(core && core->txStats().laneDepth[TX_LOG]) again = true;
+    else{
+      // Poll a target once per batch of new chunks; the one holding the window
+      // back is polled until it catches up. t.next is next_ at its last poll.
+      uint16_t base = sharedBase();
+      for(uint8_t i = 0; i < n_; ++i){
+        Target& t = t_[i];
+        if(t.state != T_SEND || t.waiting || (t.next == next_ && t.base != base)) continue;
+        request(t, FW_STATUS);
+        if(t.waiting) t.next = next_; else again = true;
+      }
+    }
+  }
+  if(readErr_){
+    for(uint8_t i = 0; i < n_; ++i) if(t_[i].state != T_DONE) finish(t_[i], FW_ERR_READ);
+    return UINT32_MAX;
+  }
+  return again ? 1 : UINT32_MAX;
+}
+
+} // namespace espnow
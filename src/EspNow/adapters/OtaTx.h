@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include "../Ota.h"
+#include "../Request.h"
+#include "../../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Sender side of the firmware transfer (Ota.h), run from the ICM's tick().
+// One image per session, up to ESPNOW_OTA_TARGETS nodes at once. Unicast mode
+// keeps a window per target; multicast broadcasts each chunk once and paces on
+// the slowest target, resending a chunk (again by broadcast) while any target
+// misses it. The image is pulled through read() a chunk at a time.
+class OtaTx {
+public:
+  using ReadFn = bool(*)(void* ctx, uint32_t off, uint8_t* dst, uint16_t len);
+  using DoneFn = void(*)(const uint8_t mac[6], uint8_t err, void* ctx);   // once per target
+
+  struct Stats {
+    uint32_t chunks;      // chunk frames queued, first sends
+    uint32_t resent;      // chunk frames queued again for holes
+    uint32_t polls;       // FW_STATUS requests
+    uint32_t failed;      // targets that ended with an error
+  };
+
+  // crc32 = fwCrc32 of the whole image. false if busy or nothing to do.
+  bool start(const uint8_t (*macs)[6], uint8_t n, uint32_t size, uint32_t crc32, bool multicast,
+             ReadFn read, DoneFn done, void* ctx, bool reboot=true);
+  // Every peer whose role is `role`, multicast. Returns the target count.
+  uint8_t startRole(uint8_t role, uint32_t size, uint32_t crc32,
+                    ReadFn read, DoneFn done, void* ctx, bool reboot=true);
+  void     abort();
+  bool     busy() const { return active_; }
+  uint32_t service(uint32_t nowMs);
+  Stats    stats() const { return st_; }
+
+private:
+  struct Target {
+    uint8_t  mac[6];
+    uint8_t  state;       // T_* in OtaTx.cpp
+    uint8_t  err;
+    uint8_t  misses;      // status polls lost in a row
+    bool     waiting;     // request outstanding
+    uint16_t corr;        // ... and its correlation id
+    uint16_t base;        // first chunk it has not written
+    uint16_t next;        // unicast: next chunk never sent; multicast: next_ at the last poll
+    uint32_t have;        // bit i: base+i held
+    uint32_t resend;      // bit i: base+i to send again
+  };
+  static void onReply(const uint8_t mac[6], const ReqResult& r, void* ctx);
+  Target*  find(const uint8_t mac[6]);
+  void     finish(Target& t, uint8_t err);
+  bool     sendChunk(const uint8_t mac[6], uint16_t idx);
+  bool     pumpUnicast(Target& t);
+  bool     pumpMulticast();
+  uint16_t sharedBase() const;
+  void     request(Target& t, uint8_t type);
+  void     update(Target& t, const FwStatus& s);
+  uint16_t chunkLen(uint16_t idx) const;
+
+  Target   t_[ESPNOW_OTA_TARGETS]{};
+  uint8_t  n_{0};
+  bool     active_{false};
+  bool     multicast_{false};
+  bool     reboot_{true};
+  uint8_t  xid_{0};
+  uint32_t size_{0}, crc_{0};
+  uint16_t count_{0};
+  uint16_t next_{0};      // multicast: next chunk never sent
+  uint8_t  rr_{0};        // unicast: target served first
+  bool     readErr_{false};
+  ReadFn   read_{nullptr};
+  DoneFn   done_{nullptr};
+  void*    ctx_{nullptr};
+  Stats    st_{};
+};
+
+} // namespace espnow
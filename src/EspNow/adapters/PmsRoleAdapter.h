@@ -1,14 +1,18 @@
 #pragma once
 #include "../IRoleAdapter.h"
+#include "OpTable.h"
 
 namespace espnow {
 
 class PmsRoleAdapter final : public IRoleAdapter {
 public:
+  PmsRoleAdapter();
   void mount(const ServiceRefs* s) override { S = s; }
-  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override;
+  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override { return ops_.dispatch(*this, S, in, out); }
+  const OpStats* opStats(uint8_t type) const override { return ops_.stats(type); }
 private:
   const ServiceRefs* S = nullptr;
+  OpDispatcher ops_;
 };
 
 } // namespace espnow
@@ -1,29 +1,106 @@
 #include "RelayEmuRoleAdapter.h"
 #include "../Opcodes.h"
+#include "../Group.h"
+#include "../RelayAt.h"
+#include "CommonOps.h"
+#include "VirtMux.h"
 #include <cstring>
 
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/RelayManager.h")
+  #include "../../Peripheral/RelayManager.h"
+#endif
+
 namespace espnow {
 
+static_assert(ESPNOW_REMU_VIRT_MAX <= 16, "virt mask is 16 bits");
+static_assert(ESPNOW_REMU_VIRT_MAX * ESPNOW_REMU_CH_PER_VIRT <= 32, "default split must fit the 32 physical channels");
+
 struct SetRelayPayload { uint8_t ch; uint8_t on; uint16_t ms; };
 
-bool RelayEmuRoleAdapter::handleRequest(const EspNowMsg& in, EspNowResp& out){
-  if(!S) return false;
-  if(in.payload_len < 1) return false;
-  uint8_t idx = in.payload[0];
-  const uint8_t* body = in.payload + 1;
-  uint16_t blen = in.payload_len - 1;
-  (void)idx; (void)body; (void)blen;
-  switch(in.type){
-    case GET_RELAY_STATES: {
-      uint32_t bitmap = 0;
-      std::memcpy(out.out, &bitmap, sizeof(bitmap)); out.out_len = sizeof(bitmap);
-      return true;
-    }
-    case SET_RELAY: {
-      if(blen < sizeof(SetRelayPayload)) return false;
-      out.out_len = 0; return true;
-    }
-    default: return false;
+static RelayEmuRoleAdapter::Relays& relays_(IRoleAdapter& a){ return static_cast<RelayEmuRoleAdapter&>(a).relays(); }
+
+static uint32_t laneMask(uint8_t n){ return n >= 32 ? 0xFFFFFFFFu : ((1u << n) - 1); }
+
+static bool getRelayStates(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_REMU_VIRT_MAX), s)) return false;
+  auto& r = relays_(a);
+  return virtGather(s, 4, out, [&](uint8_t v, uint8_t* d){ std::memcpy(d, &r.shadow[v], 4); return true; });
+}
+
+// Drives the owned physical channel when a RelayManager is mounted; the
+// shadow alone is the emulated relay otherwise. A pulse (ms > 0) ends where
+// it started, so only latched writes move the shadow.
+static bool setRelay(IRoleAdapter& a, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_REMU_VIRT_MAX), s) || s.multi) return false;
+  if(s.len < sizeof(SetRelayPayload)) return false;
+  SetRelayPayload p{}; std::memcpy(&p, s.body, sizeof(p));
+  auto& r = relays_(a); uint8_t v = s.first();
+  if(p.ch >= r.chCount[v]) return false;
+  RelaySchedule::Hold h(static_cast<RelayEmuRoleAdapter&>(a).schedule());
+  if(S && S->relay && !glue::RelaySet<::RelayManager>::set(S->relay, uint8_t(r.chBase[v] + p.ch), p.on != 0, p.ms)) return false;
+  out.out_len = 0;
+  if(p.ms) return true;
+  if(p.on) r.shadow[v] |= (1u << p.ch); else r.shadow[v] &= ~(1u << p.ch);
+  return true;
+}
+
+bool RelayEmuRoleAdapter::applyMask(uint32_t chMask, uint32_t onMask){
+  if(S && S->relay && !glue::RelayApplyMask<::RelayManager>::apply(S->relay, chMask, onMask)) return false;
+  for(uint8_t v = 0, n = virtCount(ESPNOW_REMU_VIRT_MAX); v < n; ++v){
+    uint32_t lane = laneMask(rx_.chCount[v]);
+    uint32_t ch = (chMask >> rx_.chBase[v]) & lane;
+    uint32_t on = (onMask >> rx_.chBase[v]) & lane;
+    rx_.shadow[v] = (rx_.shadow[v] & ~ch) | (on & ch);
+  }
+  return true;
+}
+
+// Group frames carry no idx: masks are physical and fan out to every virtual.
+static bool setGroup(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  SetGroupPayload p{}; std::memcpy(&p, in.payload, sizeof(p));
+  out.out_len = 0;
+  RelaySchedule::Hold h(static_cast<RelayEmuRoleAdapter&>(a).schedule());
+  return static_cast<RelayEmuRoleAdapter&>(a).applyMask(p.chMask, p.onMask);
+}
+
+// Masks arrive in the virtual's numbering and are queued shifted to physical.
+static bool setRelayAt(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_REMU_VIRT_MAX), s) || s.multi) return false;
+  if(s.len < sizeof(SetRelayAtPayload)) return false;
+  SetRelayAtPayload p{}; std::memcpy(&p, s.body, sizeof(p));
+  auto& r = relays_(a); uint8_t v = s.first();
+  uint32_t lane = laneMask(r.chCount[v]);
+  out.out_len = 0;
+  return static_cast<RelayEmuRoleAdapter&>(a).schedule().add(p.atUs, (p.chMask & lane) << r.chBase[v], (p.onMask & lane) << r.chBase[v]);
+}
+
+static bool pushConfig(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_REMU_VIRT_MAX), s) || s.multi) return false;
+  if(s.len < sizeof(RemuVirtCfg)) return false;
+  RemuVirtCfg c; std::memcpy(&c, s.body, sizeof(c));
+  if(!c.chCount || c.chBase + c.chCount > 32) return false;
+  auto& r = relays_(a); uint8_t v = s.first();
+  RelaySchedule::Hold h(static_cast<RelayEmuRoleAdapter&>(a).schedule());   // the timer's writes read the split
+  r.chBase[v] = c.chBase; r.chCount[v] = c.chCount;
+  r.shadow[v] &= laneMask(c.chCount);
+  out.out_len = 0; return true;
+}
+
+// minLen counts the idx byte; the multi form is checked by virtSelect().
+static constexpr OpDef kRelayEmuOps[] = {
+  { GET_RELAY_STATES, 1,                           4, getRelayStates },
+  { SET_RELAY,        1 + sizeof(SetRelayPayload), 0, setRelay       },
+  { SET_GROUP,        sizeof(SetGroupPayload),     0, setGroup       },
+  { PUSH_CONFIG,      1 + sizeof(RemuVirtCfg),     0, pushConfig     },
+  { SET_RELAY_AT,     1 + sizeof(SetRelayAtPayload), 0, setRelayAt   },
+};
+static constexpr auto kRelayEmuTable = makeOpTable(kCommonOps, kRelayEmuOps);
+
+RelayEmuRoleAdapter::RelayEmuRoleAdapter()
+  : ops_(kRelayEmuTable),
+    sched_([](void* c, uint32_t ch, uint32_t on){ return static_cast<RelayEmuRoleAdapter*>(c)->applyMask(ch, on); }, this) {
+  for(uint8_t v = 0; v < ESPNOW_REMU_VIRT_MAX; ++v){   // even split
+    rx_.chBase[v] = uint8_t(v * ESPNOW_REMU_CH_PER_VIRT); rx_.chCount[v] = ESPNOW_REMU_CH_PER_VIRT;
   }
 }
 
@@ -1,14 +1,41 @@
 #pragma once
 #include "../IRoleAdapter.h"
+#include "OpTable.h"
+#include "RelaySchedule.h"
 
 namespace espnow {
 
+#pragma pack(push,1)
+// PUSH_CONFIG body after {idx}: which physical channels a virtual relay owns.
+struct RemuVirtCfg { uint8_t chBase; uint8_t chCount; };
+#pragma pack(pop)
+
 class RelayEmuRoleAdapter final : public IRoleAdapter {
 public:
+  // Per-virtual state, one flat array per field, indexed by virt_id.
+  // shadow is in the virtual's own channel numbering (bit 0 = its first channel).
+  struct Relays {
+    uint32_t shadow[ESPNOW_REMU_VIRT_MAX];
+    uint8_t  chBase[ESPNOW_REMU_VIRT_MAX];
+    uint8_t  chCount[ESPNOW_REMU_VIRT_MAX];
+  };
+
+  RelayEmuRoleAdapter();
   void mount(const ServiceRefs* s) override { S = s; }
-  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override;
+  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override { return ops_.dispatch(*this, S, in, out); }
+  const OpStats* opStats(uint8_t type) const override { return ops_.stats(type); }
+  uint32_t tick(uint32_t) override { return sched_.service(); }   // SET_RELAY_AT writes left overdue
+
+  Relays& relays() { return rx_; }
+  // Physical masks: the RelayManager when mounted, then every virtual's shadow.
+  bool applyMask(uint32_t chMask, uint32_t onMask);
+  RelaySchedule& schedule() { return sched_; }
+
 private:
   const ServiceRefs* S = nullptr;
+  OpDispatcher ops_;
+  Relays rx_{};
+  RelaySchedule sched_;
 };
 
 } // namespace espnow
@@ -1,11 +1,11 @@
 #include "RelayRoleAdapter.h"
 #include "../Opcodes.h"
-#include "../TopologyTlv.h"
-#include "../EspNowCore.h"
+#include "../Group.h"
+#include "../RelayAt.h"
 #include "CommonOps.h"
 #include <cstring>
 
-#if __has_include("../../Peripheral/RelayManager.h")
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/RelayManager.h")
   #include "../../Peripheral/RelayManager.h"
 #endif
 
@@ -13,21 +13,48 @@ namespace espnow {
 
 struct SetRelayPayload { uint8_t ch; uint8_t on; uint16_t ms; };
 
-bool RelayRoleAdapter::handleRequest(const EspNowMsg& in, EspNowResp& out){
+static bool getRelayStates(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
   if(!S || !S->relay) return false;
-  switch(in.type){
-    case GET_RELAY_STATES: {
-      uint16_t n = glue::RelayGetStates<decltype(*S->relay)>::get(S->relay, out.out, 256);
-      out.out_len = n; return n>0;
-    }
-    case SET_RELAY: {
-      if(in.payload_len < sizeof(SetRelayPayload)) return false;
-      SetRelayPayload p{}; std::memcpy(&p, in.payload, sizeof(p));
-      bool ok = glue::RelaySet<decltype(*S->relay)>::set(S->relay, p.ch, p.on!=0, p.ms);
-      out.out_len = 0; return ok;
-    }
-    default: return false;
-  }
+  uint16_t n = glue::RelayGetStates<::RelayManager>::get(S->relay, out.out, out.out_cap);
+  out.out_len = n; return n>0;
+}
+
+static bool setRelay(IRoleAdapter& a, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  if(!S || !S->relay) return false;
+  SetRelayPayload p{}; std::memcpy(&p, in.payload, sizeof(p));
+  out.out_len = 0;
+  RelaySchedule::Hold h(static_cast<RelayRoleAdapter&>(a).schedule());
+  return glue::RelaySet<::RelayManager>::set(S->relay, p.ch, p.on!=0, p.ms);
+}
+
+static bool setGroup(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){   // membership already checked by the core
+  SetGroupPayload p{}; std::memcpy(&p, in.payload, sizeof(p));
+  out.out_len = 0;
+  RelaySchedule::Hold h(static_cast<RelayRoleAdapter&>(a).schedule());
+  return static_cast<RelayRoleAdapter&>(a).applyMask(p.chMask, p.onMask);
+}
+
+static bool setRelayAt(IRoleAdapter& a, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  if(!S || !S->relay) return false;
+  SetRelayAtPayload p{}; std::memcpy(&p, in.payload, sizeof(p));
+  out.out_len = 0;
+  return static_cast<RelayRoleAdapter&>(a).schedule().add(p.atUs, p.chMask, p.onMask);
+}
+
+static constexpr OpDef kRelayOps[] = {
+  { GET_RELAY_STATES, 0,                       4, getRelayStates },
+  { SET_RELAY,        sizeof(SetRelayPayload), 0, setRelay       },
+  { SET_GROUP,        sizeof(SetGroupPayload), 0, setGroup       },
+  { SET_RELAY_AT,     sizeof(SetRelayAtPayload), 0, setRelayAt   },
+};
+static constexpr auto kRelayTable = makeOpTable(kCommonOps, kRelayOps);
+
+RelayRoleAdapter::RelayRoleAdapter()
+  : ops_(kRelayTable),
+    sched_([](void* c, uint32_t ch, uint32_t on){ return static_cast<RelayRoleAdapter*>(c)->applyMask(ch, on); }, this) {}
+
+bool RelayRoleAdapter::applyMask(uint32_t chMask, uint32_t onMask){
+  return S && S->relay && glue::RelayApplyMask<::RelayManager>::apply(S->relay, chMask, onMask);
 }
 
 } // namespace espnow
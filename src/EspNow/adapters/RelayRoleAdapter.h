@@ -1,14 +1,26 @@
 #pragma once
 #include "../IRoleAdapter.h"
+#include "OpTable.h"
+#include "RelaySchedule.h"
 
 namespace espnow {
 
 class RelayRoleAdapter final : public IRoleAdapter {
 public:
+  RelayRoleAdapter();
   void mount(const ServiceRefs* s) override { S = s; }
-  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override;
+  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override { return ops_.dispatch(*this, S, in, out); }
+  const OpStats* opStats(uint8_t type) const override { return ops_.stats(type); }
+  uint32_t tick(uint32_t) override { return sched_.service(); }   // SET_RELAY_AT writes left overdue
+
+  // (state & ~chMask) | (onMask & chMask) on the RelayManager.
+  bool applyMask(uint32_t chMask, uint32_t onMask);
+  RelaySchedule& schedule() { return sched_; }
+
 private:
   const ServiceRefs* S = nullptr;
+  OpDispatcher ops_;
+  RelaySchedule sched_;
 };
 
 } // namespace espnow
@@ -0,0 +1,129 @@
+#include "RelaySchedule.h"
+#include "../EspNowCore.h"
+#include <freertos/task.h>
+
+namespace espnow {
+
+RelaySchedule::~RelaySchedule(){
+  if(timer_){ esp_timer_stop(timer_); esp_timer_delete(timer_); }
+}
+
+// Waits out a timer pass already writing, as WaveSeq::reset() does; the
+// timer task never waits on us, it leaves the write to the release.
+RelaySchedule::Hold::Hold(RelaySchedule& s) : s_(s) {
+  for(;;){
+    portENTER_CRITICAL(&s_.mux_);
+    if(!s_.writing_) break;
+    portEXIT_CRITICAL(&s_.mux_);
+    taskYIELD();
+  }
+  s_.held_++;
+  portEXIT_CRITICAL(&s_.mux_);
+}
+
+RelaySchedule::Hold::~Hold(){
+  portENTER_CRITICAL(&s_.mux_);
+  bool late = --s_.held_ == 0 && s_.late_;
+  if(late) s_.late_ = false;
+  portEXIT_CRITICAL(&s_.mux_);
+  if(late) s_.service();
+}
+
+bool RelaySchedule::add(int64_t atUs, uint32_t chMask, uint32_t onMask){
+  auto* core = EspNowCore::instance();
+  if(!core || !core->timeSynced()){ portENTER_CRITICAL(&mux_); st_.refused++; portEXIT_CRITICAL(&mux_); return false; }
+  int64_t now = core->networkTimeUs();
+  bool ok = atUs >= now - int64_t(ESPNOW_RELAY_AT_GRACE_MS) * 1000 &&
+            atUs <= now + int64_t(ESPNOW_RELAY_AT_HORIZON_MS) * 1000;
+  core_ = core;
+  if(ok && !timer_){
+    esp_timer_create_args_t a{};
+    a.callback = &RelaySchedule::onTimer; a.arg = this; a.dispatch_method = ESP_TIMER_TASK; a.name = "relay_at";
+    if(esp_timer_create(&a, &timer_) != ESP_OK){ timer_ = nullptr; ok = false; }
+  }
+  portENTER_CRITICAL(&mux_);
+  ok = ok && n_ < ESPNOW_RELAY_AT_MAX;
+  if(ok){
+    uint8_t i = n_++;
+    for(; i > 0 && q_[i - 1].atUs > atUs; --i) q_[i] = q_[i - 1];
+    q_[i] = Entry{ atUs, chMask, onMask };
+    st_.queued++;
+  }else{
+    st_.refused++;
+  }
+  portEXIT_CRITICAL(&mux_);
+  if(ok) service();       // already due (inside the grace): apply now
+  return ok;
+}
+
+void RelaySchedule::clear(){
+  Hold h(*this);
+  if(timer_) esp_timer_stop(timer_);
+  portENTER_CRITICAL(&mux_);
+  n_ = 0;
+  portEXIT_CRITICAL(&mux_);
+}
+
+RelaySchedule::Stats RelaySchedule::stats() const {
+  portENTER_CRITICAL(&mux_);
+  Stats s = st_;
+  portEXIT_CRITICAL(&mux_);
+  return s;
+}
+
+// esp_timer task: writes unless a handler holds the relays.
+void RelaySchedule::onTimer(void* arg){
+  auto* self = static_cast<RelaySchedule*>(arg);
+  portENTER_CRITICAL(&self->mux_);
+  bool held = self->held_ != 0;
+  if(held){ self->late_ = true; self->st_.deferred++; }
+  else self->writing_ = true;
+  portEXIT_CRITICAL(&self->mux_);
+  if(held) return;
+  self->run();
+  portENTER_CRITICAL(&self->mux_);
+  self->writing_ = false;
+  portEXIT_CRITICAL(&self->mux_);
+}
+
+uint32_t RelaySchedule::service(){
+  if(!core_) return UINT32_MAX;
+  Hold h(*this);
+  run();
+  return UINT32_MAX;
+}
+
+void RelaySchedule::run(){
+  int64_t now = core_->networkTimeUs();
+  for(;;){
+    portENTER_CRITICAL(&mux_);
+    bool due = n_ && q_[0].atUs <= now;
+    Entry e{};
+    if(due){
+      e = q_[0];
+      for(uint8_t i = 1; i < n_; ++i) q_[i - 1] = q_[i];
+      n_--;
+    }
+    portEXIT_CRITICAL(&mux_);
+    if(!due) break;
+    bool ok = apply_(ctx_, e.chMask, e.onMask);
+    portENTER_CRITICAL(&mux_);
+    if(ok) st_.fired++; else st_.failed++;
+    if(uint32_t(now - e.atUs) > st_.maxLateUs) st_.maxLateUs = uint32_t(now - e.atUs);
+    portEXIT_CRITICAL(&mux_);
+    now = core_->networkTimeUs();
+  }
+  arm(now);
+}
+
+void RelaySchedule::arm(int64_t nowUs){
+  if(!timer_) return;
+  portENTER_CRITICAL(&mux_);
+  int64_t next = n_ ? q_[0].atUs : 0;
+  bool any = n_ != 0;
+  portEXIT_CRITICAL(&mux_);
+  esp_timer_stop(timer_);
+  if(any) esp_timer_start_once(timer_, next > nowUs ? uint64_t(next - nowUs) : 0);
+}
+
+} // namespace espnow
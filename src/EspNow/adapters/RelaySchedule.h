@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include "../../Config/EspNowConfig.h"
+
+namespace espnow {
+
+class EspNowCore;
+
+// SET_RELAY_AT queue of a relay node: mask writes held until their network
+// time. A one-shot esp_timer armed for the earliest applies what is due on the
+// esp_timer task, so a handler busy on the service task cannot hold a write
+// back. Handlers that write the relays themselves take a Hold; a write falling
+// due under it runs as the Hold ends, one write late at most. Entries keep the
+// network time, so a clock slew between queueing and firing is followed.
+// Same-instant entries apply in arrival order.
+class RelaySchedule {
+public:
+  using ApplyFn = bool(*)(void* ctx, uint32_t chMask, uint32_t onMask);
+
+  struct Stats {
+    uint32_t queued;
+    uint32_t fired;
+    uint32_t refused;     // not synced, too late, too far ahead or full
+    uint32_t failed;      // apply() returned false
+    uint32_t deferred;    // timer passes that found a Hold and left it the write
+    uint32_t maxLateUs;   // worst firing lateness against atUs
+  };
+
+  // Service task: keeps timer writes off while a handler writes the relays.
+  class Hold {
+  public:
+    explicit Hold(RelaySchedule& s);
+    ~Hold();
+    Hold(const Hold&) = delete;
+    Hold& operator=(const Hold&) = delete;
+  private:
+    RelaySchedule& s_;
+  };
+
+  RelaySchedule(ApplyFn apply, void* ctx) : apply_(apply), ctx_(ctx) {}
+  ~RelaySchedule();
+
+  // Service task only.
+  bool  add(int64_t atUs, uint32_t chMask, uint32_t onMask);
+  void  clear();
+  uint32_t service();     // applies due entries; UINT32_MAX (the timer fires them)
+  Stats stats() const;
+
+private:
+  struct Entry {
+    int64_t  atUs;        // network time
+    uint32_t chMask;
+    uint32_t onMask;
+  };
+  static void onTimer(void* arg);
+  void run();             // under a Hold or with writing_ set
+  void arm(int64_t nowUs);
+
+  ApplyFn  apply_;
+  void*    ctx_;
+  esp_timer_handle_t timer_{nullptr};
+  EspNowCore* core_{nullptr};     // network clock for the timer task
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+  Entry    q_[ESPNOW_RELAY_AT_MAX]{};
+  uint8_t  n_{0};         // q_[0..n_) by atUs, equal ones in arrival order
+  uint8_t  held_{0};      // Holds open on the service task
+  bool     writing_{false};   // timer task inside run()
+  bool     late_{false};      // timer found a Hold; its release runs the write
+  Stats    st_{};             // under mux_: both tasks count
+};
+
+} // namespace espnow
@@ -0,0 +1,101 @@
+#include "SensStream.h"
+#include "../EspNowCore.h"
+#include "../Opcodes.h"
+#include <cstring>
+
+#include <Arduino.h>
+
+namespace espnow {
+
+static inline bool due(uint32_t now, uint32_t at){ return (int32_t)(now - at) >= 0; }
+
+bool SensStream::subscribe(const uint8_t mac[6], const SensSubReq& r, uint16_t live, uint32_t nowMs, SensSubResp& granted){
+  Sub* s = nullptr;
+  Sub* free = nullptr;
+  for(auto& x : subs_){
+    if(x.used && std::memcmp(x.mac, mac, 6) == 0){ s = &x; break; }
+    if(!x.used && !free) free = &x;
+  }
+  granted = SensSubResp{ 0, 0 };
+  if(!r.periodMs){ if(s) s->used = 0; return true; }
+  uint16_t mask = r.mask & live;
+  if(!mask) return false;
+  if(!s){
+    if(!(s = free)) return false;
+    std::memset(s, 0, sizeof(*s));
+    std::memcpy(s->mac, mac, 6);
+    std::memset(s->last, 0xFF, sizeof(s->last));   // first sample reports as an edge
+    s->used = 1;
+  }
+  s->periodMs = r.periodMs < ESPNOW_SENS_MIN_PERIOD_MS ? ESPNOW_SENS_MIN_PERIOD_MS : r.periodMs;
+  s->decim    = r.decim ? r.decim : 1;
+  s->mask     = mask;
+  s->dueMs    = nowMs;
+  s->leaseMs  = nowMs + ESPNOW_SENS_SUB_LEASE_MS;
+  granted = SensSubResp{ s->periodMs, s->mask };
+  return true;
+}
+
+bool SensStream::onSubscribe(const EspNowMsg& in, EspNowResp& out, uint16_t live){
+  auto* core = EspNowCore::instance();
+  const uint8_t* mac = core ? core->requesterMac() : nullptr;
+  if(!mac || in.payload_len < sizeof(SensSubReq) || out.out_cap < sizeof(SensSubResp)) return false;
+  SensSubReq r; std::memcpy(&r, in.payload, sizeof(r));
+  SensSubResp g;
+  if(!subscribe(mac, r, live, millis(), g)) return false;
+  std::memcpy(out.out, &g, sizeof(g)); out.out_len = sizeof(g);
+  return true;
+}
+
+// Subscribers due in the same pass share one sample per pair.
+uint32_t SensStream::tick(uint32_t nowMs){
+  SensPairRec recs[16];
+  uint16_t have = 0, ok = 0;
+  uint32_t wait = UINT32_MAX;
+  for(auto& s : subs_){
+    if(!s.used) continue;
+    if(due(nowMs, s.leaseMs)){ s.used = 0; continue; }
+    if(due(nowMs, s.dueMs)){
+      bool edge = false;
+      for(uint8_t v = 0; v < 16; ++v){
+        if(!(s.mask & (1u << v))) continue;
+        if(!(have & (1u << v))){
+          have |= uint16_t(1u << v);
+          if(sample_(ctx_, v, recs[v])) ok |= uint16_t(1u << v);
+        }
+        if(!(ok & (1u << v))) continue;
+        if(recs[v].pres != s.last[v]){ edge = true; s.last[v] = recs[v].pres; }
+      }
+      st_.samples++;
+      if(edge || ++s.count >= s.decim) push(s, recs, ok, edge);
+      s.dueMs += s.periodMs;
+      if(due(nowMs, s.dueMs)) s.dueMs = nowMs + s.periodMs;   // fell behind: skip, don't burst
+    }
+    uint32_t d = s.dueMs - nowMs, l = s.leaseMs - nowMs;
+    if(d < wait) wait = d;
+    if(l < wait) wait = l;
+  }
+  return wait;
+}
+
+// Written straight into a TX frame. Edge reports ride the actuation lane: they
+// are what a relay is waiting for.
+void SensStream::push(Sub& s, const SensPairRec* recs, uint16_t ok, bool edge){
+  s.count = 0;
+  auto* core = EspNowCore::instance();
+  EspNowCore::TxView v;
+  if(!core || !core->beginFrame(s.mac, SENS_REPORT, 0, 0, v)){ st_.drops++; return; }
+  SensReportHdr h{ s.seq++, edge ? SENS_WHY_EDGE : SENS_WHY_CADENCE, 0, lux_ ? lux_(ctx_) : uint16_t(0) };
+  uint16_t n = sizeof(h);
+  for(uint8_t i = 0; i < 16; ++i){
+    if(!(s.mask & ok & (1u << i)) || n + sizeof(SensPairRec) > v.cap) continue;
+    std::memcpy(v.body + n, &recs[i], sizeof(SensPairRec));
+    n += sizeof(SensPairRec); h.mask |= uint16_t(1u << i);
+  }
+  std::memcpy(v.body, &h, sizeof(h));
+  if(!core->commitFrame(v, n, edge ? TX_ACTUATION : TX_TELEMETRY)){ st_.drops++; return; }
+  st_.reports++;
+  if(edge) st_.edges++;
+}
+
+} // namespace espnow
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include "../SensReport.h"
+#include "../Frame.h"
+#include "../../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Subscriber table and pacing behind SENS_SUBSCRIBE, shared by SENS and SEMU.
+// The adapter supplies the samples; tick() runs on the service task.
+class SensStream {
+public:
+  // Fills rec for pair v; false if the pair has nothing to report.
+  using SampleFn = bool(*)(void* ctx, uint8_t v, SensPairRec& rec);
+  using LuxFn    = uint16_t(*)(void* ctx);
+
+  struct Stats {
+    uint32_t reports;     // SENS_REPORT frames queued
+    uint32_t edges;       // of which pushed early on a presence edge
+    uint32_t drops;       // no TX frame free
+    uint32_t samples;     // sampling passes
+  };
+
+  SensStream(SampleFn sample, LuxFn lux, void* ctx) : sample_(sample), lux_(lux), ctx_(ctx) {}
+
+  // Adds, renews or (periodMs 0) cancels mac's subscription. live = pairs the
+  // node has. false when the table is full or nothing live was asked for.
+  bool subscribe(const uint8_t mac[6], const SensSubReq& r, uint16_t live, uint32_t nowMs, SensSubResp& granted);
+  // SENS_SUBSCRIBE handler body: the requester subscribes; answers SensSubResp.
+  bool onSubscribe(const EspNowMsg& in, EspNowResp& out, uint16_t live);
+  uint32_t tick(uint32_t nowMs);
+  // Samples every subscriber on the next tick (e.g. right after a local actuation).
+  void kick(uint32_t nowMs){ for(auto& s : subs_) if(s.used) s.dueMs = nowMs; }
+  Stats stats() const { return st_; }
+
+private:
+  struct Sub {
+    uint8_t  mac[6];
+    uint8_t  used;
+    uint8_t  decim;
+    uint8_t  count;       // samples since the last report
+    uint8_t  seq;
+    uint16_t periodMs;
+    uint16_t mask;
+    uint32_t dueMs;
+    uint32_t leaseMs;     // lapses at this time
+    uint8_t  last[16];    // pres bits seen at the previous sample
+  };
+  void push(Sub& s, const SensPairRec* recs, uint16_t ok, bool edge);
+
+  SampleFn sample_;
+  LuxFn    lux_;
+  void*    ctx_;
+  Sub      subs_[ESPNOW_SENS_SUBS_MAX]{};
+  Stats    st_{};
+};
+
+} // namespace espnow
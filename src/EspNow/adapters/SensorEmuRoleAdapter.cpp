@@ -1,32 +1,148 @@
 #include "SensorEmuRoleAdapter.h"
 #include "../Opcodes.h"
+#include "CommonOps.h"
+#include "VirtMux.h"
 #include <cstring>
 
+#include <Arduino.h>
+
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/SensorManager.h")
+  #include "../../Peripheral/SensorManager.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/BME280Manager.h")
+  #include "../../Peripheral/BME280Manager.h"
+#endif
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/VEML7700Manager.h")
+  #include "../../Peripheral/VEML7700Manager.h"
+#endif
+
 namespace espnow {
 
-bool SensorEmuRoleAdapter::handleRequest(const EspNowMsg& in, EspNowResp& out){
-  if(!S) return false;
-  // Emu payloads prepend {uint8_t idx}
-  if(in.payload_len < 1) return false;
-  uint8_t idx = in.payload[0];
-  const uint8_t* body = in.payload + 1;
-  uint16_t blen = in.payload_len - 1;
-  (void)idx; (void)body; (void)blen;
-  switch(in.type){
-    case GET_TFLUNA_RAW: {
-      struct { int16_t A_mm; int16_t B_mm; } resp{0,0};
-      std::memcpy(out.out,&resp,sizeof(resp)); out.out_len = sizeof(resp);
-      return true;
-    }
-    case GET_ENV: {
-      struct { float tempC; float hum; float press; } env{0,0,0};
-      std::memcpy(out.out,&env,sizeof(env)); out.out_len = sizeof(env);
-      return true;
-    }
-    case GET_LUX: {
-      uint32_t lux = 0; std::memcpy(out.out, &lux, 4); out.out_len = 4; return true;
-    }
-    default: return false;
+static_assert(ESPNOW_SEMU_VIRT_MAX <= 16, "virt mask is 16 bits");
+
+enum : uint8_t { DIR_NONE = 0, DIR_A_TO_B = 1, DIR_B_TO_A = 2 };   // SensorManager::Direction
+
+void SensorEmuRoleAdapter::feed(uint8_t v, uint16_t aMm, uint16_t bMm){
+  if(v >= ESPNOW_SEMU_VIRT_MAX) return;
+  bool a = aMm >= px_.nearMm[v] && aMm <= px_.farMm[v];
+  bool b = bMm >= px_.nearMm[v] && bMm <= px_.farMm[v];
+  uint8_t was = px_.pres[v];
+  uint8_t dir = was >> DIR_SHIFT;
+  if(!a && !b)                        dir = DIR_NONE;
+  else if(a && !(was & PRES_A) && !b) dir = DIR_A_TO_B;   // A broke first
+  else if(b && !(was & PRES_B) && !a) dir = DIR_B_TO_A;
+  px_.aMm[v] = aMm; px_.bMm[v] = bMm;
+  px_.pres[v] = uint8_t((a ? PRES_A : 0) | (b ? PRES_B : 0) | (dir << DIR_SHIFT));
+  observe(v);
+}
+
+void SensorEmuRoleAdapter::refresh(uint8_t v){
+  if(!S || !S->sensor || v >= ESPNOW_SEMU_VIRT_MAX) return;
+  glue::PairRead r{};
+  if(!glue::SensorPollPair<SensorManager>::poll(S->sensor, v, r)) return;
+  px_.aMm[v] = r.aMm; px_.bMm[v] = r.bMm;
+  px_.pres[v] = uint8_t((r.presentA ? PRES_A : 0) | (r.presentB ? PRES_B : 0) | (r.dir << DIR_SHIFT));
+  observe(v);
+}
+
+// Every new sample, fed or polled, goes past the lane rules first.
+void SensorEmuRoleAdapter::observe(uint8_t v){
+  if(rules_.observe(v, px_.pres[v])) stream_.kick(millis());
+}
+
+// Without a subscriber the rules still need the pairs polled every period.
+uint32_t SensorEmuRoleAdapter::tick(uint32_t nowMs){
+  rules_.sync();
+  uint32_t wait = stream_.tick(nowMs);
+  if(rules_.empty() || !S || !S->sensor) return wait;
+  if((int32_t)(nowMs - ruleDueMs_) >= 0){
+    for(uint8_t v = 0; v < ESPNOW_SEMU_VIRT_MAX; ++v) if(rules_.virtMask() & (1u << v)) refresh(v);
+    ruleDueMs_ = nowMs + ESPNOW_SENS_MIN_PERIOD_MS;
+  }
+  uint32_t next = ruleDueMs_ - nowMs;
+  return next < wait ? next : wait;
+}
+
+uint16_t SensorEmuRoleAdapter::luxNow(){
+  uint32_t lux = 0; if(S && S->veml) glue::LuxGet<VEML7700Manager>::get(S->veml, lux);
+  return lux > 0xFFFF ? uint16_t(0xFFFF) : uint16_t(lux);
+}
+
+static SensorEmuRoleAdapter& self_(IRoleAdapter& a){ return static_cast<SensorEmuRoleAdapter&>(a); }
+
+static bool getTflunaRaw(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_SEMU_VIRT_MAX), s)) return false;
+  auto& me = self_(a);
+  return virtGather(s, 4, out, [&](uint8_t v, uint8_t* d){
+    me.refresh(v);
+    std::memcpy(d, &me.pairs().aMm[v], 2); std::memcpy(d + 2, &me.pairs().bMm[v], 2);
+    return true;
+  });
+}
+
+static bool getPresence(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_SEMU_VIRT_MAX), s)) return false;
+  auto& me = self_(a);
+  return virtGather(s, 1, out, [&](uint8_t v, uint8_t* d){ me.refresh(v); *d = me.pairs().pres[v]; return true; });
+}
+
+// One BME/ALS is shared by every virtual; each record repeats it.
+static bool getEnv(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_SEMU_VIRT_MAX), s)) return false;
+  glue::EnvGet<BME280Manager>::Env env{0,0,0};
+  if(S && S->bme) glue::EnvGet<BME280Manager>::get(S->bme, env);
+  return virtGather(s, sizeof(env), out, [&](uint8_t, uint8_t* d){ std::memcpy(d, &env, sizeof(env)); return true; });
+}
+
+static bool getLux(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_SEMU_VIRT_MAX), s)) return false;
+  uint32_t lux = 0; if(S && S->veml) glue::LuxGet<VEML7700Manager>::get(S->veml, lux);
+  return virtGather(s, 4, out, [&](uint8_t, uint8_t* d){ std::memcpy(d, &lux, 4); return true; });
+}
+
+static bool pushConfig(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  VirtSel s; if(!virtSelect(in, virtCount(ESPNOW_SEMU_VIRT_MAX), s) || s.multi) return false;
+  if(s.len < SEMU_VIRT_CFG_BASE) return false;
+  auto& me = self_(a); auto& p = me.pairs(); uint8_t v = s.first();
+  SemuVirtCfg c{ 0, 0, 0, 0, p.leadMs[v], p.leadCt[v] };
+  std::memcpy(&c, s.body, s.len < sizeof(c) ? s.len : sizeof(c));
+  if(c.nearMm > c.farMm) return false;
+  p.nearMm[v] = c.nearMm; p.farMm[v] = c.farMm; p.spacingMm[v] = c.spacingMm; p.onMs[v] = c.onMs;
+  p.leadMs[v] = c.leadMs; p.leadCt[v] = c.leadCt;
+  me.applyWave(v);
+  out.out_len = 0; return true;
+}
+
+// No idx prefix: the subscription mask selects the virtual pairs.
+static bool sensSubscribe(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  uint8_t n = virtCount(ESPNOW_SEMU_VIRT_MAX);
+  return self_(a).stream().onSubscribe(in, out, n >= 16 ? uint16_t(0xFFFF) : uint16_t((1u << n) - 1));
+}
+
+// minLen counts the idx byte; the multi form is checked by virtSelect().
+static constexpr OpDef kSensorEmuOps[] = {
+  { GET_TFLUNA_RAW, 1, 4,  getTflunaRaw },
+  { GET_ENV,        1, 12, getEnv       },
+  { GET_LUX,        1, 4,  getLux       },
+  { GET_PRESENCE,   1, 1,  getPresence  },
+  { PUSH_CONFIG,    1 + SEMU_VIRT_CFG_BASE, 0, pushConfig },
+  { SENS_SUBSCRIBE, sizeof(SensSubReq), sizeof(SensSubResp), sensSubscribe },
+};
+static constexpr auto kSensorEmuTable = makeOpTable(kCommonOps, kSensorEmuOps);
+
+static bool sampleVirt(void* c, uint8_t v, SensPairRec& rec){
+  auto& me = *static_cast<SensorEmuRoleAdapter*>(c);
+  me.refresh(v);
+  rec = SensPairRec{ me.pairs().pres[v], me.pairs().aMm[v], me.pairs().bMm[v] };
+  return true;
+}
+
+SensorEmuRoleAdapter::SensorEmuRoleAdapter()
+  : ops_(kSensorEmuTable),
+    stream_(sampleVirt, [](void* c){ return static_cast<SensorEmuRoleAdapter*>(c)->luxNow(); }, this) {
+  for(uint8_t v = 0; v < ESPNOW_SEMU_VIRT_MAX; ++v){   // Config_SEMU.h defaults
+    px_.nearMm[v] = 200; px_.farMm[v] = 3200; px_.spacingMm[v] = 350; px_.onMs[v] = ESPNOW_WAVE_ON_MS;
+    px_.leadMs[v] = ESPNOW_WAVE_STEP_MS; px_.leadCt[v] = ESPNOW_WAVE_LEAD_CT;
   }
 }
 
@@ -1,14 +1,60 @@
 #pragma once
 #include "../IRoleAdapter.h"
+#include "OpTable.h"
+#include "SensStream.h"
+#include "LaneRules.h"
 
 namespace espnow {
 
+#pragma pack(push,1)
+// PUSH_CONFIG body after {idx}: one virtual sensor's thresholds. The wave
+// tail (leadMs, leadCt) is optional; a short body keeps the current values.
+struct SemuVirtCfg { uint16_t nearMm; uint16_t farMm; uint16_t spacingMm; uint16_t onMs; uint16_t leadMs; uint8_t leadCt; };
+enum : uint8_t { SEMU_VIRT_CFG_BASE = 8 };
+#pragma pack(pop)
+
 class SensorEmuRoleAdapter final : public IRoleAdapter {
 public:
+  enum : uint8_t { PRES_A = 0x01, PRES_B = 0x02, DIR_SHIFT = 2 };   // GET_PRESENCE bits
+
+  // Per-virtual state, one flat array per field, indexed by virt_id.
+  struct Pairs {
+    uint16_t aMm[ESPNOW_SEMU_VIRT_MAX];
+    uint16_t bMm[ESPNOW_SEMU_VIRT_MAX];
+    uint8_t  pres[ESPNOW_SEMU_VIRT_MAX];       // PRES_A | PRES_B | dir << DIR_SHIFT
+    uint16_t nearMm[ESPNOW_SEMU_VIRT_MAX];
+    uint16_t farMm[ESPNOW_SEMU_VIRT_MAX];
+    uint16_t spacingMm[ESPNOW_SEMU_VIRT_MAX];
+    uint16_t onMs[ESPNOW_SEMU_VIRT_MAX];
+    uint16_t leadMs[ESPNOW_SEMU_VIRT_MAX];     // wave step
+    uint8_t  leadCt[ESPNOW_SEMU_VIRT_MAX];     // relays lit ahead
+  };
+
+  SensorEmuRoleAdapter();
   void mount(const ServiceRefs* s) override { S = s; }
-  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override;
+  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override { return ops_.dispatch(*this, S, in, out); }
+  const OpStats* opStats(uint8_t type) const override { return ops_.stats(type); }
+  uint32_t tick(uint32_t nowMs) override;
+
+  // Synthetic or mirrored samples for virtual v (no TF-Luna behind it).
+  void feed(uint8_t v, uint16_t aMm, uint16_t bMm);
+  // Refreshes v from the SensorManager when one is mounted.
+  void refresh(uint8_t v);
+  Pairs& pairs() { return px_; }
+  uint16_t luxNow();
+  SensStream& stream() { return stream_; }
+  const LaneRules& rules() const { return rules_; }
+  // Pushes v's onMs/leadMs/leadCt into the lane rule defaults.
+  void applyWave(uint8_t v) { rules_.setDefaults(v, px_.leadCt[v], px_.leadMs[v], px_.onMs[v]); }
+
 private:
   const ServiceRefs* S = nullptr;
+  OpDispatcher ops_;
+  Pairs px_{};
+  SensStream stream_;
+  LaneRules  rules_;
+  uint32_t   ruleDueMs_{0};
+  void       observe(uint8_t v);
 };
 
 } // namespace espnow
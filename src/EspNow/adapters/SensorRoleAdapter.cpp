@@ -1,117 +1,101 @@
 #include "SensorRoleAdapter.h"
 #include "../Opcodes.h"
-#include "../TopologyTlv.h"
-#include "../EspNowCore.h"
 #include "CommonOps.h"
 #include <cstring>
 
-#if __has_include("../../Peripheral/SensorManager.h")
+#include <Arduino.h>
+
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/SensorManager.h")
   #include "../../Peripheral/SensorManager.h"
 #endif
-#if __has_include("../../Peripheral/TFLunaManager.h")
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/TFLunaManager.h")
   #include "../../Peripheral/TFLunaManager.h"
 #endif
-#if __has_include("../../Peripheral/BME280Manager.h")
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/BME280Manager.h")
   #include "../../Peripheral/BME280Manager.h"
 #endif
-#if __has_include("../../Peripheral/VEML7700Manager.h")
+#if !defined(ESPNOW_HOST_SIM) && __has_include("../../Peripheral/VEML7700Manager.h")
   #include "../../Peripheral/VEML7700Manager.h"
 #endif
-#if __has_include("../../Peripheral/DS18B20U.h")
-  #include "../../Peripheral/DS18B20U.h"
-#endif
-#if __has_include("../../Peripheral/CoolingManager.h")
-  #include "../../Peripheral/CoolingManager.h"
-#endif
-#if __has_include("../../Peripheral/BuzzerManager.h")
-  #include "../../Peripheral/BuzzerManager.h"
-#endif
-#if __has_include("../../Peripheral/RGBLed.h")
-  #include "../../Peripheral/RGBLed.h"
-#endif
-#if __has_include("../../Peripheral/RTCManager.h")
-  #include "../../Peripheral/RTCManager.h"
-#endif
-#if __has_include("../../Peripheral/LogFS.h")
-  #include "../../Peripheral/LogFS.h"
-#endif
 
 namespace espnow {
 
-struct LogsReq { uint32_t off; uint16_t max; } __attribute__((packed));
+static bool getTflunaRaw(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  if(!(S && S->tfluna)){ std::memset(out.out,0,4); out.out_len=4; return true; }
+  glue::TFLunaGet<TFLunaManager>::Raw raw{0,0};
+  glue::TFLunaGet<TFLunaManager>::get(S->tfluna, raw);
+  std::memcpy(out.out,&raw,sizeof(raw)); out.out_len=sizeof(raw); return true;
+}
 
-bool SensorRoleAdapter::handleRequest(const EspNowMsg& in, EspNowResp& out){
-  switch(in.type){
-    case GET_TEMP: {
-      float c=0;
-      if(S && S->ds18b20) { glue::TempReader<decltype(*S->ds18b20)>::read(S->ds18b20, c); }
-      std::memcpy(out.out, &c, sizeof(c)); out.out_len = sizeof(c); return true;
-    }
-    case GET_TIME: {
-      uint32_t t=0; if(S && S->rtc) glue::RtcGet<decltype(*S->rtc)>::get(S->rtc, t);
-      std::memcpy(out.out,&t,sizeof(t)); out.out_len=sizeof(t); return true;
-    }
-    case SET_TIME: {
-      if(in.payload_len < 4) return false;
-      uint32_t t; std::memcpy(&t, in.payload, 4);
-      bool ok = (S && S->rtc) ? glue::RtcSet<decltype(*S->rtc)>::set(S->rtc, t) : false;
-      out.out_len = 0; return ok;
-    }
-    case GET_FAN_MODE: {
-      uint8_t m=0; if(S && S->cooling) glue::CoolingGet<decltype(*S->cooling)>::get(S->cooling, m);
-      out.out[0]=m; out.out_len=1; return true;
-    }
-    case SET_FAN_MODE: {
-      if(in.payload_len<1) return false;
-      uint8_t m=in.payload[0];
-      bool ok = (S && S->cooling) ? glue::CoolingSet<decltype(*S->cooling)>::set(S->cooling, m) : false;
-      out.out_len=0; return ok;
-    }
-    case BUZZ_PING: {
-      bool ok = (S && S->buzzer) ? glue::BuzzerPing<decltype(*S->buzzer)>::go(S->buzzer) : false;
-      out.out_len=0; return ok;
-    }
-    case LED_PING: {
-      bool ok = (S && S->rgb) ? glue::LedPing<decltype(*S->rgb)>::go(S->rgb) : false;
-      out.out_len=0; return ok;
-    }
-    case GET_LOGS: {
-      if(!S || !S->logs || in.payload_len < sizeof(LogsReq)) return false;
-      LogsReq r{}; std::memcpy(&r, in.payload, sizeof(r));
-      size_t n = glue::LogRead<decltype(*S->logs)>::read(S->logs, r.off, out.out, r.max);
-      out.out_len = (uint16_t)n; return true;
-    }
-    case GET_TOPOLOGY: {
-      auto* core = EspNowCore::instance();
-      if(!core) return false;
-      std::vector<uint8_t> tlv; core->exportLocalTopology(tlv);
-      if(tlv.size() > 256) return false;
-      std::memcpy(out.out, tlv.data(), tlv.size()); out.out_len = (uint16_t)tlv.size();
-      return true;
-    }
+static bool getEnv(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  glue::EnvGet<BME280Manager>::Env env{0,0,0};
+  if(S && S->bme) glue::EnvGet<BME280Manager>::get(S->bme, env);
+  std::memcpy(out.out,&env,sizeof(env)); out.out_len=sizeof(env); return true;
+}
+
+static bool getLux(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg&, EspNowResp& out){
+  uint32_t lux=0; if(S && S->veml) glue::LuxGet<VEML7700Manager>::get(S->veml,lux);
+  std::memcpy(out.out,&lux,4); out.out_len=4; return true;
+}
 
-    case GET_TFLUNA_RAW: {
-      if(!(S && S->tfluna)){ std::memset(out.out,0,4); out.out_len=4; return true; }
-      typename glue::TFLunaGet<decltype(*S->tfluna)>::Raw raw{0,0};
-      glue::TFLunaGet<decltype(*S->tfluna)>::get(S->tfluna, raw);
-      std::memcpy(out.out,&raw,sizeof(raw)); out.out_len=sizeof(raw); return true;
-    }
-    case GET_ENV: {
-      typename glue::EnvGet<decltype(*S->bme)>::Env env{0,0,0};
-      if(S && S->bme) glue::EnvGet<decltype(*S->bme)>::get(S->bme, env);
-      std::memcpy(out.out,&env,sizeof(env)); out.out_len=sizeof(env); return true;
-    }
-    case GET_LUX: {
-      uint32_t lux=0; if(S && S->veml) glue::LuxGet<decltype(*S->veml)>::get(S->veml,lux);
-      std::memcpy(out.out,&lux,4); out.out_len=4; return true;
-    }
-    case SET_THRESHOLDS: {
-      bool ok = (S && S->sensor) ? glue::SensorSetThresh<decltype(*S->sensor)>::set(S->sensor, in.payload, in.payload_len) : false;
-      out.out_len=0; return ok;
-    }
+// Same bit layout as the SEMU record (SensorEmuRoleAdapter::PRES_*).
+bool SensorRoleAdapter::samplePair(SensPairRec& rec){
+  glue::PairRead r{};
+  if(!S || !S->sensor || !glue::SensorPollPair<SensorManager>::poll(S->sensor, 0, r)) return false;
+  rec.pres = uint8_t((r.presentA ? 0x01 : 0) | (r.presentB ? 0x02 : 0) | (r.dir << 2));
+  rec.aMm = r.aMm; rec.bMm = r.bMm;
+  lastSampleMs_ = millis();
+  if(rules_.observe(0, rec.pres)) stream_.kick(lastSampleMs_);
+  return true;
+}
 
-    default: return false;
+// Lane rules need a sample every period even with no subscriber; a pass the
+// stream already made counts.
+uint32_t SensorRoleAdapter::tick(uint32_t nowMs){
+  rules_.sync();
+  uint32_t wait = stream_.tick(nowMs);
+  if(rules_.empty()) return wait;
+  if(nowMs - lastSampleMs_ >= ESPNOW_SENS_MIN_PERIOD_MS){
+    SensPairRec rec;
+    if(!samplePair(rec)) lastSampleMs_ = nowMs;
   }
+  uint32_t next = lastSampleMs_ + ESPNOW_SENS_MIN_PERIOD_MS - nowMs;
+  return next < wait ? next : wait;
+}
+
+uint16_t SensorRoleAdapter::luxNow(){
+  uint32_t lux = 0; if(S && S->veml) glue::LuxGet<VEML7700Manager>::get(S->veml, lux);
+  return lux > 0xFFFF ? uint16_t(0xFFFF) : uint16_t(lux);
 }
 
+static bool getPresence(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg&, EspNowResp& out){
+  SensPairRec rec{};
+  static_cast<SensorRoleAdapter&>(a).samplePair(rec);
+  out.out[0] = rec.pres; out.out_len = 1; return true;
+}
+
+static bool sensSubscribe(IRoleAdapter& a, const ServiceRefs*, const EspNowMsg& in, EspNowResp& out){
+  return static_cast<SensorRoleAdapter&>(a).stream().onSubscribe(in, out, 0x0001);
+}
+
+static bool setThresholds(IRoleAdapter&, const ServiceRefs* S, const EspNowMsg& in, EspNowResp& out){
+  out.out_len=0;
+  return S && S->sensor && glue::SensorSetThresh<SensorManager>::set(S->sensor, in.payload, in.payload_len);
+}
+
+static constexpr OpDef kSensorOps[] = {
+  { GET_TFLUNA_RAW, 0, 4,  getTflunaRaw  },
+  { GET_ENV,        0, 12, getEnv        },
+  { GET_LUX,        0, 4,  getLux        },
+  { SET_THRESHOLDS, 0, 0,  setThresholds },
+  { GET_PRESENCE,   0, 1,  getPresence   },
+  { SENS_SUBSCRIBE, sizeof(SensSubReq), sizeof(SensSubResp), sensSubscribe },
+};
+static constexpr auto kSensorTable = makeOpTable(kCommonOps, kSensorOps);
+
+SensorRoleAdapter::SensorRoleAdapter()
+  : ops_(kSensorTable),
+    stream_([](void* c, uint8_t, SensPairRec& r){ return static_cast<SensorRoleAdapter*>(c)->samplePair(r); },
+            [](void* c){ return static_cast<SensorRoleAdapter*>(c)->luxNow(); }, this) {}
+
 } // namespace espnow
@@ -1,14 +1,29 @@
 #pragma once
 #include "../IRoleAdapter.h"
+#include "OpTable.h"
+#include "SensStream.h"
+#include "LaneRules.h"
 
 namespace espnow {
 
 class SensorRoleAdapter final : public IRoleAdapter {
 public:
+  SensorRoleAdapter();
   void mount(const ServiceRefs* s) override { S = s; }
-  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override;
+  bool handleRequest(const EspNowMsg& in, EspNowResp& out) override { return ops_.dispatch(*this, S, in, out); }
+  const OpStats* opStats(uint8_t type) const override { return ops_.stats(type); }
+  uint32_t tick(uint32_t nowMs) override;
+
+  bool samplePair(SensPairRec& rec);
+  uint16_t luxNow();
+  SensStream& stream() { return stream_; }
+  const LaneRules& rules() const { return rules_; }
 private:
   const ServiceRefs* S = nullptr;
+  OpDispatcher ops_;
+  SensStream stream_;
+  LaneRules  rules_;
+  uint32_t   lastSampleMs_{0};
 };
 
 } // namespace espnow
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "../Frame.h"
+#include "../EspNowCore.h"
+
+namespace espnow {
+
+// Emulator bodies start with {uint8_t idx}. idx 0..count-1 picks one virtual;
+// VIRT_MULTI is followed by a u16 mask (bit v = virtual v) and reads several
+// virtuals in one frame.
+enum : uint8_t { VIRT_MULTI = 0xFE };
+
+#pragma pack(push,1)
+struct VirtMultiReq { uint8_t idx; uint16_t mask; };
+#pragma pack(pop)
+
+// Decoded address: the selected virtuals and the body after the prefix.
+struct VirtSel {
+  uint16_t       mask  = 0;
+  bool           multi = false;
+  const uint8_t* body  = nullptr;
+  uint16_t       len   = 0;
+  uint8_t first() const { uint8_t v = 0; while(v < 15 && !(mask & (1u << v))) ++v; return v; }
+};
+
+// Live virtual count: the topology emuCount, capped by the adapter's arrays.
+inline uint8_t virtCount(uint8_t max){
+  auto* core = EspNowCore::instance();
+  uint8_t n = core ? core->getLocalTopology().emuCount : 0;
+  return (n && n < max) ? n : max;
+}
+
+// false when idx is out of range or the mask selects nothing live.
+inline bool virtSelect(const EspNowMsg& in, uint8_t count, VirtSel& s){
+  if(in.payload_len < 1) return false;
+  uint8_t idx = in.payload[0];
+  if(idx == VIRT_MULTI){
+    if(in.payload_len < sizeof(VirtMultiReq)) return false;
+    VirtMultiReq r; std::memcpy(&r, in.payload, sizeof(r));
+    uint16_t live = count >= 16 ? 0xFFFFu : uint16_t((1u << count) - 1);
+    s.mask = r.mask & live; s.multi = true;
+    s.body = in.payload + sizeof(r); s.len = uint16_t(in.payload_len - sizeof(r));
+    return s.mask != 0;
+  }
+  if(idx >= count) return false;
+  s.mask = uint16_t(1u << idx); s.multi = false;
+  s.body = in.payload + 1; s.len = uint16_t(in.payload_len - 1);
+  return true;
+}
+
+// One rec-byte record per selected virtual, written by fill(v, dst).
+// A single virtual answers with the bare record (same layout as production);
+// a multi read answers {u16 served mask} then the records in ascending order,
+// stopping at the last record that fits.
+template<typename F>
+inline bool virtGather(const VirtSel& s, uint16_t rec, EspNowResp& out, F&& fill){
+  if(!s.multi){
+    if(out.out_cap < rec || !fill(s.first(), out.out)) return false;
+    out.out_len = rec; return true;
+  }
+  if(out.out_cap < 2 + rec) return false;
+  uint16_t served = 0, n = 2;
+  for(uint8_t v = 0; v < 16; ++v){
+    if(!(s.mask & (1u << v))) continue;
+    if(n + rec > out.out_cap) break;
+    if(!fill(v, out.out + n)) continue;
+    served |= uint16_t(1u << v); n += rec;
+  }
+  std::memcpy(out.out, &served, 2);
+  out.out_len = n;
+  return served != 0;
+}
+
+} // namespace espnow
@@ -0,0 +1,111 @@
+#include "WaveSeq.h"
+#include <freertos/task.h>
+
+namespace espnow {
+
+static_assert(ESPNOW_SENS_RULE_ACTS_MAX <= 32, "WaveSeq keeps one bit per relay");
+
+WaveSeq::~WaveSeq(){
+  if(timer_){ esp_timer_stop(timer_); esp_timer_delete(timer_); }
+}
+
+void WaveSeq::trigger(uint8_t first, uint8_t count, uint16_t stepMs, uint16_t onMs,
+                      uint8_t cancelFirst, uint8_t cancelCount){
+  if(!timer_){
+    esp_timer_create_args_t a{};
+    a.callback = &WaveSeq::onTimer; a.arg = this; a.dispatch_method = ESP_TIMER_TASK; a.name = "wave";
+    if(esp_timer_create(&a, &timer_) != ESP_OK) timer_ = nullptr;
+  }
+  int64_t t0 = esp_timer_get_time();
+  portENTER_CRITICAL(&mux_);
+  st_.waves++;
+  for(uint8_t i = cancelFirst; i < cancelFirst + cancelCount && i < ESPNOW_SENS_RULE_ACTS_MAX; ++i){
+    if(lit_ & (1u << i) || !onAt_[i]) continue;
+    onAt_[i] = offAt_[i] = 0; pending_ &= ~(1u << i); st_.cancelled++;
+  }
+  for(uint8_t k = 0; k < count && first + k < ESPNOW_SENS_RULE_ACTS_MAX; ++k){
+    uint8_t i = uint8_t(first + k);
+    int64_t on  = t0 + int64_t(k) * stepMs * 1000;
+    int64_t off = on + int64_t(onMs) * 1000;
+    if(lit_ & (1u << i)){
+      if(off > offAt_[i]){ offAt_[i] = off; st_.extended++; }
+    }else{
+      if(!onAt_[i] || on < onAt_[i]) onAt_[i] = on;
+      if(off > offAt_[i]) offAt_[i] = off;
+    }
+    pending_ |= 1u << i;
+  }
+  portEXIT_CRITICAL(&mux_);
+  run(false);     // steps due at t0 go out now, not one timer hop later
+}
+
+// Waits out a timer pass already sending, so on return no send_() is in
+// flight on the esp_timer task and none will start until the next trigger().
+void WaveSeq::reset(){
+  uint32_t lit;
+  for(;;){
+    portENTER_CRITICAL(&mux_);
+    if(!running_) break;
+    portEXIT_CRITICAL(&mux_);
+    taskYIELD();
+  }
+  lit = lit_;
+  lit_ = 0; pending_ = 0;
+  for(uint8_t i = 0; i < ESPNOW_SENS_RULE_ACTS_MAX; ++i) onAt_[i] = offAt_[i] = 0;
+  st_.steps += __builtin_popcount(lit);
+  portEXIT_CRITICAL(&mux_);
+  if(timer_) esp_timer_stop(timer_);
+  for(uint8_t i = 0; i < ESPNOW_SENS_RULE_ACTS_MAX; ++i) if(lit & (1u << i)) send_(ctx_, i, false);
+}
+
+WaveSeq::Stats WaveSeq::stats() const {
+  portENTER_CRITICAL(&mux_);
+  Stats s = st_;
+  portEXIT_CRITICAL(&mux_);
+  return s;
+}
+
+void WaveSeq::onTimer(void* arg){ static_cast<WaveSeq*>(arg)->run(true); }
+
+// State moves under the lock; frames go out after it, counted in running_
+// so reset() can wait for them (the timer and a trigger() may overlap).
+void WaveSeq::run(bool fromTimer){
+  uint32_t on = 0, off = 0;
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&mux_);
+  running_++;
+  for(uint8_t i = 0; i < ESPNOW_SENS_RULE_ACTS_MAX; ++i){
+    if(!(pending_ & (1u << i))) continue;
+    int64_t due = 0;
+    if(onAt_[i] && onAt_[i] <= now){ due = onAt_[i]; onAt_[i] = 0; lit_ |= 1u << i; on |= 1u << i; }
+    else if(!onAt_[i] && offAt_[i] && offAt_[i] <= now){ due = offAt_[i]; offAt_[i] = 0; lit_ &= ~(1u << i); off |= 1u << i; }
+    if(!onAt_[i] && !offAt_[i]) pending_ &= ~(1u << i);
+    if(due && fromTimer && uint32_t(now - due) > st_.maxLateUs) st_.maxLateUs = uint32_t(now - due);
+  }
+  st_.steps += __builtin_popcount(on) + __builtin_popcount(off);
+  portEXIT_CRITICAL(&mux_);
+  for(uint8_t i = 0; i < ESPNOW_SENS_RULE_ACTS_MAX; ++i){
+    if(on  & (1u << i)) send_(ctx_, i, true);
+    if(off & (1u << i)) send_(ctx_, i, false);
+  }
+  arm(now);
+  portENTER_CRITICAL(&mux_);
+  running_--;
+  portEXIT_CRITICAL(&mux_);
+}
+
+void WaveSeq::arm(int64_t nowUs){
+  if(!timer_) return;
+  int64_t next = 0;
+  portENTER_CRITICAL(&mux_);
+  for(uint8_t i = 0; i < ESPNOW_SENS_RULE_ACTS_MAX; ++i){
+    if(!(pending_ & (1u << i))) continue;
+    int64_t t = onAt_[i] ? onAt_[i] : offAt_[i];
+    if(!next || t < next) next = t;
+  }
+  portEXIT_CRITICAL(&mux_);
+  esp_timer_stop(timer_);
+  if(next) esp_timer_start_once(timer_, next > nowUs ? uint64_t(next - nowUs) : 0);
+}
+
+} // namespace espnow
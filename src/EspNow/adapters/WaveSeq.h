@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include "../../Config/EspNowConfig.h"
+
+namespace espnow {
+
+// Relay "wave" ahead of a car: relay i of a run goes on at t0 + i*step and off
+// onMs later. trigger() turns the event into absolute on/off times per relay
+// up front; a one-shot esp_timer then walks them, so steps land with the
+// timer's microsecond resolution instead of RTOS tick granularity.
+//
+// Relays are the caller's action indices (< ESPNOW_SENS_RULE_ACTS_MAX); send()
+// switches one. A retrigger extends relays already lit and merges the rest;
+// the cancel range drops relays not yet lit (e.g. the opposite direction).
+class WaveSeq {
+public:
+  using SendFn = void(*)(void* ctx, uint8_t act, bool on);
+
+  struct Stats {
+    uint32_t waves;       // trigger() calls
+    uint32_t steps;       // on/off actions sent
+    uint32_t extended;    // lit relays whose off time moved later
+    uint32_t cancelled;   // pending relays dropped by a cancel range
+    uint32_t maxLateUs;   // worst timer step lateness seen
+  };
+
+  WaveSeq(SendFn send, void* ctx) : send_(send), ctx_(ctx) {}
+  ~WaveSeq();
+
+  void trigger(uint8_t first, uint8_t count, uint16_t stepMs, uint16_t onMs,
+               uint8_t cancelFirst = 0, uint8_t cancelCount = 0);
+  void reset();           // lit relays off now, nothing pending or sending
+  bool idle() const { return !pending_ && !lit_; }
+  Stats stats() const;
+
+private:
+  static void onTimer(void* arg);
+  void run(bool fromTimer);
+  void arm(int64_t nowUs);
+
+  SendFn   send_;
+  void*    ctx_;
+  esp_timer_handle_t timer_{nullptr};
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+  int64_t  onAt_[ESPNOW_SENS_RULE_ACTS_MAX]{};    // 0 = no pending on
+  int64_t  offAt_[ESPNOW_SENS_RULE_ACTS_MAX]{};   // 0 = no pending off
+  uint32_t lit_{0};
+  uint32_t pending_{0};   // bit per relay with onAt_ or offAt_ set
+  uint8_t  running_{0};       // run() calls between taking steps and arming
+  Stats    st_{};             // under mux_: run() and reset() share it
+};
+
+} // namespace espnow
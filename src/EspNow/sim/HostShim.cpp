@@ -0,0 +1,146 @@
+#ifdef ESPNOW_HOST_SIM
+// Definitions behind sim/host/*.h for the host simulation.
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_ota_ops.h>
+#include <esp_system.h>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include "VirtualBus.h"
+
+struct esp_timer {
+  esp_timer_cb_t      cb;
+  void*               arg;
+  uint64_t            dueUs;
+  bool                armed;
+  espnow::EspNowCore* owner;     // node current when it was started
+};
+
+namespace espnow { namespace sim {
+
+static uint32_t g_rand = 1;
+void seedRandom(uint32_t seed){ g_rand = seed ? seed : 1; }
+
+static std::vector<esp_timer*> g_timers;
+
+uint64_t nextTimerUs(){
+  uint64_t next = UINT64_MAX;
+  for(auto* t : g_timers) if(t->armed && t->dueUs < next) next = t->dueUs;
+  return next;
+}
+
+// Earliest first; a callback may start timers again, due now or later.
+void fireTimers(uint64_t nowUs){
+  for(;;){
+    esp_timer* due = nullptr;
+    for(auto* t : g_timers) if(t->armed && t->dueUs <= nowUs && (!due || t->dueUs < due->dueUs)) due = t;
+    if(!due) return;
+    due->armed = false;
+    EspNowCore::setInstance(due->owner);
+    due->cb(due->arg);
+  }
+}
+
+static std::map<const EspNowCore*, OtaSlot> g_ota;
+static esp_partition_t g_part{ 0x110000, 0x180000, "ota_0" };
+
+const OtaSlot& otaSlot(const EspNowCore* node){ return g_ota[node]; }
+void setOtaPartition(uint32_t bytes){ g_part.size = bytes; }
+
+}} // namespace espnow::sim
+
+uint32_t millis(){ return (uint32_t)(espnow::sim::clockUs() / 1000u); }
+uint32_t micros(){ return (uint32_t)espnow::sim::clockUs(); }
+
+uint32_t esp_random(){
+  uint32_t& r = espnow::sim::g_rand;
+  r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+  return r;
+}
+esp_err_t esp_timer_create(const esp_timer_create_args_t* a, esp_timer_handle_t* out){
+  auto* t = new esp_timer{ a->callback, a->arg, 0, false, nullptr };
+  espnow::sim::g_timers.push_back(t);
+  *out = t;
+  return ESP_OK;
+}
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t us){
+  if(t->armed) return ESP_ERR_INVALID_STATE;
+  t->dueUs = espnow::sim::clockUs() + us; t->armed = true; t->owner = espnow::EspNowCore::instance();
+  return ESP_OK;
+}
+esp_err_t esp_timer_stop(esp_timer_handle_t t){
+  if(!t->armed) return ESP_ERR_INVALID_STATE;
+  t->armed = false;
+  return ESP_OK;
+}
+esp_err_t esp_timer_delete(esp_timer_handle_t t){
+  auto& v = espnow::sim::g_timers;
+  for(size_t i = 0; i < v.size(); ++i) if(v[i] == t){ v.erase(v.begin() + i); break; }
+  delete t;
+  return ESP_OK;
+}
+int64_t esp_timer_get_time(){ return espnow::sim::localUs(); }
+
+// Handles index the nodes that opened them; one open image per node, as with one spare slot.
+static std::vector<const espnow::EspNowCore*> g_otaHandles;
+static espnow::sim::OtaSlot* otaOf(esp_ota_handle_t h){
+  if(!h || h > g_otaHandles.size()) return nullptr;
+  auto& s = espnow::sim::g_ota[g_otaHandles[h - 1]];
+  return s.open ? &s : nullptr;
+}
+
+void espnow::sim::resetOta(){ g_ota.clear(); g_otaHandles.clear(); }
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t*){
+  return espnow::sim::g_part.size ? &espnow::sim::g_part : nullptr;
+}
+esp_err_t esp_ota_begin(const esp_partition_t* p, size_t size, esp_ota_handle_t* out){
+  if(!p) return ESP_ERR_INVALID_ARG;
+  if(size != OTA_SIZE_UNKNOWN && size != OTA_WITH_SEQUENTIAL_WRITES && size > p->size) return ESP_ERR_INVALID_SIZE;
+  auto* node = espnow::EspNowCore::instance();
+  auto& s = espnow::sim::g_ota[node];
+  s.image.clear(); s.open = true; s.boot = false;
+  g_otaHandles.push_back(node);
+  *out = esp_ota_handle_t(g_otaHandles.size());
+  return ESP_OK;
+}
+esp_err_t esp_ota_write(esp_ota_handle_t h, const void* data, size_t size){
+  auto* s = otaOf(h);
+  if(!s) return ESP_ERR_INVALID_ARG;
+  if(s->image.size() + size > espnow::sim::g_part.size) return ESP_ERR_INVALID_SIZE;
+  auto* p = static_cast<const uint8_t*>(data);
+  s->image.insert(s->image.end(), p, p + size);
+  return ESP_OK;
+}
+esp_err_t esp_ota_end(esp_ota_handle_t h){
+  auto* s = otaOf(h);
+  if(!s) return ESP_ERR_INVALID_ARG;
+  s->open = false;
+  return s->image.empty() ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+esp_err_t esp_ota_abort(esp_ota_handle_t h){
+  auto* s = otaOf(h);
+  if(!s) return ESP_ERR_INVALID_ARG;
+  s->open = false; s->image.clear();
+  return ESP_OK;
+}
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* p){
+  if(!p) return ESP_ERR_INVALID_ARG;
+  espnow::sim::g_ota[espnow::EspNowCore::instance()].boot = true;
+  return ESP_OK;
+}
+void esp_restart(){ espnow::sim::g_ota[espnow::EspNowCore::instance()].restarts++; }
+
+int esp_read_mac(uint8_t* mac, esp_mac_type_t){ std::memset(mac, 0, 6); return 0; }
+
+void* heap_caps_malloc(size_t size, uint32_t){ return std::malloc(size); }
+void* heap_caps_calloc(size_t n, size_t size, uint32_t){ return std::calloc(n, size); }
+void  heap_caps_free(void* p){ std::free(p); }
+
+BaseType_t   xTaskNotify(TaskHandle_t, uint32_t, eNotifyAction){ return pdPASS; }
+BaseType_t   xTaskNotifyGive(TaskHandle_t){ return pdPASS; }
+uint32_t     ulTaskNotifyTake(BaseType_t, TickType_t){ return 0; }
+TaskHandle_t xTaskGetCurrentTaskHandle(){ return nullptr; }
+TickType_t   xTaskGetTickCount(){ return millis(); }
+#endif // ESPNOW_HOST_SIM
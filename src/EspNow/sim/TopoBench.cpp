@@ -0,0 +1,131 @@
+#ifdef ESPNOW_HOST_SIM
+#include "TopoBench.h"
+#include "../TopologyTlv.h"
+#include "../Profile.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace espnow { namespace sim {
+
+// The codec as it stood before the streaming one, kept as the reference.
+static void legacyEncode(const Topology& t, std::vector<uint8_t>& out){
+  auto len = [&](uint16_t L){ if(L < 0xFF){ out.push_back(uint8_t(L)); return; }
+                              out.push_back(0xFF); out.push_back(uint8_t(L)); out.push_back(uint8_t(L>>8)); };
+  out.clear();
+  out.push_back(0x02); out.push_back(1); out.push_back(t.role);
+  out.push_back(0x01); out.push_back(32); for(int i=0;i<32;++i) out.push_back(uint8_t(t.token[i]));
+  if(!t.neighbors.empty()){
+    out.push_back(0x03); len((uint16_t)(t.neighbors.size()*6));
+    for(auto& m: t.neighbors) for(int i=0;i<6;++i) out.push_back(m[i]);
+  }
+  if(!t.roleParams.empty()){
+    out.push_back(0x04); len((uint16_t)t.roleParams.size());
+    out.insert(out.end(), t.roleParams.begin(), t.roleParams.end());
+  }
+  if(t.emuCount){ out.push_back(0x05); out.push_back(1); out.push_back(t.emuCount); }
+}
+
+static bool legacyDecode(const uint8_t* tlv, uint16_t len, Topology& out){
+  out = Topology{};
+  const uint8_t* p = tlv;
+  const uint8_t* e = tlv + len;
+  while(p+2 <= e){
+    uint8_t t = p[0]; uint16_t L = p[1]; p+=2;
+    if(L==0xFF){ if(p+2>e) return false; L = uint16_t(p[0] | (p[1]<<8)); p+=2; }
+    if(p+L>e) return false;
+    switch(t){
+      case 0x02: if(L>=1) out.role = p[0]; break;
+      case 0x01: if(L>=32) std::memcpy(out.token, p, 32); break;
+      case 0x03: for(uint16_t i=0;i+6<=L;i+=6){ std::array<uint8_t,6> m; std::memcpy(m.data(), p+i, 6); out.neighbors.push_back(m); } break;
+      case 0x04: out.roleParams.assign(p, p+L); break;
+      case 0x05: if(L>=1) out.emuCount = p[0]; break;
+    }
+    p += L;
+  }
+  return true;
+}
+
+namespace {
+struct Counter : TopoVisitor {
+  uint32_t macs = 0, params = 0;
+  void neighbor(const uint8_t*) override { macs++; }
+  void roleParams(const uint8_t*, uint16_t n) override { params += n; }
+};
+
+template<typename F>
+uint32_t timeNs(uint32_t iters, F&& fn){
+  auto t0 = std::chrono::steady_clock::now();
+  for(uint32_t i=0;i<iters;++i) fn();
+  auto dt = std::chrono::steady_clock::now() - t0;
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count() / (iters ? iters : 1));
+}
+
+// Counted by the profiler's operator new, in a pass of its own so timing stays clean.
+template<typename F>
+uint32_t allocs(uint32_t iters, F&& fn){
+#if ESPNOW_PROFILE
+  DispatchProfiler p;
+  { DispatchProfiler::Scope s(p, 0); for(uint32_t i=0;i<iters;++i) fn(); }
+  const OpProfile* o = p.find(0);
+  return o ? o->allocs : 0;
+#else
+  (void)iters; (void)fn;
+  return OpProfile::NO_LIMIT;
+#endif
+}
+} // namespace
+
+TopoBenchResult benchTopology(uint16_t neighbors, uint16_t paramBytes, uint32_t iters){
+  TopoBenchResult r{};
+  Topology t;
+  t.role = RC_SENSOR;
+  std::memset(t.token, 'k', sizeof(t.token));
+  for(uint16_t i=0;i<neighbors;++i) t.neighbors.push_back({ 0x24, 0x6F, 0x28, uint8_t(i>>8), uint8_t(i), 0x01 });
+  for(uint16_t i=0;i<paramBytes;++i) t.roleParams.push_back(uint8_t(i * 7));
+
+  // TopologyFixed is large; keep it off the stack like a firmware static would be.
+  std::unique_ptr<TopologyFixed> fx(new TopologyFixed());
+  std::vector<uint8_t> tlv, legacy;
+  topoEncode(t, tlv);
+  legacyEncode(t, legacy);
+  topoDecode(tlv.data(), (uint16_t)tlv.size(), *fx);
+  r.tlvBytes = tlv.size();
+  std::vector<uint8_t> span(tlv.size()), v2;
+  topoEncode(t, v2, TOPO_TLV_V2);
+  r.tlvBytesV2 = v2.size();
+
+  r.legacyEncodeNs = timeNs(iters, [&]{ std::vector<uint8_t> v; legacyEncode(t, v); });
+  r.vectorEncodeNs = timeNs(iters, [&]{ topoEncode(t, tlv); });
+  r.spanEncodeNs   = timeNs(iters, [&]{ topoEncode(*fx, span.data(), span.size()); });
+
+  const uint8_t* b = tlv.data();
+  uint16_t n = (uint16_t)tlv.size();
+  Topology reuse;
+  Counter c;
+  r.legacyDecodeNs = timeNs(iters, [&]{ Topology o; legacyDecode(b, n, o); });
+  r.vectorDecodeNs = timeNs(iters, [&]{ topoDecode(b, n, reuse); });
+  r.fixedDecodeNs  = timeNs(iters, [&]{ topoDecode(b, n, *fx); });
+  r.visitNs        = timeNs(iters, [&]{ topoVisit(b, n, c); });
+  Topology fromV2;
+  r.v2DecodeNs     = timeNs(iters, [&]{ topoDecode(v2.data(), (uint16_t)v2.size(), fromV2); });
+
+  r.spanEncodeAllocs  = allocs(iters, [&]{ topoEncode(*fx, span.data(), span.size()); });
+  r.fixedDecodeAllocs = allocs(iters, [&]{ topoDecode(b, n, *fx); });
+  Counter c2;                                   // c keeps the timed pass count
+  r.visitAllocs       = allocs(iters, [&]{ topoVisit(b, n, c2); });
+
+  Topology back;
+  legacyDecode(span.data(), (uint16_t)span.size(), back);
+  r.roundTrip = legacy == tlv && span == tlv
+             && back.neighbors == t.neighbors && back.roleParams == t.roleParams
+             && reuse.neighbors == t.neighbors && fx->neighborCount == neighbors
+             && fromV2.neighbors == t.neighbors && fromV2.roleParams == t.roleParams
+             && c.macs == (uint64_t)neighbors * iters;
+  return r;
+}
+
+}} // namespace espnow::sim
+#endif // ESPNOW_HOST_SIM
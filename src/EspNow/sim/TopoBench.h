@@ -0,0 +1,36 @@
+#pragma once
+#ifdef ESPNOW_HOST_SIM
+#include <cstdint>
+#include <cstddef>
+
+namespace espnow { namespace sim {
+
+// Host benchmark of the topology codecs on a synthetic lane: `neighbors` MACs
+// and `paramBytes` of role params, each codec run `iters` times. Times are
+// steady_clock ns per call, averaged.
+//
+//   TopoBenchResult r = benchTopology(60, 128, 20000);
+//   printf("legacy %u  vector %u  fixed %u  visit %u\n",
+//          r.legacyDecodeNs, r.vectorDecodeNs, r.fixedDecodeNs, r.visitNs);
+struct TopoBenchResult {
+  size_t   tlvBytes;
+  size_t   tlvBytesV2;       // same content, compact framing (TOPO_TLV_V2)
+  uint32_t legacyEncodeNs;   // push_back-per-byte encoder this codec replaced
+  uint32_t vectorEncodeNs;   // topoEncode(Topology, std::vector&), buffer reused
+  uint32_t spanEncodeNs;     // topoEncode(TopologyFixed, buf, cap)
+  uint32_t legacyDecodeNs;   // fresh Topology, one push_back per neighbour
+  uint32_t vectorDecodeNs;   // topoDecode(…, Topology&), capacity reused
+  uint32_t fixedDecodeNs;    // topoDecode(…, TopologyFixed&)
+  uint32_t visitNs;          // topoVisit() with a visitor that only counts
+  uint32_t v2DecodeNs;       // topoDecode(V2 blob, Topology&), capacity reused
+  // operator new calls over all iters (ESPNOW_PROFILE; OpProfile::NO_LIMIT without it)
+  uint32_t spanEncodeAllocs;
+  uint32_t fixedDecodeAllocs;
+  uint32_t visitAllocs;
+  bool     roundTrip;        // every codec agreed on the content
+};
+
+TopoBenchResult benchTopology(uint16_t neighbors, uint16_t paramBytes, uint32_t iters);
+
+}} // namespace espnow::sim
+#endif // ESPNOW_HOST_SIM
@@ -0,0 +1,199 @@
+#ifdef ESPNOW_HOST_SIM
+#include "VirtualBus.h"
+
+#include <cstring>
+
+namespace espnow { namespace sim {
+
+static uint64_t g_clockUs = 0;
+uint64_t clockUs(){ return g_clockUs; }
+
+struct NodeClock { const EspNowCore* core; int64_t offsetUs; int32_t ppm; };
+static std::vector<NodeClock> g_nodeClocks;
+
+int64_t localUs(){
+  const EspNowCore* c = EspNowCore::instance();
+  for(auto& k : g_nodeClocks)
+    if(k.core == c) return (int64_t)g_clockUs + k.offsetUs + (int64_t)g_clockUs * k.ppm / 1000000;
+  return (int64_t)g_clockUs;
+}
+
+void SimRadio::localMac(uint8_t mac[6]) const { std::memcpy(mac, bus_->mac(node_), 6); }
+
+RadioErr SimRadio::send(const uint8_t mac[6], const uint8_t* data, uint16_t len){
+  return bus_->transmit(node_, mac, data, len);
+}
+
+VirtualBus::VirtualBus(uint32_t seed) : rng_(seed ? seed : 1) {
+  g_clockUs = 0;
+  g_nodeClocks.clear();
+  resetOta();                  // slots are keyed by core address, which a new bus may reuse
+  seedRandom(seed);
+}
+
+VirtualBus::~VirtualBus(){
+  while(!q_.empty()){ delete q_.top(); q_.pop(); }
+  EspNowCore::setInstance(nullptr);
+}
+
+uint32_t VirtualBus::rand32(){
+  rng_ ^= rng_ << 13; rng_ ^= rng_ >> 17; rng_ ^= rng_ << 5;
+  return rng_;
+}
+
+EspNowCore& VirtualBus::addNode(IRoleAdapter* role, const ServiceRefs* services){
+  uint16_t i = (uint16_t)nodes_.size();
+  nodes_.emplace_back(new Node(this, i));
+  Node& n = *nodes_.back();
+  const uint8_t m[6] = { 0x02, 0xEE, 0x00, 0x00, (uint8_t)(i >> 8), (uint8_t)i };
+  std::memcpy(n.mac, m, 6);
+  EspNowCore::setInstance(n.core.get());
+  n.core->setRadio(&n.radio);
+  n.core->setServices(services);
+  n.core->setRoleAdapter(role);
+  n.core->begin();
+  n.core->refreshDeviceInfoFromNvs();
+  n.dueUs = nowUs_;
+  return *n.core;
+}
+
+int VirtualBus::indexOf(const uint8_t mac[6]) const {
+  if(mac[0] != 0x02 || mac[1] != 0xEE) return -1;
+  size_t i = ((size_t)mac[4] << 8) | mac[5];
+  return i < nodes_.size() ? (int)i : -1;
+}
+
+void VirtualBus::setClock(size_t i, int64_t offsetUs, int32_t ppm){
+  const EspNowCore* c = nodes_[i]->core.get();
+  for(auto& k : g_nodeClocks) if(k.core == c){ k.offsetUs = offsetUs; k.ppm = ppm; return; }
+  g_nodeClocks.push_back(NodeClock{ c, offsetUs, ppm });
+}
+
+void VirtualBus::busy(size_t i, uint32_t ms){
+  nodes_[i]->busyUs = nowUs_ + (uint64_t)ms * 1000u;
+}
+
+void VirtualBus::setLink(size_t from, size_t to, const LinkModel& m){
+  links_[(uint32_t)(from << 16 | to)] = m;
+}
+
+const LinkModel& VirtualBus::link(uint16_t from, uint16_t to) const {
+  auto it = links_.find((uint32_t)from << 16 | to);
+  return it == links_.end() ? defLink_ : it->second;
+}
+
+VirtualBus::Event* VirtualBus::newEvent(uint64_t at, uint16_t node){
+  Event* e = new Event();
+  e->at = at; e->order = order_++; e->node = node;
+  return e;
+}
+
+// Schedules one copy; false if the link model drops it. atUs = arrival time.
+bool VirtualBus::deliverCopy(uint16_t from, uint16_t to, const uint8_t* data, uint16_t len, uint64_t& atUs){
+  const LinkModel& l = link(from, to);
+  uint64_t d = l.latencyUs + (l.jitterUs ? rand32() % (l.jitterUs + 1) : 0);
+  if(l.reorderPpm && rand32() % 1000000u < l.reorderPpm) d += l.latencyUs + rand32() % (l.latencyUs + 1);
+  atUs = nowUs_ + d;
+  if(l.lossPpm && rand32() % 1000000u < l.lossPpm){ st_.lost++; return false; }
+  Event* e = newEvent(atUs, to);
+  e->from = from; e->rx = true; e->rssi = l.rssi; e->len = len;
+  std::memcpy(e->data, data, len);
+  q_.push(e);
+  st_.delivered++;
+  return true;
+}
+
+// Unicast completes with the peer's MAC-level ACK (i.e. delivery); broadcast
+// always completes OK, as on the real driver.
+RadioErr VirtualBus::transmit(uint16_t from, const uint8_t mac[6], const uint8_t* data, uint16_t len){
+  SimRadio& r = nodes_[from]->radio;
+  if(r.queued_ >= DRIVER_QUEUE){ st_.busy++; return RADIO_BUSY; }
+  if(len > ESP_NOW_MAX_DATA_LEN) return RADIO_FAIL;
+  st_.sent++;
+  r.queued_++;
+  bool ok = true;
+  uint64_t doneAt = nowUs_ + defLink_.latencyUs;
+  if(mac[0] & 0x01){
+    for(uint16_t to = 0; to < nodes_.size(); ++to){
+      if(to == from) continue;
+      uint64_t at; deliverCopy(from, to, data, len, at);
+    }
+  }else{
+    int to = indexOf(mac);
+    if(to < 0 || to == from) ok = false;
+    else ok = deliverCopy(from, (uint16_t)to, data, len, doneAt);
+  }
+  if(doneAt < r.lastDoneUs_) doneAt = r.lastDoneUs_;   // one driver queue: FIFO completions
+  r.lastDoneUs_ = doneAt;
+  Event* e = newEvent(doneAt, from);
+  e->rx = false; e->ok = ok; e->len = 6;
+  std::memcpy(e->data, mac, 6);
+  q_.push(e);
+  return RADIO_OK;
+}
+
+// Runs service() on every node that was woken or whose timer is due, until
+// the network settles at the current instant.
+void VirtualBus::serviceNodes(){
+  for(int pass = 0; pass < 64; ++pass){
+    bool any = false;
+    for(auto& np : nodes_){
+      Node& n = *np;
+      if(!n.core->wakePending() && n.dueUs > nowUs_) continue;
+      if(n.busyUs > nowUs_) continue;
+      any = true;
+      EspNowCore::setInstance(n.core.get());
+      uint32_t w = n.core->service();
+      n.dueUs = (w == UINT32_MAX) ? UINT64_MAX : nowUs_ + (uint64_t)(w ? w : 1) * 1000u;
+    }
+    if(!any) return;
+  }
+}
+
+void VirtualBus::runFor(uint32_t ms){
+  uint64_t end = nowUs_ + (uint64_t)ms * 1000u;
+  for(;;){
+    serviceNodes();
+    uint64_t next = q_.empty() ? UINT64_MAX : q_.top()->at;
+    for(auto& n : nodes_){
+      uint64_t due = n->dueUs;
+      if(n->busyUs > nowUs_ && (due < n->busyUs || n->core->wakePending())) due = n->busyUs;
+      if(due < next) next = due;
+    }
+    uint64_t tmr = nextTimerUs();
+    if(tmr < next) next = tmr;
+    if(next > end){ nowUs_ = g_clockUs = end; return; }
+    if(next > nowUs_) nowUs_ = g_clockUs = next;
+    fireTimers(nowUs_);
+    while(!q_.empty() && q_.top()->at <= nowUs_){
+      Event* e = q_.top(); q_.pop();
+      Node& n = *nodes_[e->node];
+      EspNowCore::setInstance(n.core.get());
+      if(e->rx){
+        n.core->radioRx(nodes_[e->from]->mac, e->data, e->len, e->rssi);
+      }else{
+        if(n.radio.queued_) n.radio.queued_--;
+        n.core->radioTxDone(e->data, e->ok);
+      }
+      delete e;
+    }
+  }
+}
+
+bool VirtualBus::runUntilIdle(uint32_t maxMs){
+  uint64_t end = nowUs_ + (uint64_t)maxMs * 1000u;
+  while(nowUs_ < end){
+    runFor(1);
+    bool busy = !q_.empty();
+    for(auto& n : nodes_){
+      TxScheduler::Stats t = n->core->txStats();
+      if(t.inFlight || n->core->pendingRequests()) busy = true;
+      for(uint16_t d : t.laneDepth) if(d) busy = true;
+    }
+    if(!busy) return true;
+  }
+  return false;
+}
+
+}} // namespace espnow::sim
+#endif // ESPNOW_HOST_SIM
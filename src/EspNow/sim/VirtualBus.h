@@ -0,0 +1,154 @@
+#pragma once
+#ifdef ESPNOW_HOST_SIM
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "../EspNowCore.h"
+#include "../IRadio.h"
+#include "../IRoleAdapter.h"
+
+namespace espnow { namespace sim {
+
+// Host-only virtual radio: N EspNowCore nodes in one process on a shared
+// virtual clock (millis() follows it). Build with -DESPNOW_HOST_SIM and
+// src/EspNow/sim/host first on the include path.
+//
+//   VirtualBus bus(42);
+//   EspNowCore& icm = bus.addNode(&icmAdapter);
+//   EspNowCore& rel = bus.addNode(&relayAdapter);
+//   icm.addPeer(bus.mac(1));
+//   icm.request(bus.mac(1), GET_RELAY_STATES, nullptr, 0, onDone);
+//   bus.runFor(100);
+
+struct LinkModel {
+  uint32_t latencyUs = 1500;   // one way: airtime + driver
+  uint32_t jitterUs  = 300;    // uniform 0..jitter added
+  uint32_t lossPpm   = 0;      // per frame, after MAC retries (1000000 = all)
+  uint32_t reorderPpm= 0;      // chance of an extra 1..2x latency delay
+  int8_t   rssi      = -60;
+};
+
+struct BusStats {
+  uint64_t sent;        // frames accepted from a radio
+  uint64_t delivered;   // frame copies handed to a receiver
+  uint64_t lost;        // copies dropped by the link model
+  uint64_t busy;        // sends refused (driver queue full)
+};
+
+class VirtualBus;
+
+class SimRadio final : public IRadio {
+public:
+  SimRadio(VirtualBus* bus, uint16_t node) : bus_(bus), node_(node) {}
+  bool     begin(EspNowCore* core) override { core_ = core; return true; }
+  RadioErr send(const uint8_t mac[6], const uint8_t* data, uint16_t len) override;
+  bool     addPeer(const uint8_t mac[6], bool, const uint8_t*) override { return mac != nullptr; }
+  bool     delPeer(const uint8_t mac[6]) override { return mac != nullptr; }
+  void     localMac(uint8_t mac[6]) const override;
+
+private:
+  friend class VirtualBus;
+  VirtualBus* bus_;
+  uint16_t    node_;
+  uint16_t    queued_{0};      // sends without a completion yet
+  uint64_t    lastDoneUs_{0};  // completions come back in send order
+  EspNowCore* core_{nullptr};
+};
+
+class VirtualBus {
+public:
+  static constexpr uint16_t DRIVER_QUEUE = 8;   // esp_now_send() refuses beyond this
+
+  explicit VirtualBus(uint32_t seed = 1);
+  ~VirtualBus();
+
+  // Node i gets MAC 02:EE:00:00:hi(i):lo(i). The core is begun with `role`
+  // mounted; services may be null (adapters then answer with defaults).
+  EspNowCore& addNode(IRoleAdapter* role, const ServiceRefs* services = nullptr);
+  EspNowCore& node(size_t i) { return *nodes_[i]->core; }
+  size_t      size() const { return nodes_.size(); }
+  const uint8_t* mac(size_t i) const { return nodes_[i]->mac; }
+  int         indexOf(const uint8_t mac[6]) const;
+
+  void setDefaultLink(const LinkModel& m) { defLink_ = m; }
+  void setLink(size_t from, size_t to, const LinkModel& m);   // one direction
+
+  // Node i's esp_timer runs offsetUs ahead of the bus clock and ppm fast.
+  void setClock(size_t i, int64_t offsetUs, int32_t ppm);
+
+  // Node i's service task is stuck in a handler for ms: service() does not
+  // run, while its radio and esp_timer callbacks still do.
+  void busy(size_t i, uint32_t ms);
+
+  void     runFor(uint32_t ms);
+  bool     runUntilIdle(uint32_t maxMs);   // true if nothing left in flight
+  uint64_t nowUs() const { return nowUs_; }
+  BusStats stats() const { return st_; }
+
+private:
+  friend class SimRadio;
+
+  struct Node {
+    uint8_t     mac[6];
+    SimRadio    radio;
+    std::unique_ptr<EspNowCore> core;
+    uint64_t    dueUs;     // next timer wanted by service()
+    uint64_t    busyUs;    // service() held off until then (busy())
+    Node(VirtualBus* b, uint16_t i) : radio(b, i), core(new EspNowCore()), dueUs(UINT64_MAX), busyUs(0) {}
+  };
+  struct Event {
+    uint64_t at;
+    uint64_t order;
+    uint16_t node;        // receiver (RX) or sender (TX done)
+    uint16_t from;
+    bool     rx;
+    bool     ok;
+    int8_t   rssi;
+    uint16_t len;
+    uint8_t  data[ESP_NOW_MAX_DATA_LEN];
+  };
+  struct Later {
+    bool operator()(const Event* a, const Event* b) const {
+      return a->at != b->at ? a->at > b->at : a->order > b->order;
+    }
+  };
+
+  RadioErr transmit(uint16_t from, const uint8_t mac[6], const uint8_t* data, uint16_t len);
+  bool     deliverCopy(uint16_t from, uint16_t to, const uint8_t* data, uint16_t len, uint64_t& atUs);
+  const LinkModel& link(uint16_t from, uint16_t to) const;
+  Event*   newEvent(uint64_t at, uint16_t node);
+  void     serviceNodes();
+  uint32_t rand32();
+
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::unordered_map<uint32_t, LinkModel> links_;   // from << 16 | to
+  LinkModel defLink_{};
+  std::priority_queue<Event*, std::vector<Event*>, Later> q_;
+  uint64_t nowUs_{0};
+  uint64_t order_{0};
+  uint32_t rng_;
+  BusStats st_{};
+};
+
+uint64_t clockUs();   // virtual time behind millis()/micros(); one bus at a time
+int64_t  localUs();   // esp_timer_get_time() of the node being serviced (setClock)
+uint64_t nextTimerUs();            // earliest armed esp_timer (sim/host/esp_timer.h)
+void     fireTimers(uint64_t nowUs);
+void     seedRandom(uint32_t seed);
+
+// esp_ota_ops / esp_restart stand-ins, per node.
+struct OtaSlot {
+  std::vector<uint8_t> image;     // bytes written to the update slot
+  bool     open;                  // between esp_ota_begin() and end/abort
+  bool     boot;                  // set as the boot partition
+  uint32_t restarts;              // esp_restart() calls
+};
+const OtaSlot& otaSlot(const EspNowCore* node);
+void           setOtaPartition(uint32_t bytes);   // slot size for every node, 0 = none
+void           resetOta();                        // forget every node's slot (new bus)
+
+}} // namespace espnow::sim
+#endif // ESPNOW_HOST_SIM
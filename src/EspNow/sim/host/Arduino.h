@@ -0,0 +1,14 @@
+#pragma once
+// ESPNOW_HOST_SIM stand-in for the Arduino core: only what src/EspNow uses.
+// Put sim/host first on the include path of a host build.
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+
+uint32_t millis();   // virtual bus clock (sim/HostShim.cpp)
+uint32_t micros();
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_8BIT    (1u << 2)
+#define MALLOC_CAP_SPIRAM  (1u << 10)
+
+void* heap_caps_malloc(size_t size, uint32_t caps);
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void  heap_caps_free(void* p);
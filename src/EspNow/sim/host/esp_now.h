@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdint>
+
+typedef int esp_err_t;
+#define ESP_OK                0
+#define ESP_NOW_ETH_ALEN      6
+#define ESP_NOW_MAX_DATA_LEN  250
@@ -0,0 +1,37 @@
+#pragma once
+// ESPNOW_HOST_SIM stand-in for esp_ota_ops: one memory-backed update slot per
+// node (sim::otaImage), keyed by the node current when esp_ota_begin() runs.
+#include <cstddef>
+#include <cstdint>
+#include <esp_timer.h>      // esp_err_t, ESP_OK
+
+#ifndef ESP_FAIL
+#define ESP_FAIL                -1
+#endif
+#ifndef ESP_ERR_INVALID_ARG
+#define ESP_ERR_INVALID_ARG     0x102
+#endif
+#ifndef ESP_ERR_INVALID_SIZE
+#define ESP_ERR_INVALID_SIZE    0x104
+#endif
+#ifndef ESP_ERR_OTA_VALIDATE_FAILED
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+#endif
+
+#define OTA_SIZE_UNKNOWN           0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe
+
+typedef uint32_t esp_ota_handle_t;
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  char     label[17];
+} esp_partition_t;
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
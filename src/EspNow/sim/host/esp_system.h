@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+typedef enum { ESP_MAC_WIFI_STA = 0 } esp_mac_type_t;
+
+void     esp_restart();                                  // counted per node (sim::restarts)
+uint32_t esp_random();                                   // seeded by the bus
+int      esp_read_mac(uint8_t* mac, esp_mac_type_t type); // zeros; nodes use IRadio::localMac()
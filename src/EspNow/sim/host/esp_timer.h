@@ -0,0 +1,30 @@
+#pragma once
+// ESPNOW_HOST_SIM stand-in for esp_timer: one-shot timers on the virtual
+// clock. The bus fires them (sim::fireTimers) with the owning node current.
+#include <cstdint>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK                  0
+#endif
+#ifndef ESP_ERR_INVALID_STATE
+#define ESP_ERR_INVALID_STATE   0x103
+#endif
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef enum { ESP_TIMER_TASK = 0 } esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t       callback;
+  void*                arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char*          name;
+  bool                 skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t t);
+esp_err_t esp_timer_delete(esp_timer_handle_t t);
+int64_t   esp_timer_get_time();
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Single-threaded host: critical sections are no-ops.
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void*    TaskHandle_t;
+
+#define pdTRUE   1
+#define pdFALSE  0
+#define pdPASS   1
+#define portMAX_DELAY      0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(m)      ((void)(m))
+#define portEXIT_CRITICAL(m)       ((void)(m))
+#define portENTER_CRITICAL_ISR(m)  ((void)(m))
+#define portEXIT_CRITICAL_ISR(m)   ((void)(m))
+
+typedef enum { eNoAction = 0, eSetBits, eIncrement } eNotifyAction;
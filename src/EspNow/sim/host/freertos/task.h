@@ -0,0 +1,12 @@
+#pragma once
+#include "FreeRTOS.h"
+
+// No tasks on the host: EspNowCore never creates one under ESPNOW_HOST_SIM,
+// so notifications only need to link. ReqFuture::wait() returns at once; on
+// timeout it only cancels, and the bus completes the future on its next pass.
+BaseType_t   xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t   xTaskNotifyGive(TaskHandle_t task);
+uint32_t     ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t   xTaskGetTickCount();
+#define taskYIELD() ((void)0)
@@ -113,6 +113,12 @@ public:
    */
   void writeMask(uint32_t mask);
 
+  /**
+   * @brief Shadow state of all channels (LSB=ch0).
+   * @return Bit mask as last written.
+   */
+  uint32_t getStatesBitmap() const { return _shadow; }
+
   /**
    * @brief Number of channels available under current role.
    * @return Channel count.
@@ -0,0 +1,163 @@
+// Receive-path benchmark: replays a recorded frame mix into one role adapter
+// through EspNowCore::inject() and enforces per-opcode budgets (ESPNOW_PROFILE).
+//
+//   pio test -e native -f test_dispatch_bench -v     (-v prints the tables)
+//
+// Time is steady_clock on the build machine, so only the per-opcode average is
+// checked, loosely. Allocations per frame are exact and are the gate that matters.
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "Frame.h"
+#include "Bundle.h"
+#include "adapters/VirtMux.h"
+#include "adapters/SensorRoleAdapter.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/PmsRoleAdapter.h"
+#include "adapters/RelayEmuRoleAdapter.h"
+
+using namespace espnow;
+
+static constexpr int      ROUNDS     = 200;
+static constexpr uint32_t AVG_NS_MAX = 50000;      // per opcode average, host
+
+struct Rec {
+  uint8_t  type;
+  uint8_t  body[64];
+  uint8_t  len;
+  uint32_t maxAllocs;      // budget for this opcode
+};
+
+static std::vector<uint8_t> frameOf(const Rec& r, uint16_t corr){
+  std::vector<uint8_t> f(sizeof(EspNowHeader) + r.len);
+  EspNowHeader h{ r.type, 0x00, corr, 0, 0 };
+  std::memcpy(f.data(), &h, sizeof(h));
+  if(r.len) std::memcpy(f.data() + sizeof(h), r.body, r.len);
+  return f;
+}
+
+// Answers seen by the sending node, per opcode: [type][0] ok, [type][1] FLAG_ERR.
+static uint32_t g_answers[256][2];
+
+static void report(const char* name, const DispatchProfiler& p){
+  printf("%s\n  op    frames   avg ns   max ns  allocs/frame  max   ok  err\n", name);
+  for(size_t i = 0; i < ESPNOW_PROFILE_OPS; ++i){
+    const OpProfile& o = p.table()[i];
+    if(o.key == 0xFFFF || !o.frames) continue;
+    const uint32_t* a = g_answers[o.key & 0xFF];
+    printf("  %02X%s %7u %8u %8u  %12.2f %4u %4u %4u\n", o.key & 0xFF, (o.key & 0x100) ? "r" : " ",
+           o.frames, o.avgNs(), o.maxNs, (double)o.allocs / o.frames, o.maxAllocs, a[0], a[1]);
+  }
+}
+
+// Node 0 runs the adapter under test, node 1 only sends (its frames are injected).
+static void replay(const char* name, IRoleAdapter& role, const Rec* mix, size_t n){
+  sim::VirtualBus bus(11);
+  RelayEmuRoleAdapter peerRole;
+  EspNowCore& dut = bus.addNode(&role);
+  EspNowCore& src = bus.addNode(&peerRole);
+  dut.addPeer(bus.mac(1));
+  src.addPeer(bus.mac(0));              // answers must not be shed as a stranger's
+  std::memset(g_answers, 0, sizeof(g_answers));
+  src.setRxTap([](const uint8_t*, const EspNowMsg& m){
+    if(isResponse(m.flags)) g_answers[m.type][(m.flags & FLAG_ERR) ? 1 : 0]++;
+  });
+  DispatchProfiler& prof = dut.profiler();
+  prof.clear();
+  for(size_t i = 0; i < n; ++i)
+    prof.setBudget(mix[i].type, false, OpProfile::NO_LIMIT, mix[i].maxAllocs, OpProfile::NO_LIMIT);
+
+  std::vector<std::vector<uint8_t>> frames;
+  for(size_t i = 0; i < n; ++i) frames.push_back(frameOf(mix[i], (uint16_t)(i + 1)));
+  // One warm-up pass: first calls grow reusable buffers and are not representative.
+  // Frames are paced 2 ms apart so receive admission never sheds them.
+  for(auto& f : frames){ TEST_ASSERT_TRUE(dut.inject(bus.mac(1), f.data(), (uint16_t)f.size())); bus.runFor(2); }
+  prof.reset();
+  std::memset(g_answers, 0, sizeof(g_answers));
+
+  for(int r = 0; r < ROUNDS; ++r){
+    for(auto& f : frames){
+      TEST_ASSERT_TRUE(dut.inject(bus.mac(1), f.data(), (uint16_t)f.size()));
+      bus.runFor(2);
+    }
+  }
+  report(name, prof);
+  for(size_t i = 0; i < n; ++i){
+    const OpProfile* o = prof.find(mix[i].type);
+    TEST_ASSERT_NOT_NULL(o);
+    uint32_t expect = 0;
+    for(size_t j = 0; j < n; ++j) if(mix[j].type == mix[i].type) expect += ROUNDS;
+    TEST_ASSERT_EQUAL_MESSAGE(expect, o->frames, "every injected frame was profiled");
+    const uint32_t* a = g_answers[mix[i].type];
+    TEST_ASSERT_EQUAL_MESSAGE(expect, a[0] + a[1], "every injected frame was answered");
+    char msg[64];
+    std::snprintf(msg, sizeof(msg), "opcode %02X over its budget", mix[i].type);
+    TEST_ASSERT_EQUAL_MESSAGE(0, o->overBudget, msg);
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(AVG_NS_MAX, o->avgNs(), msg);
+  }
+  TEST_ASSERT_EQUAL(0, prof.untracked());
+}
+
+static void test_sensor_mix(){
+  static const Rec mix[] = {
+    { GET_PRESENCE,   {},                0, 0 },
+    { GET_ENV,        {},                0, 0 },
+    { GET_LUX,        {},                0, 0 },
+    { GET_TFLUNA_RAW, {},                0, 0 },
+    { GET_TOPOLOGY,   {},                0, 0 },
+    { GET_LINKSTATS,  { 0, 0, 8 },       3, 0 },
+    { BUNDLE,         { 2, GET_PRESENCE, 0, GET_LUX, 0 }, 5, 0 },
+  };
+  SensorRoleAdapter role;
+  replay("SensorRoleAdapter", role, mix, sizeof(mix) / sizeof(mix[0]));
+}
+
+static void test_icm_mix(){
+  static const Rec mix[] = {
+    { GET_TOPOLOGY,   {},                0, 0 },
+    { GET_LINKSTATS,  { 0, 0, 8 },       3, 0 },
+    { GET_TIME,       {},                0, 0 },
+    { GET_FAULTS,     {},                0, 0 },
+  };
+  IcmRoleAdapter role;
+  replay("IcmRoleAdapter", role, mix, sizeof(mix) / sizeof(mix[0]));
+}
+
+static void test_pms_mix(){
+  static const Rec mix[] = {
+    { GET_VI,           {},              0, 0 },
+    { GET_POWER_SOURCE, {},              0, 0 },
+    { GET_TOPOLOGY,     {},              0, 0 },
+    { GET_TEMP,         {},              0, 0 },
+  };
+  PmsRoleAdapter role;
+  replay("PmsRoleAdapter", role, mix, sizeof(mix) / sizeof(mix[0]));
+}
+
+static void test_relay_emu_mix(){
+  static const Rec mix[] = {
+    { GET_RELAY_STATES, { 0 },                        1, 0 },
+    { SET_RELAY,        { 0, 2, 1, 0, 0 },            5, 0 },
+    { GET_RELAY_STATES, { VIRT_MULTI, 0x0F, 0x00 },   3, 0 },
+    { GET_TOPOLOGY,     {},                           0, 0 },
+  };
+  RelayEmuRoleAdapter role;
+  role.relays().chCount[0] = 4;         // virtual 0 owns channels 0..3
+  replay("RelayEmuRoleAdapter", role, mix, sizeof(mix) / sizeof(mix[0]));
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_sensor_mix);
+  RUN_TEST(test_icm_mix);
+  RUN_TEST(test_pms_mix);
+  RUN_TEST(test_relay_emu_mix);
+  return UNITY_END();
+}
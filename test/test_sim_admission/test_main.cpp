@@ -0,0 +1,107 @@
+// Receive admission under a storm against the ICM: one stranger MAC hammering
+// GET_TEMP at 5 kHz plus 1000 fresh MACs per second each sending PAIR_EXCHANGE,
+// while a paired relay keeps asking the ICM for GET_TEMP. The storm runs long
+// enough that pinning every admitted pairing would fill the peer table; the
+// strangers must then age out of it.
+//
+//   pio test -e native -f test_sim_admission -v
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "Frame.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/RelayEmuRoleAdapter.h"
+
+using namespace espnow;
+
+static int g_ok, g_fail;
+static void onDone(const uint8_t*, const ReqResult& r, void*){ if(r.status == REQ_OK) g_ok++; else g_fail++; }
+
+static void storm(bool flood, int seconds){
+  sim::VirtualBus bus(3);
+  IcmRoleAdapter icm; RelayEmuRoleAdapter remu;
+  EspNowCore& ci = bus.addNode(&icm);
+  EspNowCore& cr = bus.addNode(&remu);
+  ci.addPeer(bus.mac(1)); cr.addPeer(bus.mac(0));
+  g_ok = g_fail = 0;
+
+  uint8_t hammer[sizeof(EspNowHeader)], pair[sizeof(EspNowHeader) + 6];
+  const EspNowHeader hh{ GET_TEMP, 0, 0, 0, 0 }, hp{ PAIR_EXCHANGE, 0, 0, 0, 0 };
+  std::memcpy(hammer, &hh, sizeof(hh));
+  std::memcpy(pair, &hp, sizeof(hp));
+  const uint8_t bad[6] = { 0x02, 0xBA, 0xD0, 0, 0, 1 };
+  for(int ms = 0; ms < seconds * 1000; ++ms){
+    EspNowCore::setInstance(&ci);
+    if(flood){
+      // Frames go straight into the ICM's receive path, as the radio would deliver them.
+      for(int k = 0; k < 5; ++k) ci.radioRx(bad, hammer, sizeof(hammer), -50);
+      const uint8_t fresh[6] = { 0x02, 0x55, (uint8_t)(ms >> 8), (uint8_t)ms, 0, 0 };
+      std::memcpy(pair + sizeof(hp), fresh, 6);
+      ci.radioRx(fresh, pair, sizeof(pair), -50);
+    }
+    if(ms % 20 == 0){ EspNowCore::setInstance(&cr); cr.request(bus.mac(0), GET_TEMP, nullptr, 0, onDone); }
+    bus.runFor(1);
+  }
+  bus.runFor(500);
+  auto a = ci.admitStats();
+  printf("  %s: legit %d ok %d failed | shed peer %u stranger %u pair %u, quarantined %u (%u drops), peers %u\n",
+         flood ? "storm" : "calm", g_ok, g_fail, a.peerShed, a.strangerShed, a.pairShed,
+         a.quarantined, a.quarantineDrops, (unsigned)ci.peers().count());
+  TEST_ASSERT_EQUAL(seconds * 50, g_ok);
+  TEST_ASSERT_EQUAL(0, g_fail);
+  if(flood){
+    TEST_ASSERT_GREATER_OR_EQUAL(1, a.quarantined);
+    TEST_ASSERT_GREATER_OR_EQUAL(10000, a.quarantineDrops);
+    TEST_ASSERT_GREATER_OR_EQUAL(2000, a.strangerShed + a.pairShed);
+    // Long enough for the pairing bucket to have admitted more MACs than the
+    // table holds: only the relay is pinned, the rest wait as pending.
+    TEST_ASSERT_GREATER_OR_EQUAL(ci.peers().capacity(), (size_t)seconds * ESPNOW_ADMIT_PAIR_RATE);
+    size_t pinned = 0;
+    for(const Peer* p = ci.peers().begin(); p && p != ci.peers().end(); ++p) if(p->flags & PEER_PINNED) pinned++;
+    TEST_ASSERT_EQUAL(1, pinned);
+    TEST_ASSERT_LESS_OR_EQUAL(2 + ESPNOW_PAIR_PENDING_MAX, ci.peers().count());   // + the hammering MAC
+    // Once the storm is over, the strangers age out and only the relay stays.
+    for(uint32_t t = 0; t < ESPNOW_PEER_STALE_MS + ESPNOW_PEER_SWEEP_MS; t += 1000){
+      if(t % 20000 == 0){ EspNowCore::setInstance(&cr); cr.request(bus.mac(0), GET_TEMP, nullptr, 0, onDone); }
+      bus.runFor(1000);
+    }
+    TEST_ASSERT_EQUAL(1, ci.peers().count());
+    TEST_ASSERT_NOT_NULL(ci.peers().find(bus.mac(1)));
+  }
+}
+
+// A real device pairing through PAIR_EXCHANGE is pinned once the ICM's answer
+// is ACKed.
+static void test_pairing_confirms_on_ack(){
+  sim::VirtualBus bus(3);
+  IcmRoleAdapter icm; RelayEmuRoleAdapter remu;
+  EspNowCore& ci = bus.addNode(&icm);
+  EspNowCore& cr = bus.addNode(&remu);
+  cr.addPeer(bus.mac(0));
+  g_ok = g_fail = 0;
+  EspNowCore::setInstance(&cr);
+  cr.request(bus.mac(0), PAIR_EXCHANGE, bus.mac(1), 6, onDone);
+  bus.runFor(100);
+  const Peer* p = ci.peers().find(bus.mac(1));
+  TEST_ASSERT_EQUAL(1, g_ok);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_TRUE(p->flags & PEER_PINNED);
+  TEST_ASSERT_FALSE(p->flags & PEER_PENDING);
+}
+
+static void test_calm(){ storm(false, 3); }
+static void test_storm_spares_paired_peer(){ storm(true, 60); }
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_calm);
+  RUN_TEST(test_storm_spares_paired_peer);
+  RUN_TEST(test_pairing_confirms_on_ack);
+  return UNITY_END();
+}
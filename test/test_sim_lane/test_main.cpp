@@ -0,0 +1,143 @@
+// 40-node lane on the VirtualBus: one ICM, 13 sensor emulators (8 pairs each)
+// and 26 relay emulators, over lossy, jittery links.
+//  - request throughput: the ICM keeps its pending table full of reads across
+//    the lane and every one must complete;
+//  - actuation latency: every pair's direction edge must reach its relay
+//    through the local lane rules (LaneRules), without the ICM.
+//
+//   pio test -e native -f test_sim_lane -v
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "SensLane.h"
+#include "TopologyTlv.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/SensorEmuRoleAdapter.h"
+#include "adapters/RelayEmuRoleAdapter.h"
+
+using namespace espnow;
+
+static constexpr int SEMUS  = 13;
+static constexpr int REMUS  = 26;
+static constexpr int NODES  = 1 + SEMUS + REMUS;
+static constexpr int PAIRS  = 8;
+
+static constexpr uint32_t MIN_REQ_PER_S      = 1000;   // ICM -> lane reads, completed
+static constexpr uint32_t MAX_EDGE_AVG_US    = 3000;   // edge -> SET_RELAY at the relay
+static constexpr uint32_t MAX_EDGE_WORST_US  = 25000;  // one sampling period plus a lost frame
+
+struct Lane {
+  sim::VirtualBus bus{21};
+  IcmRoleAdapter icm;
+  std::vector<std::unique_ptr<SensorEmuRoleAdapter>> semu;
+  std::vector<std::unique_ptr<RelayEmuRoleAdapter>>  remu;
+
+  static int semuNode(int j){ return 1 + j; }
+  static int remuNode(int k){ return 1 + SEMUS + k; }
+  // Pair v of sensor j drives one relay ahead; pairs spread over every REMU.
+  static int remuOf(int j, int v){ return (j * PAIRS + v) % REMUS; }
+
+  Lane(){
+    sim::LinkModel lm; lm.latencyUs = 800; lm.jitterUs = 700; lm.lossPpm = 10000;   // 1 %
+    bus.setDefaultLink(lm);
+    EspNowCore& ci = bus.addNode(&icm);
+    for(int j = 0; j < SEMUS; ++j){ semu.emplace_back(new SensorEmuRoleAdapter()); bus.addNode(semu.back().get()); }
+    for(int k = 0; k < REMUS; ++k){ remu.emplace_back(new RelayEmuRoleAdapter()); bus.addNode(remu.back().get()); }
+    for(int i = 1; i < NODES; ++i){ ci.addPeer(bus.mac(i)); bus.node(i).addPeer(bus.mac(0)); }
+    for(int j = 0; j < SEMUS; ++j){
+      Topology t; t.role = RC_SEN_EMU; t.emuCount = PAIRS;
+      for(int v = 0; v < PAIRS; ++v){
+        SensLaneHdr h{ (uint8_t)v, 0, 1, 1, 600, 0 };
+        SensRelayRef r{};
+        std::memcpy(r.mac, bus.mac(remuNode(remuOf(j, v))), 6);
+        r.idx = (uint8_t)(v % 4); r.ch = (uint8_t)(v / 4);
+        t.roleParams.insert(t.roleParams.end(), (const uint8_t*)&h, (const uint8_t*)&h + sizeof(h));
+        t.roleParams.insert(t.roleParams.end(), (const uint8_t*)&r, (const uint8_t*)&r + sizeof(r));
+      }
+      EspNowCore::setInstance(&bus.node(semuNode(j)));
+      bus.node(semuNode(j)).setLocalTopology(t);
+    }
+    bus.runFor(500);
+  }
+};
+
+// Reads are pure, so a retry whose cached answer is gone runs again: a
+// REQ_DUPLICATE here is a read that came back without data, i.e. a failure.
+static uint32_t g_ok, g_dup, g_fail;
+static void onDone(const uint8_t*, const ReqResult& r, void*){
+  if(r.status == REQ_OK) g_ok++; else if(r.status == REQ_DUPLICATE) g_dup++; else g_fail++;
+}
+
+static void test_request_throughput(){
+  Lane lane;
+  EspNowCore& ci = lane.bus.node(0);
+  const uint32_t total = 4000;
+  g_ok = g_dup = g_fail = 0;
+  uint32_t issued = 0;
+  uint64_t t0 = lane.bus.nowUs();
+  while(g_ok + g_dup + g_fail < total && lane.bus.nowUs() - t0 < 60000000ull){
+    EspNowCore::setInstance(&ci);
+    while(issued < total){
+      int i = 1 + (int)(issued % (NODES - 1));
+      uint8_t idx = (uint8_t)(issued % 4);     // emulators take {idx} first
+      uint16_t corr = ci.request(lane.bus.mac(i), i <= SEMUS ? GET_PRESENCE : GET_RELAY_STATES, &idx, 1, onDone);
+      if(!corr) break;                        // pending table full
+      issued++;
+    }
+    lane.bus.runFor(1);
+  }
+  double secs = (lane.bus.nowUs() - t0) / 1e6;
+  uint32_t perS = (uint32_t)(g_ok / secs);
+  printf("  %u requests over %d nodes in %.2f s: %u req/s, %u duplicate, %u failed\n",
+         total, NODES - 1, secs, perS, g_dup, g_fail);
+  TEST_ASSERT_EQUAL(0, g_fail);
+  TEST_ASSERT_EQUAL(0, g_dup);
+  TEST_ASSERT_EQUAL(total, g_ok);
+  TEST_ASSERT_GREATER_OR_EQUAL(MIN_REQ_PER_S, perS);
+}
+
+static sim::VirtualBus* g_bus;
+static uint64_t g_edgeUs, g_firstUs;
+static void relayTap(const uint8_t*, const EspNowMsg& m){
+  if(m.type == SET_RELAY && !isResponse(m.flags) && !g_firstUs) g_firstUs = g_bus->nowUs();
+}
+
+static void test_actuation_latency(){
+  Lane lane;
+  g_bus = &lane.bus;
+  for(int k = 0; k < REMUS; ++k) lane.bus.node(Lane::remuNode(k)).setRxTap(relayTap);
+  std::vector<uint32_t> lat;
+  uint32_t missed = 0;
+  for(int j = 0; j < SEMUS; ++j){
+    for(int v = 0; v < PAIRS; ++v){
+      EspNowCore::setInstance(&lane.bus.node(Lane::semuNode(j)));
+      g_firstUs = 0; g_edgeUs = lane.bus.nowUs();
+      lane.semu[j]->feed((uint8_t)v, 500, 5000);          // car at A: A->B edge
+      lane.bus.runFor(60);
+      if(g_firstUs) lat.push_back((uint32_t)(g_firstUs - g_edgeUs)); else missed++;
+    }
+  }
+  uint64_t sum = 0; for(uint32_t l : lat) sum += l;
+  uint32_t avg = lat.empty() ? 0 : (uint32_t)(sum / lat.size());
+  uint32_t worst = lat.empty() ? 0 : *std::max_element(lat.begin(), lat.end());
+  printf("  %u edges: avg %u us, worst %u us, missed %u\n", (unsigned)lat.size(), avg, worst, missed);
+  TEST_ASSERT_EQUAL(0, missed);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_EDGE_AVG_US, avg);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_EDGE_WORST_US, worst);
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_request_throughput);
+  RUN_TEST(test_actuation_latency);
+  return UNITY_END();
+}
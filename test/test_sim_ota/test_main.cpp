@@ -0,0 +1,80 @@
+// Windowed firmware distribution (FW_BEGIN / FW_CHUNK / FW_COMMIT) from the ICM
+// to relay emulators on the VirtualBus, unicast and multicast, with and without
+// loss. The host shim backs each node's OTA partition with memory.
+//
+//   pio test -e native -f test_sim_ota -v
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sim/VirtualBus.h"
+#include "Ota.h"
+#include "TopologyTlv.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/RelayEmuRoleAdapter.h"
+
+using namespace espnow;
+
+static std::vector<uint8_t> g_img;
+static int g_done, g_ok;
+
+static bool readImg(void*, uint32_t off, uint8_t* d, uint16_t n){ std::memcpy(d, g_img.data() + off, n); return true; }
+static void onTarget(const uint8_t*, uint8_t err, void*){ g_done++; if(!err) g_ok++; }
+
+static void distribute(bool multicast, uint32_t lossPpm, int n){
+  if(g_img.empty()){
+    g_img.resize(100000);
+    uint32_t x = 1;
+    for(auto& b : g_img){ x ^= x << 13; x ^= x >> 17; x ^= x << 5; b = (uint8_t)x; }
+  }
+  sim::VirtualBus bus(7);
+  sim::LinkModel lm; lm.lossPpm = lossPpm; bus.setDefaultLink(lm);
+  IcmRoleAdapter icm; std::vector<RelayEmuRoleAdapter> r(n);
+  EspNowCore& ci = bus.addNode(&icm);
+  for(int i = 0; i < n; ++i) bus.addNode(&r[i]);
+  for(int i = 0; i < n; ++i){
+    ci.addPeer(bus.mac(i + 1)); bus.node(i + 1).addPeer(bus.mac(0));
+    const_cast<Peers&>(ci.peers()).setRole(bus.mac(i + 1), RC_REL_EMU);
+  }
+  uint32_t crc = fwCrc32(0, g_img.data(), g_img.size());
+  g_done = g_ok = 0;
+  EspNowCore::setInstance(&ci);
+  if(multicast) TEST_ASSERT_EQUAL(n, icm.ota().startRole(RC_REL_EMU, g_img.size(), crc, readImg, onTarget, nullptr));
+  else {
+    uint8_t macs[8][6];
+    for(int i = 0; i < n; ++i) std::memcpy(macs[i], bus.mac(i + 1), 6);
+    TEST_ASSERT_TRUE(icm.ota().start(macs, n, g_img.size(), crc, false, readImg, onTarget, nullptr));
+  }
+  uint64_t t0 = bus.nowUs();
+  while(g_done < n && bus.nowUs() - t0 < 120000000ull) bus.runFor(100);
+  bus.runFor(2000);                          // commit answers, then the reboot
+  auto st = icm.ota().stats();
+  printf("  %s loss %u ppm: %d/%d ok in %.2f s, %u chunks, %u resent, %u polls\n",
+         multicast ? "multicast" : "unicast", lossPpm, g_ok, n, (bus.nowUs() - t0) / 1e6, st.chunks, st.resent, st.polls);
+  TEST_ASSERT_EQUAL(n, g_ok);
+  TEST_ASSERT_EQUAL(0, st.failed);
+  for(int i = 1; i <= n; ++i){
+    auto& slot = sim::otaSlot(&bus.node(i));
+    TEST_ASSERT_TRUE(slot.image == g_img);
+    TEST_ASSERT_TRUE(slot.boot);
+    TEST_ASSERT_EQUAL(1, slot.restarts);
+  }
+}
+
+static void test_unicast_clean(){ distribute(false, 0, 3); }
+static void test_unicast_lossy(){ distribute(false, 50000, 3); }
+static void test_multicast_clean(){ distribute(true, 0, 4); }
+static void test_multicast_lossy(){ distribute(true, 50000, 4); }
+
+void setUp(){ sim::setOtaPartition(1u << 20); }
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_unicast_clean);
+  RUN_TEST(test_unicast_lossy);
+  RUN_TEST(test_multicast_clean);
+  RUN_TEST(test_multicast_lossy);
+  return UNITY_END();
+}
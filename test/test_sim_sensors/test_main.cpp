@@ -0,0 +1,111 @@
+// Sensor push streaming (SENS_SUBSCRIBE / SENS_REPORT) and local lane rules on
+// the VirtualBus, one ICM, one sensor emulator and one relay emulator.
+//
+//   pio test -e native -f test_sim_sensors -v
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "SensLane.h"
+#include "SensReport.h"
+#include "TopologyTlv.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/SensorEmuRoleAdapter.h"
+#include "adapters/RelayEmuRoleAdapter.h"
+
+using namespace espnow;
+
+static sim::VirtualBus* g_bus;
+static uint32_t g_reports, g_edges;
+static uint64_t g_edgeAtUs, g_relayAtUs;
+static uint8_t  g_subStatus = 0xFF;
+
+static void sink(const uint8_t*, const SensReportHdr& h, const SensPairRec*, uint8_t, void*){
+  g_reports++;
+  if(h.why == SENS_WHY_EDGE){ g_edges++; g_edgeAtUs = g_bus->nowUs(); }
+}
+static void subDone(const uint8_t*, const ReqResult& r, void*){ g_subStatus = r.status; }
+static void relayTap(const uint8_t*, const EspNowMsg& m){
+  if(m.type == SET_RELAY && !isResponse(m.flags) && !g_relayAtUs) g_relayAtUs = g_bus->nowUs();
+}
+
+struct Rig {
+  sim::VirtualBus bus{3};
+  IcmRoleAdapter icm;
+  SensorEmuRoleAdapter semu;
+  RelayEmuRoleAdapter remu;
+  EspNowCore* ci;
+  EspNowCore* cs;
+
+  Rig(){
+    g_bus = &bus; g_reports = g_edges = 0; g_edgeAtUs = g_relayAtUs = 0; g_subStatus = 0xFF;
+    icm.setReportSink(sink);
+    ci = &bus.addNode(&icm); cs = &bus.addNode(&semu); bus.addNode(&remu);
+    ci->addPeer(bus.mac(1)); cs->addPeer(bus.mac(0));
+    for(uint8_t v = 0; v < 8; ++v) semu.feed(v, 5000, 5000);      // lane empty
+  }
+};
+
+// 20 ms sampling, every 10th sample reported: 5 reports/s; an edge goes out at once.
+static void test_stream_cadence_and_edge(){
+  Rig r;
+  SensSubReq q{ 20, 10, 0xFFFF };
+  EspNowCore::setInstance(r.ci);
+  r.ci->request(r.bus.mac(1), SENS_SUBSCRIBE, &q, sizeof(q), subDone);
+  r.bus.runFor(1000);
+  printf("  subscribe status %u, %u reports in the first second\n", g_subStatus, g_reports);
+  TEST_ASSERT_EQUAL(REQ_OK, g_subStatus);
+  TEST_ASSERT_INT_WITHIN(1, 5, g_reports);
+
+  uint32_t edges = g_edges;                  // the first sample may count as one
+  EspNowCore::setInstance(r.cs);
+  uint64_t t0 = r.bus.nowUs();
+  r.semu.feed(3, 500, 5000);
+  r.bus.runFor(200);
+  printf("  edge report %llu us after the edge\n", (unsigned long long)(g_edgeAtUs - t0));
+  TEST_ASSERT_EQUAL(edges + 1, g_edges);
+  TEST_ASSERT_LESS_OR_EQUAL(25000, g_edgeAtUs - t0);         // within one sampling period + a hop
+}
+
+// Pair 3 lights relay virtual 1 ch 1 (ahead) with no ICM round trip.
+static void test_lane_rule_drives_relay(){
+  Rig r;
+  r.bus.node(2).setRxTap(relayTap);
+  Topology t; t.role = RC_SEN_EMU; t.emuCount = 8;
+  SensLaneHdr h{ 3, 1, 2, 1, 600, 0 };
+  t.roleParams.insert(t.roleParams.end(), (const uint8_t*)&h, (const uint8_t*)&h + sizeof(h));
+  const uint8_t refs[3][2] = { {0, 0}, {1, 1}, {2, 0} };       // NEG, then POS nearest first
+  for(auto& x : refs){
+    SensRelayRef ref{}; std::memcpy(ref.mac, r.bus.mac(2), 6); ref.idx = x[0]; ref.ch = x[1];
+    t.roleParams.insert(t.roleParams.end(), (const uint8_t*)&ref, (const uint8_t*)&ref + sizeof(ref));
+  }
+  EspNowCore::setInstance(r.cs);
+  r.cs->setLocalTopology(t);
+  r.bus.runFor(300);
+  TEST_ASSERT_FALSE(r.semu.rules().empty());
+
+  EspNowCore::setInstance(r.cs);
+  uint64_t t0 = r.bus.nowUs();
+  r.semu.feed(3, 500, 5000);
+  r.bus.runFor(100);
+  auto st = r.semu.rules().stats();
+  printf("  relay got SET_RELAY %llu us after the edge, fired=%u frames=%u\n",
+         (unsigned long long)(g_relayAtUs - t0), st.fired, st.frames);
+  TEST_ASSERT_EQUAL(1, st.fired);
+  TEST_ASSERT_EQUAL(0, st.drops);
+  TEST_ASSERT_EQUAL_HEX32(0x2, r.remu.relays().shadow[1]);
+  TEST_ASSERT_LESS_OR_EQUAL(25000, g_relayAtUs - t0);
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_stream_cadence_and_edge);
+  RUN_TEST(test_lane_rule_drives_relay);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+// TIME_SYNC network clock and SET_RELAY_AT on the VirtualBus, with node clocks
+// offset and drifting against the ICM (VirtualBus::setClock).
+//
+//   pio test -e native -f test_sim_timesync -v
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <esp_timer.h>
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "RelayAt.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/RelayRoleAdapter.h"
+#include "adapters/RelayEmuRoleAdapter.h"
+
+using namespace espnow;
+
+static int64_t errUs(sim::VirtualBus& bus, size_t node){
+  EspNowCore::setInstance(&bus.node(0));
+  int64_t ref = esp_timer_get_time();
+  EspNowCore::setInstance(&bus.node(node));
+  return bus.node(node).networkTimeUs() - ref;
+}
+
+// +40 ppm and -25 ppm nodes track the ICM once the skew baseline is in.
+static void test_drifting_nodes_track_icm(){
+  sim::VirtualBus bus(7);
+  IcmRoleAdapter icm; RelayRoleAdapter r1, r2;
+  EspNowCore& ci = bus.addNode(&icm); bus.addNode(&r1); bus.addNode(&r2);
+  ci.addPeer(bus.mac(1)); ci.addPeer(bus.mac(2));
+  bus.setClock(1, 5000000, 40); bus.setClock(2, -123456, -25);
+  bus.runFor(180000);
+  int64_t worst = 0;
+  for(int s = 0; s < 20; ++s){
+    bus.runFor(15000);
+    for(size_t n = 1; n <= 2; ++n){ int64_t e = errUs(bus, n); if(e < 0) e = -e; if(e > worst) worst = e; }
+  }
+  printf("  worst error over 5 min after lock: %lld us\n", (long long)worst);
+  TEST_ASSERT_TRUE(bus.node(1).timeSynced());
+  TEST_ASSERT_TRUE(bus.node(2).timeSynced());
+  TEST_ASSERT_LESS_OR_EQUAL(100, worst);
+}
+
+// More pinned peers than the old 16-slot table: every one of them syncs.
+static void test_forty_peers_all_sync(){
+  const int N = 40;
+  sim::VirtualBus bus(7);
+  IcmRoleAdapter icm; std::vector<RelayRoleAdapter> r(N);
+  EspNowCore& ci = bus.addNode(&icm);
+  for(int i = 0; i < N; ++i) bus.addNode(&r[i]);
+  for(int i = 0; i < N; ++i){ ci.addPeer(bus.mac(i + 1)); bus.node(i + 1).addPeer(bus.mac(0)); bus.setClock(i + 1, 1000 * i, i % 7 - 3); }
+  bus.runFor(120000);
+  int synced = 0;
+  for(int i = 1; i <= N; ++i) if(bus.node(i).timeSynced()) synced++;
+  uint32_t acked = ci.txStats().acked;
+  printf("  %d/%d synced, ICM frames acked %u\n", synced, N, acked);
+  TEST_ASSERT_EQUAL(N, synced);
+  TEST_ASSERT_LESS_OR_EQUAL(20000, acked);                // no probe storm
+}
+
+static uint8_t g_status[4];
+static void atDone(const uint8_t* mac, const ReqResult& r, void*){ g_status[mac[5] & 3] = r.status; }
+
+// Three REMUs switch together at a network time despite 4 ms link jitter.
+static void test_relay_at_switches_together(){
+  sim::VirtualBus bus(3);
+  sim::LinkModel lm; lm.latencyUs = 1500; lm.jitterUs = 4000; bus.setDefaultLink(lm);
+  IcmRoleAdapter icm; RelayEmuRoleAdapter r[3];
+  EspNowCore& ci = bus.addNode(&icm);
+  for(auto& x : r) bus.addNode(&x);
+  for(int i = 1; i <= 3; ++i) ci.addPeer(bus.mac(i));
+  bus.setClock(1, 7000000, 30); bus.setClock(2, -2000000, -20); bus.setClock(3, 123, 5);
+
+  // Before sync the write is refused.
+  std::memset(g_status, 0xFF, sizeof(g_status));
+  EspNowCore::setInstance(&ci);
+  SetRelayAtPayload p0{ 0, 1, 1 };
+  uint8_t b0[1 + sizeof(p0)]; b0[0] = 0; std::memcpy(b0 + 1, &p0, sizeof(p0));
+  ci.request(bus.mac(1), SET_RELAY_AT, b0, sizeof(b0), atDone);
+  bus.runFor(200000);
+  TEST_ASSERT_EQUAL(REQ_REMOTE_ERR, g_status[1]);
+  TEST_ASSERT_EQUAL(0, r[0].relays().shadow[0]);
+
+  EspNowCore::setInstance(&ci);
+  int64_t at = ci.networkTimeUs() + 300000;
+  uint64_t trueAt = bus.nowUs() + 300000;
+  for(int i = 1; i <= 3; ++i){
+    SetRelayAtPayload p{ at, 0x3, 0x1 };
+    uint8_t b[1 + sizeof(p)]; b[0] = 1; std::memcpy(b + 1, &p, sizeof(p));
+    EspNowCore::setInstance(&ci);
+    ci.request(bus.mac(i), SET_RELAY_AT, b, sizeof(b), atDone);
+  }
+  uint64_t seen[3] = { 0, 0, 0 };
+  uint64_t end = bus.nowUs() + 400000;
+  while(bus.nowUs() < end){
+    for(int i = 0; i < 3; ++i) if(!seen[i] && r[i].relays().shadow[1] == 1) seen[i] = bus.nowUs();
+    bus.runFor(1);
+  }
+  for(int i = 0; i < 3; ++i){
+    long long off = (long long)(seen[i] - trueAt);
+    printf("  node%d switched %+lld us from the target\n", i + 1, off);
+    TEST_ASSERT_TRUE(seen[i] != 0);
+    TEST_ASSERT_INT_WITHIN(1500, 0, off);                  // 1 ms polling + sync error
+    TEST_ASSERT_EQUAL(REQ_OK, g_status[i + 1]);
+  }
+}
+
+// The write lands on time while the relay's service task is stuck in a
+// handler across the deadline (VirtualBus::busy).
+static void test_relay_at_not_held_by_busy_handler(){
+  sim::VirtualBus bus(5);
+  IcmRoleAdapter icm; RelayEmuRoleAdapter r;
+  EspNowCore& ci = bus.addNode(&icm); bus.addNode(&r);
+  ci.addPeer(bus.mac(1));
+  bus.setClock(1, 3000000, 15);
+  bus.runFor(200000);
+  TEST_ASSERT_TRUE(bus.node(1).timeSynced());
+
+  std::memset(g_status, 0xFF, sizeof(g_status));
+  EspNowCore::setInstance(&ci);
+  SetRelayAtPayload p{ ci.networkTimeUs() + 100000, 0x1, 0x1 };
+  uint64_t trueAt = bus.nowUs() + 100000;
+  uint8_t b[1 + sizeof(p)]; b[0] = 0; std::memcpy(b + 1, &p, sizeof(p));
+  ci.request(bus.mac(1), SET_RELAY_AT, b, sizeof(b), atDone);
+  bus.runFor(60);
+  TEST_ASSERT_EQUAL(REQ_OK, g_status[1]);
+  bus.busy(1, 200);                                       // 160 ms past the deadline
+  uint64_t seen = 0, end = bus.nowUs() + 100000;
+  while(bus.nowUs() < end && !seen){
+    if(r.relays().shadow[0] == 1) seen = bus.nowUs();
+    bus.runFor(1);
+  }
+  long long off = (long long)(seen - trueAt);
+  printf("  switched %+lld us from the target, service task busy\n", off);
+  TEST_ASSERT_TRUE(seen != 0);
+  TEST_ASSERT_INT_WITHIN(1500, 0, off);
+  TEST_ASSERT_EQUAL(1, r.schedule().stats().fired);
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_drifting_nodes_track_icm);
+  RUN_TEST(test_forty_peers_all_sync);
+  RUN_TEST(test_relay_at_switches_together);
+  RUN_TEST(test_relay_at_not_held_by_busy_handler);
+  return UNITY_END();
+}
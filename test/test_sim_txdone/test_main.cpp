@@ -0,0 +1,53 @@
+// TX completion matching on the VirtualBus: a completion that arrives after
+// its frame aged out must not be taken for the next frame to the same peer.
+//
+//   pio test -e native -f test_sim_txdone -v
+#include <unity.h>
+#include <cstdio>
+
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/RelayRoleAdapter.h"
+
+using namespace espnow;
+
+static int  g_taps;
+static bool g_acked[4];
+static void tap(const uint8_t*, uint8_t type, uint16_t, bool acked){ if(type == GET_TEMP && g_taps < 4) g_acked[g_taps++] = acked; }
+static void done(const uint8_t*, const ReqResult&, void*){}
+
+void setUp(){ g_taps = 0; }
+void tearDown(){}
+
+// A goes out on a dead, slow link and ages out; its late NACK comes back
+// while B (sent once the link is good) is in flight.
+static void test_late_completion_is_dropped(){
+  sim::VirtualBus bus(9);
+  IcmRoleAdapter icm; RelayRoleAdapter rel;
+  EspNowCore& ci = bus.addNode(&icm); EspNowCore& cr = bus.addNode(&rel);
+  ci.addPeer(bus.mac(1)); cr.addPeer(bus.mac(0));
+  ci.setTxDoneTap(tap);
+  sim::LinkModel slow; slow.latencyUs = 3 * ESPNOW_TX_DONE_TIMEOUT_MS * 1000u; slow.jitterUs = 0; slow.lossPpm = 1000000;
+  bus.setLink(0, 1, slow);
+  EspNowCore::setInstance(&ci);
+  ci.request(bus.mac(1), GET_TEMP, nullptr, 0, done, nullptr, 0);
+  bus.runFor(2 * ESPNOW_TX_DONE_TIMEOUT_MS + 50);      // aged out, NACK still on its way
+  TEST_ASSERT_EQUAL(1, g_taps);
+  TEST_ASSERT_FALSE(g_acked[0]);                   // aged out
+
+  bus.setLink(0, 1, sim::LinkModel{});
+  EspNowCore::setInstance(&ci);
+  ci.request(bus.mac(1), GET_TEMP, nullptr, 0, done, nullptr, 0);
+  bus.runFor(3 * ESPNOW_TX_DONE_TIMEOUT_MS);
+  printf("  taps %d, second acked %d, stale %u\n", g_taps, (int)g_acked[1], ci.txStats().stale);
+  TEST_ASSERT_EQUAL(2, g_taps);
+  TEST_ASSERT_TRUE(g_acked[1]);                    // its own ACK, not A's NACK
+  TEST_ASSERT_GREATER_OR_EQUAL(1, ci.txStats().stale);   // the ICM's own probes to it go stale too
+}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_late_completion_is_dropped);
+  return UNITY_END();
+}
@@ -0,0 +1,41 @@
+// Topology codec benchmark (sim/TopoBench.h) on a lane at the TopologyFixed
+// limits: every codec must agree on the content, and the span encoder, the
+// fixed decoder and the visitor must not allocate.
+//
+//   pio test -e native -f test_topo_bench -v     (-v prints the table)
+//
+// Times are steady_clock on the build machine and are only printed; the
+// allocation counts are exact and are the gate.
+#include <unity.h>
+#include <cstdio>
+
+#include "sim/TopoBench.h"
+#include "TopologyTlv.h"
+
+using namespace espnow;
+
+static constexpr uint32_t ITERS = 2000;
+
+static void test_large_lane(){
+  sim::TopoBenchResult r = sim::benchTopology(ESPNOW_TOPO_MAX_NEIGHBORS, ESPNOW_TOPO_MAX_PARAMS, ITERS);
+  printf("  %u neighbours, %u param bytes: %u bytes (V2 %u)\n", ESPNOW_TOPO_MAX_NEIGHBORS, ESPNOW_TOPO_MAX_PARAMS,
+         (unsigned)r.tlvBytes, (unsigned)r.tlvBytesV2);
+  printf("  encode ns: legacy %u  vector %u  span %u\n", r.legacyEncodeNs, r.vectorEncodeNs, r.spanEncodeNs);
+  printf("  decode ns: legacy %u  vector %u  fixed %u  visit %u  v2 %u\n",
+         r.legacyDecodeNs, r.vectorDecodeNs, r.fixedDecodeNs, r.visitNs, r.v2DecodeNs);
+  printf("  allocs over %u runs: span %u  fixed %u  visit %u\n", ITERS, r.spanEncodeAllocs, r.fixedDecodeAllocs, r.visitAllocs);
+  TEST_ASSERT_TRUE(r.roundTrip);
+  TEST_ASSERT_LESS_THAN(r.tlvBytes, r.tlvBytesV2);
+  TEST_ASSERT_EQUAL(0, r.spanEncodeAllocs);
+  TEST_ASSERT_EQUAL(0, r.fixedDecodeAllocs);
+  TEST_ASSERT_EQUAL(0, r.visitAllocs);
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_large_lane);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+// PUSH_TOPO_DELTA codec (TopologyTlv.h): topoDiff() then topoApplyDelta() must
+// rebuild the target exactly, and bad deltas must be refused, not half applied.
+//
+//   pio test -e native -f test_topo_delta -v
+#include <unity.h>
+#include <cstring>
+#include <vector>
+
+#include "TopologyTlv.h"
+
+using namespace espnow;
+
+static std::array<uint8_t,6> mac(uint8_t i){ return { 0x24, 0x6F, 0x28, 0x00, 0x10, i }; }
+
+static Topology base(){
+  Topology t;
+  t.role = RC_SENSOR;
+  std::memset(t.token, 'k', sizeof(t.token));
+  for(uint8_t i = 0; i < 10; ++i) t.neighbors.push_back(mac(i));
+  for(uint8_t i = 0; i < 40; ++i) t.roleParams.push_back(uint8_t(i * 3));
+  t.emuCount = 4;
+  t.groups = { 1, 2, 3 };
+  return t;
+}
+
+static TopoStamp stampOf(const Topology& t, uint32_t version){ return TopoStamp{ version, topoHashOf(t) }; }
+
+// Diff from -> to, apply to a copy of from, and compare with to.
+static void roundTrip(const Topology& from, const Topology& to){
+  TopoStamp st = stampOf(from, 7);
+  uint8_t d[512];
+  size_t n = topoDiff(from, to, st, d, sizeof(d));
+  TEST_ASSERT_GREATER_THAN(0, n);
+  Topology t = from;
+  uint32_t want = 0;
+  TEST_ASSERT_EQUAL(TOPO_DELTA_OK, topoApplyDelta(t, st, d, (uint16_t)n, want));
+  TEST_ASSERT_EQUAL_HEX32(topoHashOf(to), want);
+  TEST_ASSERT_EQUAL_HEX32(want, topoHashOf(t));
+  TEST_ASSERT_EQUAL(to.role, t.role);
+  TEST_ASSERT_EQUAL(0, std::memcmp(to.token, t.token, 32));
+  TEST_ASSERT_TRUE(to.neighbors == t.neighbors);
+  TEST_ASSERT_TRUE(to.roleParams == t.roleParams);
+  TEST_ASSERT_EQUAL(to.emuCount, t.emuCount);
+  TEST_ASSERT_TRUE(to.groups == t.groups);
+}
+
+static void test_insert_neighbor_mid_list(){
+  Topology a = base(), b = a;
+  b.neighbors.insert(b.neighbors.begin() + 4, mac(0x80));
+  roundTrip(a, b);
+}
+
+static void test_remove_neighbors_mid_list(){
+  Topology a = base(), b = a;
+  b.neighbors.erase(b.neighbors.begin() + 3, b.neighbors.begin() + 6);
+  roundTrip(a, b);
+}
+
+static void test_replace_neighbor_mid_list(){
+  Topology a = base(), b = a;
+  b.neighbors[5] = mac(0x90);
+  roundTrip(a, b);
+}
+
+static void test_shrink_role_params(){
+  Topology a = base(), b = a;
+  b.roleParams.resize(12);
+  roundTrip(a, b);
+  b = a;
+  b.roleParams.erase(b.roleParams.begin() + 10, b.roleParams.begin() + 30);
+  roundTrip(a, b);
+}
+
+static void test_clear_groups(){
+  Topology a = base(), b = a;
+  b.groups.clear();
+  roundTrip(a, b);
+}
+
+static void test_scalar_fields_and_no_change(){
+  Topology a = base(), b = a;
+  b.role = RC_SEN_EMU; b.emuCount = 8; b.token[0] = 'z';
+  roundTrip(a, b);
+  roundTrip(a, a);
+}
+
+// A delta for another stamp, or against a node with no stamp yet, asks for the full TLV.
+static void test_base_mismatch_resyncs(){
+  Topology a = base(), b = a;
+  b.neighbors.pop_back();
+  TopoStamp st = stampOf(a, 7);
+  uint8_t d[512];
+  size_t n = topoDiff(a, b, st, d, sizeof(d));
+  uint32_t h;
+  Topology t = a;
+  TEST_ASSERT_EQUAL(TOPO_DELTA_RESYNC, topoApplyDelta(t, TopoStamp{ 8, st.hash }, d, (uint16_t)n, h));
+  TEST_ASSERT_EQUAL(TOPO_DELTA_RESYNC, topoApplyDelta(t, TopoStamp{ 7, st.hash ^ 1 }, d, (uint16_t)n, h));
+  TEST_ASSERT_EQUAL(TOPO_DELTA_RESYNC, topoApplyDelta(t, TopoStamp{ 0, st.hash }, d, (uint16_t)n, h));
+  TEST_ASSERT_TRUE(t.neighbors == a.neighbors);
+  // Base version 0 matches on the hash alone.
+  n = topoDiff(a, b, TopoStamp{ 0, st.hash }, d, sizeof(d));
+  TEST_ASSERT_EQUAL(TOPO_DELTA_OK, topoApplyDelta(t, TopoStamp{ 12, st.hash }, d, (uint16_t)n, h));
+  TEST_ASSERT_TRUE(t.neighbors == b.neighbors);
+}
+
+// {T_DELTA_BASE stamp} followed by one hand-built record.
+static std::vector<uint8_t> deltaWith(const TopoStamp& st, std::initializer_list<uint8_t> rec){
+  std::vector<uint8_t> d = { 0x10, 8 };
+  for(int i = 0; i < 4; ++i) d.push_back(uint8_t(st.version >> (8*i)));
+  for(int i = 0; i < 4; ++i) d.push_back(uint8_t(st.hash >> (8*i)));
+  d.insert(d.end(), rec);
+  return d;
+}
+
+static void test_unknown_record_is_bad(){
+  Topology a = base();
+  TopoStamp st = stampOf(a, 7);
+  auto d = deltaWith(st, { 0x7E, 1, 0x00 });
+  uint32_t h;
+  TEST_ASSERT_EQUAL(TOPO_DELTA_BAD, topoApplyDelta(a, st, d.data(), (uint16_t)d.size(), h));
+}
+
+static void test_out_of_range_splices_are_bad(){
+  Topology a = base();
+  TopoStamp st = stampOf(a, 7);
+  uint32_t h;
+  // neighbours: at 11 of 10
+  auto d = deltaWith(st, { 0x12, 4, 11, 0, 0, 0 });
+  TEST_ASSERT_EQUAL(TOPO_DELTA_BAD, topoApplyDelta(a, st, d.data(), (uint16_t)d.size(), h));
+  // neighbours: remove 3 at 8 of 10
+  d = deltaWith(st, { 0x12, 4, 8, 0, 3, 0 });
+  TEST_ASSERT_EQUAL(TOPO_DELTA_BAD, topoApplyDelta(a, st, d.data(), (uint16_t)d.size(), h));
+  // neighbours: insert not a whole MAC
+  d = deltaWith(st, { 0x12, 7, 0, 0, 0, 0, 1, 2, 3 });
+  TEST_ASSERT_EQUAL(TOPO_DELTA_BAD, topoApplyDelta(a, st, d.data(), (uint16_t)d.size(), h));
+  // role params: remove 1 at 40 of 40
+  d = deltaWith(st, { 0x13, 4, 40, 0, 1, 0 });
+  TEST_ASSERT_EQUAL(TOPO_DELTA_BAD, topoApplyDelta(a, st, d.data(), (uint16_t)d.size(), h));
+  // no base record first
+  const uint8_t nobase[] = { 0x12, 4, 0, 0, 0, 0, 0, 0, 0, 0 };
+  TEST_ASSERT_EQUAL(TOPO_DELTA_BAD, topoApplyDelta(a, st, nobase, sizeof(nobase), h));
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_insert_neighbor_mid_list);
+  RUN_TEST(test_remove_neighbors_mid_list);
+  RUN_TEST(test_replace_neighbor_mid_list);
+  RUN_TEST(test_shrink_role_params);
+  RUN_TEST(test_clear_groups);
+  RUN_TEST(test_scalar_fields_and_no_change);
+  RUN_TEST(test_base_mismatch_resyncs);
+  RUN_TEST(test_unknown_record_is_bad);
+  RUN_TEST(test_out_of_range_splices_are_bad);
+  return UNITY_END();
+}
@@ -0,0 +1,183 @@
+// Compact topology framing (TOPO_TLV_V2): MAC lists with a shared-OUI dictionary
+// and zigzag suffix deltas, varint lengths, and GET_TOPOLOGY negotiation.
+//
+//   pio test -e native -f test_topo_v2 -v
+#include <unity.h>
+#include <cstring>
+#include <vector>
+
+#include "sim/VirtualBus.h"
+#include "Opcodes.h"
+#include "TopologyTlv.h"
+#include "adapters/IcmRoleAdapter.h"
+#include "adapters/RelayRoleAdapter.h"
+
+using namespace espnow;
+
+static std::array<uint8_t,6> mac(uint32_t oui, uint32_t suffix){
+  return { uint8_t(oui >> 16), uint8_t(oui >> 8), uint8_t(oui), uint8_t(suffix >> 16), uint8_t(suffix >> 8), uint8_t(suffix) };
+}
+
+static Topology withNeighbors(const std::vector<std::array<uint8_t,6>>& n){
+  Topology t;
+  t.role = RC_RELAY;
+  std::memset(t.token, 't', sizeof(t.token));
+  t.neighbors = n;
+  for(int i = 0; i < 300; ++i) t.roleParams.push_back(uint8_t(i));   // > 0xFF: escaped in V1, 2-byte varint in V2
+  t.emuCount = 2;
+  t.groups = { 5, 9 };
+  return t;
+}
+
+static bool same(const Topology& a, const Topology& b){
+  return a.role == b.role && std::memcmp(a.token, b.token, 32) == 0 && a.neighbors == b.neighbors
+      && a.roleParams == b.roleParams && a.emuCount == b.emuCount && a.groups == b.groups;
+}
+
+// V2 decodes to the same Topology as V1, and re-encoding either way gives the
+// same bytes back.
+static void roundTrip(const Topology& t){
+  std::vector<uint8_t> v1, v2, again;
+  TEST_ASSERT_TRUE(topoEncode(t, v1, TOPO_TLV_V1));
+  TEST_ASSERT_TRUE(topoEncode(t, v2, TOPO_TLV_V2));
+  TEST_ASSERT_EQUAL(TOPO_TLV_V1, topoTlvVersion(v1.data(), (uint16_t)v1.size()));
+  TEST_ASSERT_EQUAL(TOPO_TLV_V2, topoTlvVersion(v2.data(), (uint16_t)v2.size()));
+  TEST_ASSERT_EQUAL(topoEncodedSize(t, TOPO_TLV_V2), v2.size());
+  Topology a, b;
+  TEST_ASSERT_TRUE(topoDecode(v1.data(), (uint16_t)v1.size(), a));
+  TEST_ASSERT_TRUE(topoDecode(v2.data(), (uint16_t)v2.size(), b));
+  TEST_ASSERT_TRUE(same(t, a));
+  TEST_ASSERT_TRUE(same(t, b));
+  topoEncode(b, again, TOPO_TLV_V1);
+  TEST_ASSERT_TRUE(again == v1);
+  topoEncode(a, again, TOPO_TLV_V2);
+  TEST_ASSERT_TRUE(again == v2);
+}
+
+// Two OUIs shared by several MACs (dictionary), two one-offs (literal).
+static void test_mixed_dictionary_and_literal_macs(){
+  std::vector<std::array<uint8_t,6>> n;
+  for(uint32_t i = 0; i < 12; ++i) n.push_back(mac(0x246F28, 0x100000 + i * 3));
+  n.push_back(mac(0xAABBCC, 0x010203));
+  for(uint32_t i = 0; i < 6; ++i) n.push_back(mac(0x3C71BF, 0x00F000 - i));
+  n.push_back(mac(0x112233, 0xFFFFFF));
+  Topology t = withNeighbors(n);
+  roundTrip(t);
+  std::vector<uint8_t> v1, v2;
+  topoEncode(t, v1); topoEncode(t, v2, TOPO_TLV_V2);
+  TEST_ASSERT_LESS_THAN(v1.size(), v2.size());
+}
+
+// Suffixes crossing FFFFFF <-> 000000 take the short way round.
+static void test_suffix_wraparound(){
+  Topology t = withNeighbors({ mac(0x246F28, 0xFFFFFE), mac(0x246F28, 0x000001), mac(0x246F28, 0xFFFFFF),
+                               mac(0x246F28, 0x000000), mac(0x246F28, 0x7FFFFF), mac(0x246F28, 0x800000) });
+  roundTrip(t);
+  // A step across the wrap costs the same as the same step away from it.
+  std::vector<uint8_t> across, inside;
+  topoEncode(withNeighbors({ mac(0x246F28, 0xFFFFFF), mac(0x246F28, 0x000000) }), across, TOPO_TLV_V2);
+  topoEncode(withNeighbors({ mac(0x246F28, 0x000000), mac(0x246F28, 0x000001) }), inside, TOPO_TLV_V2);
+  TEST_ASSERT_EQUAL(inside.size(), across.size());
+}
+
+// Ten shared OUIs: the first eight go in the dictionary, the rest are literal.
+static void test_more_than_eight_ouis(){
+  std::vector<std::array<uint8_t,6>> n;
+  for(uint32_t o = 0; o < 10; ++o)
+    for(uint32_t i = 0; i < 3; ++i) n.push_back(mac(0x100000 + o * 0x111, 0x000100 * o + i));
+  roundTrip(withNeighbors(n));
+}
+
+static void test_truncated_varints_rejected(){
+  Topology out, keep = withNeighbors({ mac(0x246F28, 1) });
+  out = keep;
+  // Record length varint cut off after a continuation byte.
+  const uint8_t lenCut[] = { 0x08, 1, TOPO_TLV_V2, 0x02, 0x81 };
+  TEST_ASSERT_FALSE(topoDecode(lenCut, sizeof(lenCut), out));
+  // MAC code varint cut off inside a neighbour list (empty dictionary).
+  const uint8_t codeCut[] = { 0x08, 1, TOPO_TLV_V2, 0x03, 2, 0x00, 0x80 };
+  TEST_ASSERT_FALSE(topoDecode(codeCut, sizeof(codeCut), out));
+  // Literal MAC shorter than six bytes.
+  const uint8_t litCut[] = { 0x08, 1, TOPO_TLV_V2, 0x03, 5, 0x00, 0x00, 0x24, 0x6F, 0x28 };
+  TEST_ASSERT_FALSE(topoDecode(litCut, sizeof(litCut), out));
+  // Dictionary larger than MAC_DICT_MAX.
+  const uint8_t dictBig[] = { 0x08, 1, TOPO_TLV_V2, 0x03, 1, 9 };
+  TEST_ASSERT_FALSE(topoDecode(dictBig, sizeof(dictBig), out));
+  TEST_ASSERT_TRUE(same(keep, out));                  // untouched on failure
+}
+
+static void test_unknown_version_rejected(){
+  std::vector<uint8_t> v2;
+  topoEncode(withNeighbors({ mac(0x246F28, 1) }), v2, TOPO_TLV_V2);
+  v2[2] = TOPO_TLV_V2 + 1;
+  Topology out;
+  TEST_ASSERT_FALSE(topoDecode(v2.data(), (uint16_t)v2.size(), out));
+  struct : TopoVisitor {} v;
+  TEST_ASSERT_FALSE(topoVisit(v2.data(), (uint16_t)v2.size(), v));
+}
+
+// GET_TOPOLOGY: no body or a bare stamp gets V1, a TopoQuery with tlv = 2
+// gets V2, and a current stamp gets the stamp alone in either case.
+static uint8_t  g_ver;
+static uint16_t g_len;
+static Topology g_got;
+static void onTopo(const uint8_t*, const ReqResult& r, void*){
+  g_len = r.status == REQ_OK ? r.len : 0;
+  g_ver = g_len ? topoTlvVersion(r.payload, r.len) : 0;
+  if(g_len && !topoNotModified(r.payload, r.len)) topoDecode(r.payload, r.len, g_got);
+}
+
+static void ask(sim::VirtualBus& bus, const void* q, uint16_t len){
+  g_ver = 0; g_len = 0; g_got = Topology{};
+  EspNowCore::setInstance(&bus.node(0));
+  bus.node(0).request(bus.mac(1), GET_TOPOLOGY, q, len, onTopo);
+  bus.runFor(200);
+}
+
+static void test_get_topology_negotiation(){
+  sim::VirtualBus bus(4);
+  IcmRoleAdapter icm; RelayRoleAdapter rel;
+  EspNowCore& ci = bus.addNode(&icm); EspNowCore& cr = bus.addNode(&rel);
+  ci.addPeer(bus.mac(1)); cr.addPeer(bus.mac(0));
+  std::vector<std::array<uint8_t,6>> n;
+  for(uint32_t i = 0; i < 8; ++i) n.push_back(mac(0x246F28, 0x200000 + i));
+  Topology t = withNeighbors(n);
+  t.roleParams.resize(20);
+  EspNowCore::setInstance(&cr);
+  cr.setLocalTopology(t);
+  TopoStamp st = cr.topologyStamp();
+
+  ask(bus, nullptr, 0);
+  TEST_ASSERT_EQUAL(TOPO_TLV_V1, g_ver);
+  TEST_ASSERT_TRUE(same(t, g_got));
+
+  TopoQuery q{ 0, 0, TOPO_TLV_V2 };
+  ask(bus, &q, offsetof(TopoQuery, tlv));             // stamp only: V1
+  TEST_ASSERT_EQUAL(TOPO_TLV_V1, g_ver);
+  TEST_ASSERT_TRUE(same(t, g_got));
+
+  ask(bus, &q, sizeof(q));
+  TEST_ASSERT_EQUAL(TOPO_TLV_V2, g_ver);
+  TEST_ASSERT_TRUE(same(t, g_got));
+
+  q = TopoQuery{ st.version, st.hash, TOPO_TLV_V2 };
+  ask(bus, &q, sizeof(q));
+  TEST_ASSERT_EQUAL(10, g_len);                       // not modified: the stamp alone
+  q.tlv = TOPO_TLV_V1;
+  ask(bus, &q, offsetof(TopoQuery, tlv));
+  TEST_ASSERT_EQUAL(10, g_len);
+}
+
+void setUp(){}
+void tearDown(){}
+
+int main(int, char**){
+  UNITY_BEGIN();
+  RUN_TEST(test_mixed_dictionary_and_literal_macs);
+  RUN_TEST(test_suffix_wraparound);
+  RUN_TEST(test_more_than_eight_ouis);
+  RUN_TEST(test_truncated_varints_rejected);
+  RUN_TEST(test_unknown_version_rejected);
+  RUN_TEST(test_get_topology_negotiation);
+  return UNITY_END();
+}